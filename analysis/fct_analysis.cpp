@@ -87,7 +87,8 @@ int main(int argc, char* argv[]){
 		uint16_t port;
 		uint32_t size;
 		uint64_t start_time, fct, standalone_fct;
-		while (fscanf(file, "%*s%*s%*s%hu%u%lu%lu%lu", &port, &size, &start_time, &fct, &standalone_fct) != EOF){
+		// skip the per-rail throughput of multi-rail runs at the end of the line
+		while (fscanf(file, "%*s%*s%*s%hu%u%lu%lu%lu%*[^\n]", &port, &size, &start_time, &fct, &standalone_fct) != EOF){
 			if (((port == 100 && !(type & 1)) || (port == 200 && type > 0)) && start_time + fct < time_limit){
 				float slowdown = double(fct) / standalone_fct;
 				tuples.push_back(make_pair(size, slowdown < 1 ? 1.0 : slowdown));
@@ -0,0 +1,372 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+/*
+ * Compare the FCT slowdown of many runs at once.
+ * Each config is a name and a list of FCT files (e.g., one per seed), whose flows are pooled.
+ * The flows are binned by size, and for each bin we report the 50/95/99-percentile slowdown
+ * with bootstrap confidence intervals, and optionally the change relative to a baseline config.
+ */
+
+struct Flow{
+	uint64_t size;
+	float slowdown;
+};
+
+struct Config{
+	string name;
+	vector<string> files;
+	vector<vector<Flow> > runs; // flows of each file
+	vector<Flow> flows; // all runs pooled
+	vector<vector<float> > bins; // slowdowns of each size bin
+};
+
+const double pctl[3] = {0.5, 0.95, 0.99};
+
+uint32_t step = 5, type = 0, n_boot = 1000, n_thread = 0;
+uint64_t time_limit = 3000000000lu, seed = 1;
+double conf = 0.95;
+vector<uint64_t> steps; // size thresholds
+vector<double> bin_pct; // the percentile of flows up to each threshold, as printed
+string baseline;
+vector<Config> configs;
+
+void usage(const char *name){
+	fprintf(stderr,
+			"usage: %s [-s STEP] [-S STEP_FILE] [-t TYPE] [-T TIME_LIMIT] [-B N_BOOT] [-C CONF] [-r SEED] [-j THREADS] [-b BASELINE] NAME=FILE[,FILE...] ...\n"
+			"\n"
+			"  NAME=FILE,...  a config and its fct files (e.g., one per seed). A single FILE is also accepted, named by itself\n"
+			"  -s STEP        bins of STEP percent of the flows (by size) of the first config, by default 5\n"
+			"  -S STEP_FILE   bins by the sizes in the file (same format as fct_analysis)\n"
+			"  -t TYPE        0: normal, 1: incast, 2: all\n"
+			"  -T TIME_LIMIT  only consider flows that finish before T\n"
+			"  -B N_BOOT      number of bootstrap samples, by default 1000; 0 disables the confidence intervals\n"
+			"  -C CONF        confidence level, by default 0.95\n"
+			"  -r SEED        seed of the bootstrap\n"
+			"  -j THREADS     by default the number of cores\n"
+			"  -b BASELINE    also report the change of each config relative to this one\n",
+			name);
+	exit(EXIT_FAILURE);
+}
+
+void parse_opt(int argc, char* argv[]){
+	for (int opt; (opt = getopt(argc, argv, "s:S:t:T:B:C:r:j:b:h")) != -1;){
+		switch (opt){
+			case 's':
+				step = atoi(optarg);
+				break;
+			case 'S':
+				{
+					FILE* step_file = fopen(optarg, "r");
+					if (step_file == NULL)
+						usage(argv[0]);
+					uint64_t s;
+					double p;
+					while (fscanf(step_file, "%lu%lf", &s, &p) == 2){
+						steps.push_back(s);
+						bin_pct.push_back(p / 100.);
+					}
+					fclose(step_file);
+				}
+				break;
+			case 't':
+				type = atoi(optarg);
+				break;
+			case 'T':
+				time_limit = atoll(optarg);
+				break;
+			case 'B':
+				n_boot = atoi(optarg);
+				break;
+			case 'C':
+				conf = atof(optarg);
+				break;
+			case 'r':
+				seed = atoll(optarg);
+				break;
+			case 'j':
+				n_thread = atoi(optarg);
+				break;
+			case 'b':
+				baseline = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	for (int i = optind; i < argc; i++){
+		Config c;
+		char *eq = strchr(argv[i], '=');
+		char *files = argv[i];
+		if (eq){
+			c.name = string(argv[i], eq - argv[i]);
+			files = eq + 1;
+		}else
+			c.name = argv[i];
+		for (char *tok = strtok(files, ","); tok != NULL; tok = strtok(NULL, ","))
+			c.files.push_back(tok);
+		configs.push_back(c);
+	}
+	if (configs.empty() || step == 0 || step > 100 || conf <= 0 || conf >= 1)
+		usage(argv[0]);
+}
+
+// run tasks 0..n-1 on n_thread threads
+void parallel_for(uint64_t n, function<void(uint64_t)> f){
+	atomic<uint64_t> next(0);
+	vector<thread> threads;
+	for (uint32_t i = 0; i < n_thread; i++)
+		threads.push_back(thread([&](){
+			for (uint64_t j; (j = next++) < n;)
+				f(j);
+		}));
+	for (auto &t : threads)
+		t.join();
+}
+
+static inline bool parse_uint(const char *&p, const char *end, uint64_t &v){
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	if (p >= end || *p < '0' || *p > '9')
+		return false;
+	for (v = 0; p < end && *p >= '0' && *p <= '9'; p++)
+		v = v * 10 + (*p - '0');
+	return true;
+}
+static inline void skip_token(const char *&p, const char *end){
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	while (p < end && *p != ' ' && *p != '\t' && *p != '\n')
+		p++;
+}
+
+// each line: sip dip sport dport size start_time fct standalone_fct
+bool read_fct(const string &name, vector<Flow> &flows){
+	int fd = open(name.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) < 0){
+		close(fd);
+		return false;
+	}
+	if (st.st_size == 0){
+		close(fd);
+		return true;
+	}
+	const char *base = (const char*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (base == MAP_FAILED)
+		return false;
+	madvise((void*)base, st.st_size, MADV_SEQUENTIAL);
+	const char *end = base + st.st_size;
+	for (const char *p = base; p < end;){
+		const char *eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == NULL)
+			eol = end;
+		uint64_t port, size, start, fct, standalone;
+		skip_token(p, eol);
+		skip_token(p, eol);
+		skip_token(p, eol);
+		if (parse_uint(p, eol, port) && parse_uint(p, eol, size) && parse_uint(p, eol, start) && parse_uint(p, eol, fct) && parse_uint(p, eol, standalone)){
+			if (((port == 100 && !(type & 1)) || (port == 200 && type > 0)) && start + fct < time_limit){
+				Flow f;
+				f.size = size;
+				f.slowdown = standalone > 0 ? max(1.0, double(fct) / standalone) : 1;
+				flows.push_back(f);
+			}
+		}
+		p = eol + 1;
+	}
+	munmap((void*)base, st.st_size);
+	return true;
+}
+
+/*
+ * The q-th percentile of v (v is reordered), and n_boot samples of its bootstrap distribution.
+ * The percentile of a resample of v is the m-th smallest of n draws, m = floor(n*q)+1. Drawing
+ * from v is drawing a uniform rank, so the resampled percentile is the value of rank ceil(n*U),
+ * where U, the m-th smallest of n uniforms, is Beta(m, n+1-m). This gives the same distribution
+ * as resampling all the flows, at O(1) per bootstrap sample. Only the ranks within a few sigma
+ * are ever drawn, so only they are selected (by nth_element) and sorted.
+ */
+float get_pctl(vector<float> &v, double q, mt19937_64 &rng, vector<float> &boot){
+	uint64_t n = v.size(), k = min(n - 1, uint64_t(n * q));
+	uint64_t w = 8 * sqrt(n * q * (1 - q)) + 2;
+	uint64_t lo = k > w ? k - w : 0, hi = min(n, k + w + 1);
+	nth_element(v.begin(), v.begin() + lo, v.end());
+	if (hi < n)
+		nth_element(v.begin() + lo, v.begin() + hi, v.end());
+	sort(v.begin() + lo, v.begin() + hi);
+	gamma_distribution<double> ga(k + 1, 1), gb(n - k, 1);
+	boot.clear();
+	for (uint32_t j = 0; j < n_boot; j++){
+		double x = ga(rng), y = gb(rng);
+		uint64_t r = (uint64_t)ceil(n * x / (x + y));
+		r = min(hi, max(lo + 1, r)); // 1-based
+		boot.push_back(v[r - 1]);
+	}
+	return v[k];
+}
+
+// the [lo, hi] of the central conf interval of the samples (a copy, the order of the samples is kept for pairing)
+pair<float, float> interval(vector<float> s){
+	if (s.empty())
+		return make_pair(0.f, 0.f);
+	uint64_t lo = uint64_t(s.size() * (1 - conf) / 2), hi = min(s.size() - 1, uint64_t(s.size() * (1 + conf) / 2));
+	nth_element(s.begin(), s.begin() + lo, s.end());
+	float a = s[lo];
+	nth_element(s.begin(), s.begin() + hi, s.end());
+	return make_pair(a, s[hi]);
+}
+
+struct BinResult{
+	uint64_t n;
+	float p[3]; // point estimates
+	vector<float> boot[3]; // bootstrap samples
+};
+
+int main(int argc, char* argv[]){
+	parse_opt(argc, argv);
+	if (n_thread == 0)
+		n_thread = max(1u, thread::hardware_concurrency());
+	int base_idx = -1;
+	for (uint32_t i = 0; i < configs.size(); i++)
+		if (configs[i].name == baseline)
+			base_idx = i;
+	if (!baseline.empty() && base_idx < 0){
+		fprintf(stderr, "baseline %s is not in the configs\n", baseline.c_str());
+		return 1;
+	}
+
+	// read all files in parallel
+	vector<pair<uint32_t, uint32_t> > files;
+	for (uint32_t i = 0; i < configs.size(); i++){
+		configs[i].runs.resize(configs[i].files.size());
+		for (uint32_t j = 0; j < configs[i].files.size(); j++)
+			files.push_back(make_pair(i, j));
+	}
+	vector<char> ok(files.size());
+	parallel_for(files.size(), [&](uint64_t k){
+		Config &c = configs[files[k].first];
+		ok[k] = read_fct(c.files[files[k].second], c.runs[files[k].second]);
+	});
+	for (uint32_t k = 0; k < files.size(); k++)
+		if (!ok[k]){
+			fprintf(stderr, "cannot read %s\n", configs[files[k].first].files[files[k].second].c_str());
+			return 1;
+		}
+	for (auto &c : configs){
+		for (auto &r : c.runs)
+			c.flows.insert(c.flows.end(), r.begin(), r.end());
+		c.runs.clear();
+		if (c.flows.empty()){
+			fprintf(stderr, "%s has no flow\n", c.name.c_str());
+			return 1;
+		}
+	}
+
+	// the size thresholds of the bins, from the step file or the first config, so all configs use the same bins
+	if (steps.empty()){
+		vector<uint64_t> sizes;
+		for (auto &f : configs[0].flows)
+			sizes.push_back(f.size);
+		// partition by successive nth_element instead of a full sort
+		uint64_t l = 0;
+		for (uint32_t p = step; p <= 100; p += step){
+			uint64_t r = min((uint64_t)sizes.size(), (uint64_t)p * sizes.size() / 100);
+			if (r == 0)
+				continue;
+			nth_element(sizes.begin() + l, sizes.begin() + r - 1, sizes.end());
+			steps.push_back(sizes[r - 1]);
+			bin_pct.push_back(p / 100.);
+			l = r;
+		}
+		if (bin_pct.empty() || bin_pct.back() < 1){
+			steps.push_back(*max_element(sizes.begin(), sizes.end()));
+			bin_pct.push_back(1);
+		}
+	}
+	uint32_t n_bin = steps.size();
+	for (auto &c : configs){
+		c.bins.resize(n_bin);
+		for (auto &f : c.flows){
+			uint32_t b = lower_bound(steps.begin(), steps.end(), f.size) - steps.begin();
+			if (b < n_bin)
+				c.bins[b].push_back(f.slowdown);
+		}
+		c.flows.clear();
+	}
+
+	// the point estimates and the bootstrap samples of each (config, bin)
+	vector<vector<BinResult> > res(configs.size(), vector<BinResult>(n_bin));
+	parallel_for(configs.size() * n_bin, [&](uint64_t k){
+		uint32_t i = k / n_bin, b = k % n_bin;
+		vector<float> &v = configs[i].bins[b];
+		BinResult &r = res[i][b];
+		r.n = v.size();
+		if (v.empty())
+			return;
+		mt19937_64 rng(seed * 1000003 + k);
+		for (int q = 0; q < 3; q++)
+			r.p[q] = get_pctl(v, pctl[q], rng, r.boot[q]);
+	});
+
+	printf("#name\tpct\tsize\tn");
+	for (int q = 0; q < 3; q++){
+		int pp = pctl[q] * 100 + 0.5;
+		printf("\tp%d\tp%d_lo\tp%d_hi", pp, pp, pp);
+	}
+	if (base_idx >= 0)
+		for (int q = 0; q < 3; q++){
+			int pp = pctl[q] * 100 + 0.5;
+			printf("\td_p%d%%\td_p%d_lo\td_p%d_hi", pp, pp, pp);
+		}
+	printf("\n");
+	for (uint32_t i = 0; i < configs.size(); i++)
+		for (uint32_t b = 0; b < n_bin; b++){
+			BinResult &r = res[i][b];
+			printf("%s\t%.3lf\t%lu\t%lu", configs[i].name.c_str(), bin_pct[b], steps[b], r.n);
+			for (int q = 0; q < 3; q++){
+				pair<float, float> ci = interval(r.boot[q]);
+				if (r.n == 0 || n_boot == 0)
+					ci = make_pair(r.p[q], r.p[q]);
+				printf("\t%.3f\t%.3f\t%.3f", r.n ? r.p[q] : 0, ci.first, ci.second);
+			}
+			if (base_idx >= 0){
+				// change relative to the baseline in percent; the ci pairs the i-th bootstrap samples of both
+				BinResult &rb = res[base_idx][b];
+				for (int q = 0; q < 3; q++){
+					if (r.n == 0 || rb.n == 0){
+						printf("\t-\t-\t-");
+						continue;
+					}
+					vector<float> d;
+					for (uint32_t j = 0; j < r.boot[q].size() && j < rb.boot[q].size(); j++)
+						d.push_back(100. * (r.boot[q][j] / rb.boot[q][j] - 1));
+					float delta = 100. * (r.p[q] / rb.p[q] - 1);
+					pair<float, float> ci = d.empty() ? make_pair(delta, delta) : interval(d);
+					printf("\t%+.2f\t%+.2f\t%+.2f", delta, ci.first, ci.second);
+				}
+			}
+			printf("\n");
+		}
+	return 0;
+}
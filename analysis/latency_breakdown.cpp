@@ -0,0 +1,366 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include "trace-format.h"
+#include "trace_filter.hpp"
+#include "trace_file.hpp"
+#include "trace_column.hpp"
+#include "utils.hpp"
+#include "sim-setting.h"
+
+using namespace ns3;
+using namespace std;
+
+/*
+ * Break the latency of each data packet down by hop. A hop is from a node's egress to the next node:
+ *   queue: from Recv (at a switch) to Dequ, excluding the time the egress queue was paused
+ *   pfc:   the time the egress queue was paused by PFC while the packet was in it
+ *   tx:    the serialization time on the link
+ *   prop:  the rest of the time until Recv at the next node, i.e., the propagation delay
+ * The sender's hop starts at its Dequ, so the time in the NIC before that is not counted.
+ * Packets are joined by (flow, seq) in one pass over the trace in time order; only the packets in flight are kept.
+ */
+
+enum Mode{
+	MODE_PACKET, // one line per delivered packet
+	MODE_FLOW, // one line per flow
+	MODE_HOP, // one line per hop of each flow
+	MODE_SWITCH // one line per switch port
+};
+
+static const uint32_t max_hop = 8;
+
+struct Hop{
+	uint16_t node;
+	uint8_t intf;
+	uint32_t queue, pfc, tx, prop;
+};
+
+// a packet in flight
+struct Packet{
+	uint64_t start; // the first Dequ at the sender
+	uint64_t last; // the last event
+	uint64_t pause; // the pause clock of the egress queue at Enqu
+	uint32_t n_hop;
+	Hop hop[max_hop];
+};
+
+struct PacketKey{
+	FlowInt flow;
+	uint32_t seq;
+	bool operator==(const PacketKey &o) const{
+		return flow == o.flow && seq == o.seq;
+	}
+};
+struct PacketKeyHash{
+	size_t operator()(const PacketKey &k) const{
+		return (k.flow * 0x9E3779B97F4A7C15ull) ^ k.seq;
+	}
+};
+
+struct Sum{
+	uint64_t n, queue, pfc, tx, prop;
+	Sum() : n(0), queue(0), pfc(0), tx(0), prop(0) {}
+	void Add(const Hop &h){
+		n++;
+		queue += h.queue;
+		pfc += h.pfc;
+		tx += h.tx;
+		prop += h.prop;
+	}
+	void Print(){
+		printf("%.1lf %.1lf %.1lf %.1lf", (double)queue / n, (double)pfc / n, (double)tx / n, (double)prop / n);
+	}
+};
+
+struct FlowStat{
+	uint64_t n, drop, lost, latency, max_latency;
+	Sum total;
+	vector<Hop> path; // node and intf of each hop, of the first delivered packet
+	vector<Sum> hop;
+	FlowStat() : n(0), drop(0), lost(0), latency(0), max_latency(0) {}
+};
+
+// the pause clock of an egress queue: the total time it has been paused
+struct PauseClock{
+	uint64_t since; // when it was paused, if paused
+	uint64_t total;
+	bool paused;
+	PauseClock() : since(0), total(0), paused(false) {}
+	uint64_t Get(uint64_t t){
+		return total + (paused ? t - since : 0);
+	}
+};
+
+Mode mode = MODE_FLOW;
+uint64_t timeout = 10000000; // ns
+SimSetting sim_setting;
+unordered_map<PacketKey, Packet, PacketKeyHash> inflight;
+unordered_map<uint32_t, PauseClock> pause_clock; // (node, intf, qidx) -> pause clock
+unordered_map<FlowInt, FlowStat> flows;
+unordered_map<uint32_t, Sum> ports; // switch port -> the hops starting at it
+uint64_t n_delivered = 0, n_drop = 0, n_lost = 0;
+
+static inline uint32_t GetQueueInt(uint16_t node, uint8_t intf, uint8_t qidx){
+	return (GetDevInt(node, intf) << 3) | (qidx & 7);
+}
+
+void deliver(FlowInt f, uint32_t seq, Packet &p, uint64_t t){
+	uint64_t latency = t - p.start;
+	n_delivered++;
+	if (mode == MODE_PACKET){
+		printf("%lu %u %u %u %u %u %lu %u", t, (uint32_t)(f >> 48), (uint32_t)(f >> 32) & 0xffff, (uint32_t)(f >> 16) & 0xffff, (uint32_t)f & 0xffff, seq, latency, p.n_hop);
+		for (uint32_t i = 0; i < p.n_hop; i++)
+			printf(" %u %u %u %u %u %u", p.hop[i].node, p.hop[i].intf, p.hop[i].queue, p.hop[i].pfc, p.hop[i].tx, p.hop[i].prop);
+		printf("\n");
+		return;
+	}
+	if (mode == MODE_SWITCH){
+		// the sender's hop is not at a switch
+		for (uint32_t i = 1; i < p.n_hop; i++)
+			ports[GetDevInt(p.hop[i].node, p.hop[i].intf)].Add(p.hop[i]);
+		return;
+	}
+	FlowStat &s = flows[f];
+	s.n++;
+	s.latency += latency;
+	s.max_latency = max(s.max_latency, latency);
+	if (s.path.size() == 0)
+		s.path.assign(p.hop, p.hop + p.n_hop);
+	if (s.hop.size() < p.n_hop)
+		s.hop.resize(p.n_hop);
+	Hop total = {0, 0, 0, 0, 0, 0};
+	for (uint32_t i = 0; i < p.n_hop; i++){
+		s.hop[i].Add(p.hop[i]);
+		total.queue += p.hop[i].queue;
+		total.pfc += p.hop[i].pfc;
+		total.tx += p.hop[i].tx;
+		total.prop += p.hop[i].prop;
+	}
+	s.total.Add(total);
+}
+
+// drop the packets that have not been seen for timeout, to bound the memory if packets are lost without a Drop event
+void expire(uint64_t t){
+	for (auto it = inflight.begin(); it != inflight.end();){
+		if (it->second.last + timeout < t){
+			n_lost++;
+			if (mode == MODE_FLOW || mode == MODE_HOP)
+				flows[it->first.flow].lost++;
+			it = inflight.erase(it);
+		}else
+			++it;
+	}
+}
+
+void process(TraceFormat &tr, TraceFilter &f){
+	if (tr.l3Prot == 0xFE){
+		// PFC frame received: it pauses or resumes the receiver's egress queue
+		if (tr.event != Recv)
+			return;
+		PauseClock &c = pause_clock[GetQueueInt(tr.node, tr.intf, tr.pfc.qIndex)];
+		if (tr.pfc.time > 0 && !c.paused){
+			c.paused = true;
+			c.since = tr.time;
+		}else if (tr.pfc.time == 0 && c.paused){
+			c.paused = false;
+			c.total += tr.time - c.since;
+		}
+		return;
+	}
+	if (tr.l3Prot != 0x11)
+		return;
+	PacketKey k = {GetFlowInt(tr), tr.data.seq};
+	if (tr.nodeType == 0 && tr.event == Dequ){
+		// sent by the host; a retransmission replaces the old copy
+		if (!f.test(tr))
+			return;
+		Packet &p = inflight[k];
+		p.start = p.last = tr.time;
+		p.n_hop = 1;
+		p.hop[0] = (Hop){tr.node, tr.intf, 0, 0, 0, 0};
+		return;
+	}
+	auto it = inflight.find(k);
+	if (it == inflight.end())
+		return;
+	Packet &p = it->second;
+	Hop &h = p.hop[p.n_hop - 1];
+	switch (tr.event){
+		case Recv:{
+			// the end of the current hop; the times add up when the hops beyond max_hop are merged into it
+			uint64_t wire = tr.time - p.last;
+			uint64_t bps = sim_setting.port_speed[h.node][h.intf];
+			uint64_t tx = bps > 0 ? min(wire, (uint64_t)(tr.size * 8e9 / bps)) : 0;
+			h.tx += tx;
+			h.prop += wire - tx;
+			p.last = tr.time;
+			if (tr.nodeType == 0){
+				deliver(k.flow, k.seq, p, tr.time);
+				inflight.erase(it);
+			}
+			break;
+		}
+		case Enqu:{
+			// a new hop at the switch; more hops than max_hop are merged into the last one, which then
+			// has the sum of their times and the node and intf of the latest of them
+			if (p.n_hop < max_hop){
+				p.n_hop++;
+				Hop &nh = p.hop[p.n_hop - 1];
+				nh.queue = nh.pfc = nh.tx = nh.prop = 0;
+			}
+			Hop &nh = p.hop[p.n_hop - 1];
+			nh.node = tr.node;
+			nh.intf = tr.intf;
+			p.pause = pause_clock[GetQueueInt(tr.node, tr.intf, tr.qidx)].Get(tr.time);
+			break;
+		}
+		case Dequ:{
+			uint32_t pfc = pause_clock[GetQueueInt(tr.node, tr.intf, tr.qidx)].Get(tr.time) - p.pause;
+			uint64_t wait = tr.time - p.last;
+			h.pfc += min(wait, (uint64_t)pfc);
+			h.queue += wait - min(wait, (uint64_t)pfc);
+			p.last = tr.time;
+			break;
+		}
+		case Drop:
+			n_drop++;
+			if (mode == MODE_FLOW || mode == MODE_HOP)
+				flows[k.flow].drop++;
+			inflight.erase(it);
+			break;
+	}
+}
+
+void print_result(){
+	if (mode == MODE_FLOW || mode == MODE_HOP){
+		vector<FlowInt> keys;
+		for (auto &s : flows)
+			keys.push_back(s.first);
+		sort(keys.begin(), keys.end());
+		for (FlowInt k : keys){
+			FlowStat &s = flows[k];
+			if (s.n == 0)
+				continue;
+			uint32_t src = k >> 48, dst = (k >> 32) & 0xffff, sport = (k >> 16) & 0xffff, dport = k & 0xffff;
+			if (mode == MODE_FLOW){
+				printf("%u %u %u %u %lu %lu %lu %.1lf %lu ", src, dst, sport, dport, s.n, s.drop, s.lost, (double)s.latency / s.n, s.max_latency);
+				s.total.Print();
+				printf("\n");
+			}else {
+				for (uint32_t i = 0; i < s.hop.size(); i++){
+					printf("%u %u %u %u %u %u %u %lu ", src, dst, sport, dport, i, i < s.path.size() ? s.path[i].node : 0, i < s.path.size() ? s.path[i].intf : 0, s.hop[i].n);
+					s.hop[i].Print();
+					printf("\n");
+				}
+			}
+		}
+	}else if (mode == MODE_SWITCH){
+		vector<uint32_t> keys;
+		uint64_t all = 0;
+		for (auto &s : ports){
+			keys.push_back(s.first);
+			all += s.second.queue + s.second.pfc;
+		}
+		sort(keys.begin(), keys.end());
+		for (uint32_t k : keys){
+			Sum &s = ports[k];
+			printf("%u %u %lu ", k >> 8, k & 0xff, s.n);
+			s.Print();
+			printf(" %.2lf\n", all > 0 ? (s.queue + s.pfc) * 100.0 / all : 0);
+		}
+	}
+	fprintf(stderr, "delivered %lu dropped %lu lost %lu in flight %lu\n", n_delivered, n_drop, n_lost, (uint64_t)inflight.size());
+}
+
+bool parse_mode(const char *s, Mode &m){
+	if (strcmp(s, "packet") == 0)
+		m = MODE_PACKET;
+	else if (strcmp(s, "flow") == 0)
+		m = MODE_FLOW;
+	else if (strcmp(s, "hop") == 0)
+		m = MODE_HOP;
+	else if (strcmp(s, "switch") == 0)
+		m = MODE_SWITCH;
+	else
+		return false;
+	return true;
+}
+
+void usage(const char *name){
+	printf("Usage: %s [-m MODE] [-T TIMEOUT] <trace_file (.tr or .trc)> [filter_expr]\n"
+			"  -m MODE       packet: per delivered packet, the latency and each hop's components\n"
+			"                flow: per flow, the average latency and components (default)\n"
+			"                hop: per flow and hop, the average components\n"
+			"                switch: per switch port, the average components of the hops starting there\n"
+			"  -T TIMEOUT    a packet not seen for TIMEOUT ns is considered lost, by default 10000000\n"
+			"  filter_expr   selects the packets by their first transmission at the sender\n", name);
+}
+
+int main(int argc, char** argv){
+	for (int opt; (opt = getopt(argc, argv, "m:T:h")) != -1;){
+		switch (opt){
+			case 'm':
+				if (!parse_mode(optarg, mode)){
+					printf("Unknown mode: %s\n", optarg);
+					return 0;
+				}
+				break;
+			case 'T':
+				timeout = atoll(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 0;
+		}
+	}
+	if (optind + 1 != argc && optind + 2 != argc){
+		usage(argv[0]);
+		return 0;
+	}
+	bool columnar = ColumnTraceFile::IsColumnTrace(argv[optind]);
+	TraceFile file;
+	ColumnTraceFile cfile;
+	if (columnar ? !cfile.Open(argv[optind]) : !file.Open(argv[optind])){
+		printf("Cannot open %s\n", argv[optind]);
+		return 0;
+	}
+	sim_setting = columnar ? cfile.sim_setting : file.sim_setting;
+	TraceFilter f;
+	if (optind + 2 == argc){
+		f.parse(argv[optind + 1]);
+		if (f.root == NULL){
+			printf("Invalid filter\n");
+			return 0;
+		}
+	}
+
+	inflight.reserve(1 << 16);
+	TraceFormat tr;
+	if (columnar){
+		const uint8_t *cols[n_trace_column];
+		for (uint64_t b = 0; b < cfile.n_block; b++){
+			cfile.Columns(b, cols);
+			uint64_t cnt = cfile.BlockCount(b);
+			for (uint64_t j = 0; j < cnt; j++){
+				ColumnTraceFile::Get(cols, j, tr);
+				process(tr, f);
+			}
+			if ((b & 15) == 15)
+				expire(tr.time);
+		}
+	}else {
+		for (uint64_t i = 0; i < file.n; i++){
+			memcpy(&tr, &file.tr[i], sizeof(tr));
+			process(tr, f);
+			if ((i & 0xfffff) == 0xfffff)
+				expire(tr.time);
+		}
+	}
+	print_result();
+	return 0;
+}
@@ -0,0 +1,409 @@
+#ifndef TRACE_COLUMN_HPP
+#define TRACE_COLUMN_HPP
+
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace-format.h"
+#include "trace_filter.hpp"
+#include "trace_file.hpp"
+#include "sim-setting.h"
+
+/*
+ * Columnar trace (.trc), converted from a .tr file by trace_convert.
+ *
+ * Layout:
+ *   magic "HPCCTRC1", uint32 block_size, uint32 n_col, uint64 n
+ *   SimSetting
+ *   zone maps: for each block, for each column, uint64 min and max
+ *   (padding to 64B)
+ *   blocks: each block has block_size records (the last one may have less), stored column by column
+ *
+ * The columns are the fields of TraceFormat, except that the union is split into
+ * sport (first u16), dport (second u16) and the raw rest, which has no zone map.
+ * Columns are sorted by width, so every column in a block is aligned.
+ */
+
+struct TraceColumn{
+	const char* name;
+	uint32_t offset; // offset in TraceFormat
+	uint32_t width;
+	bool zone; // has zone map
+};
+
+static const TraceColumn trace_columns[] = {
+	{"time", offsetof(ns3::TraceFormat, time), 8, true},
+	{"qlen", offsetof(ns3::TraceFormat, qlen), 4, true},
+	{"sip", offsetof(ns3::TraceFormat, sip), 4, true},
+	{"dip", offsetof(ns3::TraceFormat, dip), 4, true},
+	{"node", offsetof(ns3::TraceFormat, node), 2, true},
+	{"size", offsetof(ns3::TraceFormat, size), 2, true},
+	{"sport", offsetof(ns3::TraceFormat, data.sport), 2, true},
+	{"dport", offsetof(ns3::TraceFormat, data.dport), 2, true},
+	{"intf", offsetof(ns3::TraceFormat, intf), 1, true},
+	{"qidx", offsetof(ns3::TraceFormat, qidx), 1, true},
+	{"l3Prot", offsetof(ns3::TraceFormat, l3Prot), 1, true},
+	{"event", offsetof(ns3::TraceFormat, event), 1, true},
+	{"ecn", offsetof(ns3::TraceFormat, ecn), 1, true},
+	{"nodeType", offsetof(ns3::TraceFormat, nodeType), 1, true},
+	{"rest", offsetof(ns3::TraceFormat, data.sport) + 4, sizeof(ns3::TraceFormat) - offsetof(ns3::TraceFormat, data.sport) - 4, false},
+};
+static const uint32_t n_trace_column = sizeof(trace_columns) / sizeof(trace_columns[0]);
+static const char trace_column_magic[8] = {'H', 'P', 'C', 'C', 'T', 'R', 'C', '1'};
+
+static inline uint64_t load_uint(const uint8_t *p, uint32_t width){
+	switch (width){
+		case 1: return *p;
+		case 2: { uint16_t v; memcpy(&v, p, 2); return v; }
+		case 4: { uint32_t v; memcpy(&v, p, 4); return v; }
+		case 8: { uint64_t v; memcpy(&v, p, 8); return v; }
+		default: return 0;
+	}
+}
+
+struct ZoneMap{
+	uint64_t min, max;
+};
+
+class ColumnTraceFile{
+public:
+	SimSetting sim_setting;
+	uint32_t block_size;
+	uint64_t n; // number of records
+	uint64_t n_block;
+
+	ColumnTraceFile() : block_size(0), n(0), n_block(0), base(NULL), len(0) {}
+	~ColumnTraceFile(){
+		Close();
+	}
+
+	static bool IsColumnTrace(const char *name){
+		char magic[8];
+		FILE *file = fopen(name, "r");
+		if (file == NULL)
+			return false;
+		bool res = fread(magic, 8, 1, file) == 1 && memcmp(magic, trace_column_magic, 8) == 0;
+		fclose(file);
+		return res;
+	}
+
+	// convert a .tr file to .trc; block_size must be a multiple of 64 to keep the columns aligned
+	static bool Convert(const char *in, const char *out, uint32_t block_size){
+		TraceFile tf;
+		if (block_size == 0 || block_size % 64 != 0 || !tf.Open(in))
+			return false;
+		FILE *file = fopen(out, "w");
+		if (file == NULL)
+			return false;
+		uint32_t n_col = n_trace_column;
+		uint64_t n_block = (tf.n + block_size - 1) / block_size;
+		fwrite(trace_column_magic, 8, 1, file);
+		fwrite(&block_size, sizeof(block_size), 1, file);
+		fwrite(&n_col, sizeof(n_col), 1, file);
+		fwrite(&tf.n, sizeof(tf.n), 1, file);
+		tf.sim_setting.Serialize(file);
+		// the zone maps are filled after the blocks are written
+		long zone_off = ftell(file);
+		std::vector<ZoneMap> zone(n_block * n_col);
+		fwrite(zone.data(), sizeof(ZoneMap), zone.size(), file);
+		Pad(file);
+
+		std::vector<uint8_t> buf;
+		for (uint64_t b = 0; b < n_block; b++){
+			uint64_t start = b * block_size, cnt = std::min((uint64_t)block_size, tf.n - start);
+			for (uint32_t c = 0; c < n_col; c++){
+				const TraceColumn &col = trace_columns[c];
+				ZoneMap &z = zone[b * n_col + c];
+				z.min = UINT64_MAX;
+				z.max = 0;
+				buf.resize(cnt * col.width);
+				for (uint64_t i = 0; i < cnt; i++){
+					const uint8_t *p = (const uint8_t*)&tf.tr[start + i] + col.offset;
+					memcpy(&buf[i * col.width], p, col.width);
+					if (col.zone){
+						uint64_t v = load_uint(p, col.width);
+						z.min = std::min(z.min, v);
+						z.max = std::max(z.max, v);
+					}
+				}
+				fwrite(buf.data(), 1, buf.size(), file);
+			}
+		}
+		fseek(file, zone_off, SEEK_SET);
+		fwrite(zone.data(), sizeof(ZoneMap), zone.size(), file);
+		fclose(file);
+		return true;
+	}
+
+	bool Open(const char *name){
+		FILE *file = fopen(name, "r");
+		if (file == NULL)
+			return false;
+		char magic[8];
+		uint32_t n_col;
+		if (fread(magic, 8, 1, file) != 1 || memcmp(magic, trace_column_magic, 8) != 0
+				|| fread(&block_size, sizeof(block_size), 1, file) != 1
+				|| fread(&n_col, sizeof(n_col), 1, file) != 1 || n_col != n_trace_column
+				|| fread(&n, sizeof(n), 1, file) != 1 || block_size == 0){
+			fclose(file);
+			return false;
+		}
+		sim_setting.Deserialize(file);
+		uint64_t zone_off = ftell(file);
+		fclose(file);
+		n_block = (n + block_size - 1) / block_size;
+		data_off = (zone_off + n_block * n_col * sizeof(ZoneMap) + 63) / 64 * 64;
+
+		int fd = open(name, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) < 0 || (uint64_t)st.st_size < data_off + n * RecordSize()){
+			close(fd);
+			return false;
+		}
+		len = st.st_size;
+		base = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED){
+			base = NULL;
+			return false;
+		}
+		zone = (const ZoneMap*)((const uint8_t*)base + zone_off);
+		return true;
+	}
+	void Close(){
+		if (base)
+			munmap(base, len);
+		base = NULL;
+	}
+
+	uint64_t BlockCount(uint64_t b){
+		return std::min((uint64_t)block_size, n - b * block_size);
+	}
+	// the array of column c in block b
+	const uint8_t* Column(uint64_t b, uint32_t c){
+		uint64_t cnt = BlockCount(b), off = 0;
+		for (uint32_t i = 0; i < c; i++)
+			off += trace_columns[i].width;
+		return (const uint8_t*)base + data_off + b * block_size * RecordSize() + off * cnt;
+	}
+	const ZoneMap& Zone(uint64_t b, uint32_t c){
+		return zone[b * n_trace_column + c];
+	}
+	// the arrays of all columns in block b
+	void Columns(uint64_t b, const uint8_t *cols[]){
+		for (uint32_t c = 0; c < n_trace_column; c++)
+			cols[c] = Column(b, c);
+	}
+	// reassemble the i-th record of a block, from its Columns()
+	static void Get(const uint8_t * const cols[], uint64_t i, ns3::TraceFormat &tr){
+		memset(&tr, 0, sizeof(tr));
+		for (uint32_t c = 0; c < n_trace_column; c++){
+			uint32_t w = trace_columns[c].width;
+			memcpy((uint8_t*)&tr + trace_columns[c].offset, cols[c] + i * w, w);
+		}
+	}
+
+	static uint64_t RecordSize(){
+		uint64_t s = 0;
+		for (uint32_t c = 0; c < n_trace_column; c++)
+			s += trace_columns[c].width;
+		return s;
+	}
+
+private:
+	void *base;
+	size_t len;
+	uint64_t data_off;
+	const ZoneMap *zone;
+
+	static void Pad(FILE *file){
+		for (long off = ftell(file); off % 64 != 0; off++)
+			fputc(0, file);
+	}
+};
+
+/*
+ * A TraceFilter compiled to a flat postfix program over the columns.
+ * For each block, the program is first run on the zone maps, which tells for every
+ * instruction if it is false (or true) for the whole block. Only the comparisons that
+ * are not decided by the zone maps read their column, in tight loops the compiler vectorizes.
+ */
+class ColumnFilter{
+public:
+	enum{NEVER = 0, MAYBE = 1, ALWAYS = 2};
+	struct Instr{
+		uint8_t type; // 0: compare, 1: &, 2: |
+		uint8_t op; // same as TraceFilter::Field::op
+		uint8_t col;
+		uint8_t width; // width of the field
+		uint32_t sub; // offset of the field in the column's element
+		uint64_t value;
+		bool exact; // the field is the whole column, so the zone map applies
+	};
+	std::vector<Instr> prog;
+
+	// returns false if the filter uses a field that is not in the columns
+	bool Compile(TraceFilter &f){
+		prog.clear();
+		return f.root == NULL || Compile(f.root);
+	}
+
+	// evaluate the filter on block b, set sel[i] to 1 for the matched records; return the number of matches
+	uint32_t Eval(ColumnTraceFile &t, uint64_t b, std::vector<uint8_t> &sel){
+		uint32_t cnt = t.BlockCount(b);
+		sel.resize(cnt);
+		if (prog.empty()){
+			memset(sel.data(), 1, cnt);
+			return cnt;
+		}
+		// decide on the zone maps
+		tri.resize(prog.size());
+		std::vector<uint32_t> st;
+		for (uint32_t i = 0; i < prog.size(); i++){
+			Instr &in = prog[i];
+			if (in.type == 0)
+				tri[i] = in.exact ? ZoneTest(in, t.Zone(b, in.col)) : (uint8_t)MAYBE;
+			else {
+				uint8_t r = tri[st.back()], l = tri[st[st.size() - 2]];
+				st.pop_back();
+				st.pop_back();
+				if (in.type == 1)
+					tri[i] = (l == NEVER || r == NEVER) ? NEVER : (l == ALWAYS && r == ALWAYS) ? ALWAYS : MAYBE;
+				else
+					tri[i] = (l == ALWAYS || r == ALWAYS) ? ALWAYS : (l == NEVER && r == NEVER) ? NEVER : MAYBE;
+			}
+			st.push_back(i);
+		}
+		if (tri.back() != MAYBE){
+			memset(sel.data(), tri.back() == ALWAYS, cnt);
+			return tri.back() == ALWAYS ? cnt : 0;
+		}
+		// evaluate the undecided instructions; a decided subtree does not touch its columns
+		if (bufs.size() < prog.size())
+			bufs.resize(prog.size());
+		st.clear();
+		for (uint32_t i = 0; i < prog.size(); i++){
+			Instr &in = prog[i];
+			if (in.type != 0){
+				uint32_t r = st.back(), l = st[st.size() - 2];
+				st.pop_back();
+				st.pop_back();
+				if (tri[i] == MAYBE){
+					// at most one side is decided, and it does not change the other side
+					if (tri[l] != MAYBE)
+						bufs[i].swap(bufs[r]);
+					else if (tri[r] != MAYBE)
+						bufs[i].swap(bufs[l]);
+					else {
+						bufs[i].swap(bufs[l]);
+						uint8_t *x = bufs[i].data();
+						const uint8_t *y = bufs[r].data();
+						if (in.type == 1)
+							for (uint32_t j = 0; j < cnt; j++)
+								x[j] &= y[j];
+						else
+							for (uint32_t j = 0; j < cnt; j++)
+								x[j] |= y[j];
+					}
+				}
+			}else if (tri[i] == MAYBE){
+				bufs[i].resize(cnt);
+				const uint8_t *col = t.Column(b, in.col);
+				uint32_t stride = trace_columns[in.col].width;
+				if (in.exact){
+					switch (in.width){
+						case 1: Compare((const uint8_t*)col, cnt, in.op, (uint8_t)in.value, bufs[i].data()); break;
+						case 2: Compare((const uint16_t*)col, cnt, in.op, (uint16_t)in.value, bufs[i].data()); break;
+						case 4: Compare((const uint32_t*)col, cnt, in.op, (uint32_t)in.value, bufs[i].data()); break;
+						case 8: Compare((const uint64_t*)col, cnt, in.op, (uint64_t)in.value, bufs[i].data()); break;
+					}
+				}else {
+					for (uint32_t j = 0; j < cnt; j++)
+						bufs[i][j] = CompareOne(load_uint(col + j * stride + in.sub, in.width), in.op, in.value);
+				}
+			}
+			st.push_back(i);
+		}
+		sel.swap(bufs[prog.size() - 1]);
+		uint32_t res = 0;
+		for (uint32_t j = 0; j < cnt; j++)
+			res += sel[j];
+		return res;
+	}
+
+private:
+	std::vector<uint8_t> tri;
+	std::vector<std::vector<uint8_t> > bufs;
+
+	bool Compile(TraceFilter::Node *node){
+		if (node->type != 0){
+			if (!Compile(node->son[0]) || !Compile(node->son[1]))
+				return false;
+			Instr in = {(uint8_t)node->type, 0, 0, 0, 0, 0, false};
+			prog.push_back(in);
+			return true;
+		}
+		TraceFilter::Field *f = node->f;
+		for (uint32_t c = 0; c < n_trace_column; c++){
+			const TraceColumn &col = trace_columns[c];
+			if (f->offset >= col.offset && f->offset + f->size() <= col.offset + col.width){
+				Instr in = {0, f->op, (uint8_t)c, (uint8_t)f->size(), f->offset - col.offset, f->get_value(), false};
+				in.exact = col.zone && in.sub == 0 && in.width == col.width;
+				prog.push_back(in);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	static bool CompareOne(uint64_t x, uint8_t op, uint64_t v){
+		switch (op){
+			case 0: return x == v;
+			case 1: return x > v;
+			case 2: return x >= v;
+			case 3: return x < v;
+			case 4: return x <= v;
+			case 5: return x != v;
+			default: return false;
+		}
+	}
+	#define CMP_LOOP(expr) for (uint32_t i = 0; i < n; i++) out[i] = (expr)
+	template<typename T>
+	static void Compare(const T *x, uint32_t n, uint8_t op, T v, uint8_t *out){
+		switch (op){
+			case 0: CMP_LOOP(x[i] == v); break;
+			case 1: CMP_LOOP(x[i] > v); break;
+			case 2: CMP_LOOP(x[i] >= v); break;
+			case 3: CMP_LOOP(x[i] < v); break;
+			case 4: CMP_LOOP(x[i] <= v); break;
+			case 5: CMP_LOOP(x[i] != v); break;
+			default: memset(out, 0, n);
+		}
+	}
+	#undef CMP_LOOP
+
+	static uint8_t ZoneTest(Instr &in, const ZoneMap &z){
+		uint64_t v = in.value;
+		switch (in.op){
+			case 0: return (v < z.min || v > z.max) ? NEVER : (z.min == v && z.max == v) ? ALWAYS : MAYBE;
+			case 1: return z.max <= v ? NEVER : z.min > v ? ALWAYS : MAYBE;
+			case 2: return z.max < v ? NEVER : z.min >= v ? ALWAYS : MAYBE;
+			case 3: return z.min >= v ? NEVER : z.max < v ? ALWAYS : MAYBE;
+			case 4: return z.min > v ? NEVER : z.max <= v ? ALWAYS : MAYBE;
+			case 5: return (v < z.min || v > z.max) ? ALWAYS : (z.min == v && z.max == v) ? NEVER : MAYBE;
+			default: return NEVER;
+		}
+	}
+};
+
+#endif /* TRACE_COLUMN_HPP */
@@ -0,0 +1,27 @@
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include "trace_column.hpp"
+
+int main(int argc, char** argv){
+	uint32_t block_size = 65536;
+	for (int opt; (opt = getopt(argc, argv, "b:")) != -1;){
+		switch (opt){
+			case 'b':
+				block_size = atoi(optarg);
+				break;
+			default:
+				printf("Usage: %s [-b BLOCK_SIZE] <.tr file> <.trc file>\n", argv[0]);
+				return 0;
+		}
+	}
+	if (optind + 2 != argc){
+		printf("Usage: %s [-b BLOCK_SIZE] <.tr file> <.trc file>\n", argv[0]);
+		return 0;
+	}
+	if (!ColumnTraceFile::Convert(argv[optind], argv[optind + 1], block_size)){
+		printf("Failed to convert %s (the block size must be a multiple of 64)\n", argv[optind]);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef TRACE_FILE_HPP
+#define TRACE_FILE_HPP
+
+#include <cstdio>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace-format.h"
+#include "sim-setting.h"
+
+/*
+ * A .tr file mapped in memory: the SimSetting header followed by an array of TraceFormat.
+ * The records are in the order they were written, i.e., in time order.
+ */
+class TraceFile{
+public:
+	SimSetting sim_setting;
+	const ns3::TraceFormat *tr; // the records
+	uint64_t n; // number of records
+
+	TraceFile() : tr(NULL), n(0), base(NULL), len(0) {}
+	~TraceFile(){
+		Close();
+	}
+
+	bool Open(const char *name){
+		// the header has variable length, read it with stdio
+		FILE *file = fopen(name, "r");
+		if (file == NULL)
+			return false;
+		sim_setting.Deserialize(file);
+		long off = ftell(file);
+		fclose(file);
+
+		int fd = open(name, O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size < off){
+			close(fd);
+			return false;
+		}
+		len = st.st_size;
+		n = (len - off) / sizeof(ns3::TraceFormat);
+		if (len > 0){
+			base = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (base == MAP_FAILED){
+				base = NULL;
+				close(fd);
+				return false;
+			}
+			madvise(base, len, MADV_SEQUENTIAL);
+		}
+		close(fd);
+		tr = (const ns3::TraceFormat*)((const char*)base + off);
+		return true;
+	}
+	void Close(){
+		if (base)
+			munmap(base, len);
+		base = NULL;
+		tr = NULL;
+		n = 0;
+	}
+
+private:
+	void *base;
+	size_t len;
+};
+
+#endif /* TRACE_FILE_HPP */
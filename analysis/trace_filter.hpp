@@ -6,6 +6,7 @@
 #include <cctype>
 #include <regex>
 #include <sstream>
+#include <cstring>
 #include "trace-format.h"
 
 class TraceFilter{
@@ -52,6 +53,8 @@ public:
 		}
 		virtual bool test(ns3::TraceFormat &tr) = 0;
 		virtual std::string str() = 0;
+		virtual uint32_t size() = 0; // size of the field in bytes
+		virtual uint64_t get_value() = 0;
 	};
 	#define OP(type) \
 		do {\
@@ -72,6 +75,12 @@ public:
 		virtual bool test(ns3::TraceFormat &tr){
 			OP(uint8_t);
 		}
+		uint32_t size(){
+			return sizeof(uint8_t);
+		}
+		uint64_t get_value(){
+			return value;
+		}
 		std::string str(){
 			std::stringstream s;
 			s << '[' << offset << ']' << op_str() << (int32_t)value;
@@ -85,6 +94,12 @@ public:
 		virtual bool test(ns3::TraceFormat &tr){
 			OP(uint16_t);
 		}
+		uint32_t size(){
+			return sizeof(uint16_t);
+		}
+		uint64_t get_value(){
+			return value;
+		}
 		std::string str(){
 			std::stringstream s;
 			s << '[' << offset << ']' << op_str() << value;
@@ -98,6 +113,12 @@ public:
 		virtual bool test(ns3::TraceFormat &tr){
 			OP(uint32_t);
 		}
+		uint32_t size(){
+			return sizeof(uint32_t);
+		}
+		uint64_t get_value(){
+			return value;
+		}
 		std::string str(){
 			std::stringstream s;
 			s << '[' << offset << ']' << op_str() << value;
@@ -111,6 +132,12 @@ public:
 		virtual bool test(ns3::TraceFormat &tr){
 			OP(uint64_t);
 		}
+		uint32_t size(){
+			return sizeof(uint64_t);
+		}
+		uint64_t get_value(){
+			return value;
+		}
 		std::string str(){
 			std::stringstream s;
 			s << '[' << offset << ']' << op_str() << value;
@@ -189,7 +216,21 @@ public:
 	Field* GetField(std::string field, std::string op, std::string value){
 		Field *f = NULL;
 		uint64_t v;
-		sscanf(value.c_str(), "%li", &v);
+		double t;
+		char unit[4];
+		if (sscanf(value.c_str(), "%lf%3s", &t, unit) == 2){ // time with unit, e.g., 2.001s
+			if (strcmp(unit, "s") == 0)
+				v = t * 1e9 + 0.5;
+			else if (strcmp(unit, "ms") == 0)
+				v = t * 1e6 + 0.5;
+			else if (strcmp(unit, "us") == 0)
+				v = t * 1e3 + 0.5;
+			else if (strcmp(unit, "ns") == 0)
+				v = t + 0.5;
+			else
+				return NULL;
+		}else
+			sscanf(value.c_str(), "%li", &v);
 		if (field == "time"){
 			f = new QwordField(offsetof(ns3::TraceFormat, time), op, v);
 		}else if (field == "node"){
@@ -235,7 +276,7 @@ public:
 	}
 	
 	#define OP_COMPARE "=|>|>=|<|<=|!="
-	#define BASE_EXPR_REGEX "\\s*([a-zA-Z0-9\\.]+)\\s*(" OP_COMPARE")\\s*([x,[:xdigit:]]+)\\s*"
+	#define BASE_EXPR_REGEX "\\s*([a-zA-Z0-9\\.]+)\\s*(" OP_COMPARE")\\s*([x,\\.[:xdigit:]]+(s|ms|us|ns)?)\\s*"
 	// the real implementation of parse, allows recursion
 	Node* _parse(std::string expr){
 		expr = strip_outer_bracket(expr);
@@ -271,8 +312,8 @@ public:
 						return NULL;
 				}
 				// assign right str
-				right_str = m[5].str();
-				op_str = m[4].str();
+				right_str = m[6].str();
+				op_str = m[5].str();
 			}else { // (base expression) &| other things
 				uint32_t start, i = 0;
 				// get left
@@ -1,46 +1,288 @@
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <unistd.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 #include "trace-format.h"
 #include "trace_filter.hpp"
+#include "trace_file.hpp"
+#include "trace_column.hpp"
 #include "utils.hpp"
 #include "sim-setting.h"
 
 using namespace ns3;
 using namespace std;
 
+enum AggType{
+	AGG_NONE = 0, // print the matched traces
+	AGG_GOODPUT, // per-flow payload bytes received by the destination host, per interval
+	AGG_QLEN, // per-port max queue length, per interval
+	AGG_DROP, // per-port number of drops
+	AGG_PFC, // per-port number of PFC pause/resume received
+	AGG_CNP // per-flow number of CNPs received by the sender, per interval
+};
+
+uint32_t n_thread = 0;
+AggType agg = AGG_NONE;
+uint64_t interval = 10000; // ns
+uint64_t block_size = 1 << 18; // number of records per block; a .trc file has its own
+
+bool parse_agg(const char *s, AggType &a){
+	if (strcmp(s, "goodput") == 0)
+		a = AGG_GOODPUT;
+	else if (strcmp(s, "qlen") == 0)
+		a = AGG_QLEN;
+	else if (strcmp(s, "drop") == 0)
+		a = AGG_DROP;
+	else if (strcmp(s, "pfc") == 0)
+		a = AGG_PFC;
+	else if (strcmp(s, "cnp") == 0)
+		a = AGG_CNP;
+	else
+		return false;
+	return true;
+}
+
+// each thread aggregates into its own Aggregator, and they are merged in the end
+struct Aggregator{
+	// key (flow or port) -> time slot (or counter index) -> value
+	unordered_map<uint64_t, map<uint64_t, uint64_t> > data;
+
+	void Add(TraceFormat &tr){
+		switch (agg){
+			case AGG_GOODPUT:
+				if (tr.event == Recv && tr.nodeType == 0 && tr.l3Prot == 0x11)
+					data[GetFlowInt(tr)][tr.time / interval] += tr.data.payload;
+				break;
+			case AGG_QLEN:
+				if (tr.event == Enqu || tr.event == Dequ){
+					uint64_t &v = data[GetDevInt(tr.node, tr.intf)][tr.time / interval];
+					v = max(v, (uint64_t)tr.qlen);
+				}
+				break;
+			case AGG_DROP:
+				if (tr.event == Drop)
+					data[GetDevInt(tr.node, tr.intf)][0]++;
+				break;
+			case AGG_PFC:
+				if (tr.event == Recv && tr.l3Prot == 0xFE)
+					data[GetDevInt(tr.node, tr.intf)][tr.pfc.time > 0 ? 0 : 1]++;
+				break;
+			case AGG_CNP:
+				// the CNP is carried by the ACK/NACK's flag in this simulator. A QCN CNP (0xFF) goes from the receiver
+				// to the sender and only has the sport of the flow (fid), so its flow has dport 0
+				if (tr.event == Recv && tr.nodeType == 0 && tr.l3Prot == 0xFF)
+					data[GetFlowInt(tr.dip, tr.sip, tr.cnp.fid, 0)][tr.time / interval]++;
+				else if (tr.event == Recv && tr.nodeType == 0 && (tr.l3Prot == 0xFC || tr.l3Prot == 0xFD) && (tr.ack.flags & 1))
+					data[GetStandardFlowInt(tr)][tr.time / interval]++;
+				break;
+			default:
+				break;
+		}
+	}
+	void Merge(Aggregator &o){
+		for (auto &k : o.data){
+			map<uint64_t, uint64_t> &m = data[k.first];
+			for (auto &t : k.second){
+				if (agg == AGG_QLEN)
+					m[t.first] = max(m[t.first], t.second);
+				else
+					m[t.first] += t.second;
+			}
+		}
+	}
+	void Print(){
+		vector<uint64_t> keys;
+		for (auto &k : data)
+			keys.push_back(k.first);
+		sort(keys.begin(), keys.end());
+		for (uint64_t k : keys){
+			map<uint64_t, uint64_t> &m = data[k];
+			// flow: src(16) dst(16) sport(16) dport(16); port: node(16) intf(8)
+			uint32_t src = k >> 48, dst = (k >> 32) & 0xffff, sport = (k >> 16) & 0xffff, dport = k & 0xffff;
+			uint32_t node = k >> 8, intf = k & 0xff;
+			switch (agg){
+				case AGG_GOODPUT:
+					for (auto &t : m)
+						printf("%u %u %u %u %lu %.3lf\n", src, dst, sport, dport, t.first * interval, t.second * 8.0 / interval);
+					break;
+				case AGG_QLEN:
+					for (auto &t : m)
+						printf("%u %u %lu %lu\n", node, intf, t.first * interval, t.second);
+					break;
+				case AGG_DROP:
+					printf("%u %u %lu\n", node, intf, m[0]);
+					break;
+				case AGG_PFC:
+					printf("%u %u %lu %lu\n", node, intf, m[0], m[1]);
+					break;
+				case AGG_CNP:
+					for (auto &t : m)
+						printf("%u %u %u %u %lu %.3lf\n", src, dst, sport, dport, t.first * interval, t.second * 1e9 / interval);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+};
+
+void usage(const char *name){
+	printf("Usage: %s [-j THREADS] [-a AGG] [-i INTERVAL] <trace_file (.tr or .trc)> [filter_expr]\n"
+			"  -j THREADS    number of threads, by default the number of cores\n"
+			"  -a AGG        aggregate the matched traces instead of printing them:\n"
+			"                goodput: per flow, the payload received by the destination host in each interval (Gbps)\n"
+			"                qlen: per port, the max queue length in each interval (B)\n"
+			"                drop: per port, the number of drops\n"
+			"                pfc: per port, the number of PFC pause and resume received\n"
+			"                cnp: per flow, the CNPs received by the sender in each interval (per second)\n"
+			"  -i INTERVAL   the interval of the timelines (ns), by default 10000\n", name);
+}
+
 int main(int argc, char** argv){
-	if (argc != 2 && argc != 3){
-		printf("Usage: ./trace_reader <trace_file> [filter_expr]\n");
+	for (int opt; (opt = getopt(argc, argv, "j:a:i:h")) != -1;){
+		switch (opt){
+			case 'j':
+				n_thread = atoi(optarg);
+				break;
+			case 'a':
+				if (!parse_agg(optarg, agg)){
+					printf("Unknown aggregation: %s\n", optarg);
+					return 0;
+				}
+				break;
+			case 'i':
+				interval = atoll(optarg);
+				break;
+			default:
+				usage(argv[0]);
+				return 0;
+		}
+	}
+	if ((optind + 1 != argc && optind + 2 != argc) || interval == 0){
+		usage(argv[0]);
+		return 0;
+	}
+	// either a .tr file or a columnar .trc file
+	bool columnar = ColumnTraceFile::IsColumnTrace(argv[optind]);
+	TraceFile file;
+	ColumnTraceFile cfile;
+	if (columnar ? !cfile.Open(argv[optind]) : !file.Open(argv[optind])){
+		printf("Cannot open %s\n", argv[optind]);
 		return 0;
 	}
-	FILE* file = fopen(argv[1], "r");
 	TraceFilter f;
-	if (argc == 3){
-		f.parse(argv[2]);
+	if (optind + 2 == argc){
+		f.parse(argv[optind + 1]);
 		if (f.root == NULL){
 			printf("Invalid filter\n");
 			return 0;
 		}
 	}
+	ColumnFilter cf;
+	if (columnar){
+		if (!cf.Compile(f)){
+			printf("The filter uses a field not in the columnar trace\n");
+			return 0;
+		}
+		block_size = cfile.block_size;
+	}
+	uint64_t n_record = columnar ? cfile.n : file.n;
 	//printf("filter: %s\n", f.str().c_str());
+	if (n_thread == 0)
+		n_thread = max(1u, thread::hardware_concurrency());
+
+	// the threads take blocks of records in order. The output of each block is buffered,
+	// and the main thread writes the blocks in order, so the output is still in time order.
+	uint64_t n_block = (n_record + block_size - 1) / block_size;
+	atomic<uint64_t> next_block(0);
+	vector<string> out(agg == AGG_NONE ? n_block : 0);
+	vector<char> done(n_block, 0);
+	uint64_t n_written = 0;
+	mutex mtx;
+	condition_variable cv_done, cv_written;
+	vector<Aggregator> aggs(n_thread);
+
+	vector<thread> threads;
+	for (uint32_t i = 0; i < n_thread; i++)
+		threads.push_back(thread([&, i](){
+			char buf[512];
+			TraceFormat tr;
+			ColumnFilter cf_local = cf; // the compiled filter has per-block buffers
+			vector<uint8_t> sel;
+			const uint8_t *cols[n_trace_column];
+			for (uint64_t b; (b = next_block++) < n_block;){
+				if (agg == AGG_NONE){
+					// do not run too far ahead of the writer, to bound the memory
+					unique_lock<mutex> lock(mtx);
+					cv_written.wait(lock, [&](){ return b < n_written + 4 * n_thread; });
+				}
+				string s;
+				auto output = [&](){
+					if (agg == AGG_NONE)
+						s.append(buf, sprint_trace(buf, sizeof(buf), tr));
+					else
+						aggs[i].Add(tr);
+				};
+				if (columnar){
+					// the zone maps may skip the whole block without reading it
+					if (cf_local.Eval(cfile, b, sel) > 0){
+						cfile.Columns(b, cols);
+						for (uint64_t j = 0; j < sel.size(); j++)
+							if (sel[j]){
+								ColumnTraceFile::Get(cols, j, tr);
+								output();
+							}
+					}
+				}else {
+					uint64_t end = min(file.n, (b + 1) * block_size);
+					for (uint64_t j = b * block_size; j < end; j++){
+						memcpy(&tr, &file.tr[j], sizeof(tr)); // the records may be unaligned
+						if (f.test(tr))
+							output();
+					}
+				}
+				if (agg == AGG_NONE){
+					lock_guard<mutex> lock(mtx);
+					out[b].swap(s);
+					done[b] = 1;
+					cv_done.notify_all();
+				}
+			}
+		}));
+
+	if (agg == AGG_NONE){
+		for (uint64_t b = 0; b < n_block; b++){
+			string s;
+			{
+				unique_lock<mutex> lock(mtx);
+				cv_done.wait(lock, [&](){ return done[b] != 0; });
+				out[b].swap(s);
+			}
+			fwrite(s.data(), 1, s.size(), stdout);
+			{
+				lock_guard<mutex> lock(mtx);
+				n_written = b + 1;
+			}
+			cv_written.notify_all();
+		}
+	}
+	for (auto &t : threads)
+		t.join();
 
-	// first read SimSetting
-	SimSetting sim_setting;
-	sim_setting.Deserialize(file);
-	#if 0
-	// print sim_setting
-	for (auto i : sim_setting.port_speed)
-		for (auto j : i.second)
-			printf("%u,%u:%lu\n", i.first, j.first, j.second);
-	#endif
-
-	// read trace
-	TraceFormat tr;
-	while (tr.Deserialize(file) > 0){
-		if (!f.test(tr))
-			continue;
-		print_trace(tr);
+	if (agg != AGG_NONE){
+		for (uint32_t i = 1; i < n_thread; i++)
+			aggs[0].Merge(aggs[i]);
+		aggs[0].Print();
 	}
+	return 0;
 }
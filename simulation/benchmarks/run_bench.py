@@ -0,0 +1,239 @@
+from __future__ import print_function
+import argparse
+import hashlib
+import json
+import os
+import platform
+import resource
+import subprocess
+import sys
+import time
+
+from scenarios import SCENARIOS, SUITES, BASE_T, generate
+
+SIM_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..')
+
+# HPCC at 100Gbps, same settings as `python run.py --cc hp --bw 100`
+config_template="""ENABLE_QCN 1
+USE_DYNAMIC_PFC_THRESHOLD 1
+
+PACKET_PAYLOAD_SIZE 1000
+
+TOPOLOGY_FILE {topo}
+FLOW_FILE {flow}
+TRACE_FILE {trace}
+TRACE_OUTPUT_FILE {out}/{name}.tr
+FCT_OUTPUT_FILE {out}/{name}_fct.txt
+PFC_OUTPUT_FILE {out}/{name}_pfc.txt
+
+SIMULATOR_STOP_TIME {stop}
+
+CC_MODE 3
+ALPHA_RESUME_INTERVAL 1
+RATE_DECREASE_INTERVAL 4
+CLAMP_TARGET_RATE 0
+RP_TIMER 300
+EWMA_GAIN 0.00390625
+FAST_RECOVERY_TIMES 1
+RATE_AI 40Mb/s
+RATE_HAI 40Mb/s
+MIN_RATE 1000Mb/s
+DCTCP_RATE_AI 1000Mb/s
+
+ERROR_RATE_PER_LINK 0.0000
+L2_CHUNK_SIZE 4000
+L2_ACK_INTERVAL 1
+L2_BACK_TO_ZERO 0
+
+HAS_WIN 1
+GLOBAL_T 1
+VAR_WIN 1
+FAST_REACT 1
+U_TARGET 0.95
+MI_THRESH 0
+INT_MULTI 4
+MULTI_RATE 0
+SAMPLE_FEEDBACK 0
+PINT_LOG_BASE 1.01
+PINT_PROB 1.0
+
+RATE_BOUND 1
+
+ACK_HIGH_PRIO 0
+
+LINK_DOWN 0 0 0
+
+ENABLE_TRACE 0
+
+KMAX_MAP 1 100000000000 1600
+KMIN_MAP 1 100000000000 400
+PMAX_MAP 1 100000000000 0.20
+BUFFER_SIZE 32
+QLEN_MON_FILE {out}/{name}_qlen.txt
+QLEN_MON_START 2000000000
+QLEN_MON_END 2000000000
+"""
+
+def fct_summary(path):
+	# checksum over the sorted FCT rows, so that the order of completion does not matter
+	rows = sorted(l.strip() for l in open(path) if l.strip())
+	h = hashlib.sha1()
+	total = 0
+	for r in rows:
+		h.update((r + "\n").encode())
+		total += int(r.split()[6])
+	return {'n_flows_done': len(rows), 'fct_sha1': h.hexdigest(), 'fct_sum_ns': total}
+
+def run_child(argv, log, env):
+	# returns the exit status and the peak RSS (KB) of argv. The peak RSS of RUSAGE_CHILDREN is the max over all
+	# waited children, so the simulation is waited by an intermediate child, whose only child it is
+	r, w = os.pipe()
+	pid = os.fork()
+	if pid == 0:
+		os.close(r)
+		p = subprocess.Popen(argv, stdout=log, stderr=subprocess.STDOUT, cwd=SIM_DIR, env=env)
+		_, status = os.waitpid(p.pid, 0)
+		os.write(w, ("%d %d"%(status, resource.getrusage(resource.RUSAGE_CHILDREN).ru_maxrss)).encode())
+		os._exit(0)
+	os.close(w)
+	res = os.read(r, 64).decode().split()
+	os.close(r)
+	os.waitpid(pid, 0)
+	return int(res[0]), int(res[1])
+
+def check_fork(name, args):
+	# a fork sweep with two variants identical to the parent: all three must give the same FCT file
+	out = os.path.join(args.out_dir, name)
+	cfg = os.path.join(out, "config.txt")
+	fork_cfg = os.path.join(out, "config_fork.txt")
+	fct = os.path.join(out, "%s_fct.txt"%name)
+	with open(fork_cfg, "w") as f:
+		f.write(open(cfg).read())
+		f.write("FORK_TIME %.9f\nFORK_VARIANT a U_TARGET 0.95\nFORK_VARIANT b U_TARGET 0.95\n"%((BASE_T + 1000) / 1e9))
+	env = dict(os.environ)
+	env['LD_LIBRARY_PATH'] = args.lib_dir + ':' + env.get('LD_LIBRARY_PATH', '')
+	log = open(os.path.join(out, "stdout_fork.txt"), "w")
+	status, _ = run_child([args.binary, fork_cfg], log, env)
+	log.close()
+	if status != 0:
+		print("%s: fork check failed (status %d), see %s/stdout_fork.txt"%(name, status, out))
+		return False
+	ref = fct_summary(fct)
+	for v in ['a', 'b']:
+		r = fct_summary(os.path.join(out, "%s_fct_%s.txt"%(name, v)))
+		if r['fct_sha1'] != ref['fct_sha1']:
+			print("%s: fork check failed, variant %s has %d flows done, the parent %d"%(name, v, r['n_flows_done'], ref['n_flows_done']))
+			return False
+	print("%-14s fork check OK"%name)
+	return True
+
+def run_one(name, args):
+	out = os.path.join(args.out_dir, name)
+	if not os.path.exists(out):
+		os.makedirs(out)
+	topo, flow, stop = generate(name, out, args.seed)
+	trace = os.path.join(out, "trace.txt")
+	with open(trace, "w") as f:
+		f.write("0\n")
+	cfg = os.path.join(out, "config.txt")
+	with open(cfg, "w") as f:
+		f.write(config_template.format(topo=topo, flow=flow, trace=trace, out=out, name=name, stop=stop))
+	n_flows = int(open(flow).readline())
+
+	env = dict(os.environ)
+	env['LD_LIBRARY_PATH'] = args.lib_dir + ':' + env.get('LD_LIBRARY_PATH', '')
+	log = open(os.path.join(out, "stdout.txt"), "w")
+	t0 = time.time()
+	status, rss = run_child([args.binary, cfg], log, env)
+	wall = time.time() - t0
+	log.close()
+	if status != 0:
+		print("%s: simulation failed (status %d), see %s/stdout.txt"%(name, status, out))
+		return None
+
+	events = sim_ns = 0
+	for line in open(os.path.join(out, "stdout.txt")):
+		if line.startswith("SIM_STATS"):
+			s = line.split()
+			events, sim_ns = int(s[2]), int(s[4])
+	res = {
+		'wall_s': wall,
+		'events': events,
+		'events_per_s': events / wall,
+		'sim_ns': sim_ns,
+		# nothing happens before the first flow starts at BASE_T
+		'sim_ns_per_wall_s': (sim_ns - BASE_T) / wall,
+		'peak_rss_kb': rss,
+		'n_flows': n_flows,
+	}
+	res.update(fct_summary(os.path.join(out, "%s_fct.txt"%name)))
+	print("%-14s wall %8.2fs  %10.0f ev/s  %10.0f sim-ns/s  rss %7d KB  flows %d/%d"%(name, wall, res['events_per_s'], res['sim_ns_per_wall_s'], res['peak_rss_kb'], res['n_flows_done'], n_flows))
+	return res
+
+def compare(results, baseline, tol):
+	# returns the number of regressions; FCT changes are reported but not counted
+	n_reg = 0
+	for name in sorted(results):
+		if name not in baseline:
+			print("%-14s no baseline"%name)
+			continue
+		r, b = results[name], baseline[name]
+		ratio = r['wall_s'] / b['wall_s']
+		rss_ratio = float(r['peak_rss_kb']) / b['peak_rss_kb']
+		flag = ''
+		if ratio > 1 + tol or rss_ratio > 1 + tol:
+			flag = 'REGRESSION'
+			n_reg += 1
+		fct = 'same' if r['fct_sha1'] == b['fct_sha1'] else 'CHANGED (%d flows, fct sum %+.3f%%)'%(r['n_flows_done'], 100. * (r['fct_sum_ns'] - b['fct_sum_ns']) / max(1, b['fct_sum_ns']))
+		print("%-14s wall x%.3f  rss x%.3f  fct %s %s"%(name, ratio, rss_ratio, fct, flag))
+	return n_reg
+
+if __name__ == "__main__":
+	parser = argparse.ArgumentParser(description='run the simulator benchmark suite')
+	parser.add_argument('--suite', dest='suite', action='store', default='quick', help="quick/full")
+	parser.add_argument('--scenario', dest='scenario', action='append', help="run only this scenario (repeatable): " + ", ".join(sorted(SCENARIOS)))
+	parser.add_argument('--binary', dest='binary', action='store', default=os.path.join(SIM_DIR, 'build', 'scratch', 'third'), help="the built scratch/third")
+	parser.add_argument('--lib_dir', dest='lib_dir', action='store', default=os.path.join(SIM_DIR, 'build'), help="where the ns-3 libraries are")
+	parser.add_argument('--out_dir', dest='out_dir', action='store', default=os.path.join(SIM_DIR, 'benchmarks', 'out'), help="where inputs and outputs are written")
+	parser.add_argument('--seed', dest='seed', action='store', type=int, default=1, help="seed for the flow generation")
+	parser.add_argument('--result', dest='result', action='store', default='result.json', help="the JSON result file")
+	parser.add_argument('--baseline', dest='baseline', action='store', default=os.path.join(SIM_DIR, 'benchmarks', 'baseline.json'), help="the JSON baseline to compare against")
+	parser.add_argument('--save_baseline', dest='save_baseline', action='store_true', help="store this run as the new baseline")
+	parser.add_argument('--check_fork', dest='check_fork', action='store_true', help="after each scenario, check that a fork sweep with identical variants gives identical FCT files")
+	parser.add_argument('--tol', dest='tol', action='store', type=float, default=0.1, help="allowed slowdown before reporting a regression")
+	args = parser.parse_args()
+
+	names = args.scenario if args.scenario else SUITES[args.suite]
+	for n in names:
+		if n not in SCENARIOS:
+			print("unknown scenario:", n)
+			sys.exit(1)
+
+	results = {}
+	for n in names:
+		r = run_one(n, args)
+		if r is not None:
+			results[n] = r
+		if r is not None and args.check_fork and not check_fork(n, args):
+			sys.exit(3)
+
+	doc = {
+		'host': platform.node(),
+		'time': time.strftime("%Y-%m-%d %H:%M:%S"),
+		'seed': args.seed,
+		'results': results,
+	}
+	with open(args.result, "w") as f:
+		json.dump(doc, f, indent=1, sort_keys=True)
+
+	if args.save_baseline:
+		with open(args.baseline, "w") as f:
+			json.dump(doc, f, indent=1, sort_keys=True)
+		sys.exit(0)
+
+	if os.path.exists(args.baseline):
+		baseline = json.load(open(args.baseline))['results']
+		if compare(results, baseline, args.tol) > 0:
+			sys.exit(2)
+	if len(results) < len(names):
+		sys.exit(1)
@@ -0,0 +1,141 @@
+import os
+import sys
+import random
+import math
+import heapq
+
+# reuse the CDF sampler of the traffic generator
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'traffic_gen'))
+from custom_rand import CustomRand
+
+CDF_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', '..', 'traffic_gen')
+
+# all flows start after 2s, like traffic_gen.py
+BASE_T = 2000000000
+
+LINK_RATE = '100Gbps'
+LINK_DELAY = '1000ns'
+
+def fat_tree(k):
+	# hosts first (0..k^3/4-1), then edge, agg and core switches
+	half = k // 2
+	nhost = k * half * half
+	n_edge = n_agg = k * half
+	n_core = half * half
+	edge0 = nhost
+	agg0 = edge0 + n_edge
+	core0 = agg0 + n_agg
+	links = []
+	for p in range(k):
+		for e in range(half):
+			edge = edge0 + p * half + e
+			for h in range(half):
+				links.append((p * half * half + e * half + h, edge))
+			for a in range(half):
+				links.append((edge, agg0 + p * half + a))
+		for a in range(half):
+			for c in range(half):
+				links.append((agg0 + p * half + a, core0 + a * half + c))
+	switches = list(range(nhost, core0 + n_core))
+	return nhost, core0 + n_core, switches, links
+
+def write_topology(path, k):
+	nhost, nnode, switches, links = fat_tree(k)
+	with open(path, 'w') as f:
+		f.write("%d %d %d\n"%(nnode, len(switches), len(links)))
+		f.write(" ".join(str(s) for s in switches) + "\n")
+		for a, b in links:
+			f.write("%d %d %s %s 0.000000\n"%(a, b, LINK_RATE, LINK_DELAY))
+	return nhost
+
+def write_flows(path, flows):
+	# flows: [(src, dst, size, t_ns)], written in start-time order as third.cc expects
+	flows.sort(key = lambda x: x[3])
+	with open(path, 'w') as f:
+		f.write("%d\n"%len(flows))
+		for src, dst, size, t in flows:
+			f.write("%d %d 3 100 %d %.9f\n"%(src, dst, size, t * 1e-9))
+
+def incast(nhost, rnd, size):
+	# 2:1 incast: hosts are grouped in triples, two senders hit one receiver
+	hosts = list(range(nhost))
+	rnd.shuffle(hosts)
+	flows = []
+	for i in range(0, nhost - 2, 3):
+		a, b, dst = hosts[i:i+3]
+		flows.append((a, dst, size, BASE_T))
+		flows.append((b, dst, size, BASE_T))
+	return flows
+
+def permutation(nhost, rnd, size):
+	# random derangement, every host sends to exactly one other host
+	while True:
+		perm = list(range(nhost))
+		rnd.shuffle(perm)
+		if all(perm[i] != i for i in range(nhost)):
+			break
+	return [(i, perm[i], size, BASE_T) for i in range(nhost)]
+
+def all_to_all(nhost, rnd, size):
+	return [(i, j, size, BASE_T) for i in range(nhost) for j in range(nhost) if i != j]
+
+def cdf_load(nhost, rnd, cdf_file, load, bw, duration):
+	# same Poisson process as traffic_gen.py, but with a private seeded RNG
+	cdf = []
+	for line in open(os.path.join(CDF_DIR, cdf_file)):
+		if line.strip():
+			x, y = map(float, line.split())
+			cdf.append([x, y])
+	customRand = CustomRand()
+	if not customRand.setCdf(cdf):
+		raise ValueError("invalid cdf: %s"%cdf_file)
+	avg = customRand.getAvg()
+	avg_inter_arrival = 1 / (bw * load / 8. / avg) * 1000000000
+	def poisson():
+		return -math.log(1 - rnd.random()) * avg_inter_arrival
+	flows = []
+	host_list = [(BASE_T + int(poisson()), i) for i in range(nhost)]
+	heapq.heapify(host_list)
+	while len(host_list) > 0:
+		t, src = host_list[0]
+		if t > BASE_T + duration:
+			heapq.heappop(host_list)
+			continue
+		dst = rnd.randint(0, nhost - 1)
+		while dst == src:
+			dst = rnd.randint(0, nhost - 1)
+		y = rnd.random() * 100
+		size = max(1, int(customRand.getValueFromPercentile(y)))
+		flows.append((src, dst, size, t))
+		heapq.heapreplace(host_list, (t + int(poisson()), src))
+	return flows
+
+# name: (k, generator, args, stop time (s))
+SCENARIOS = {
+	'incast_k4':     (4,  incast,      (1000000,), 2.01),
+	'incast_k8':     (8,  incast,      (1000000,), 2.01),
+	'perm_k4':       (4,  permutation, (1000000,), 2.01),
+	'perm_k8':       (8,  permutation, (1000000,), 2.01),
+	'a2a_k4':        (4,  all_to_all,  (100000,),  2.01),
+	'websearch_k4':  (4,  cdf_load,    ('WebSearch_distribution.txt', 0.3, 100e9, 10000000), 2.05),
+	'websearch_k8':  (8,  cdf_load,    ('WebSearch_distribution.txt', 0.3, 100e9, 5000000),  2.05),
+	'websearch_k16': (16, cdf_load,    ('WebSearch_distribution.txt', 0.3, 100e9, 2000000),  2.05),
+	'fbhdp_k4':      (4,  cdf_load,    ('FbHdp_distribution.txt', 0.3, 100e9, 10000000), 2.05),
+	'fbhdp_k8':      (8,  cdf_load,    ('FbHdp_distribution.txt', 0.3, 100e9, 5000000),  2.05),
+	'fbhdp_k16':     (16, cdf_load,    ('FbHdp_distribution.txt', 0.3, 100e9, 2000000),  2.05),
+}
+
+SUITES = {
+	'quick': ['incast_k4', 'perm_k4', 'a2a_k4', 'websearch_k4', 'fbhdp_k4'],
+	'full': sorted(SCENARIOS.keys()),
+}
+
+def generate(name, out_dir, seed):
+	# write <name>_topo.txt and <name>_flow.txt, return (topo, flow, stop_time)
+	k, gen, args, stop = SCENARIOS[name]
+	rnd = random.Random(seed)
+	topo = os.path.join(out_dir, "%s_topo.txt"%name)
+	flow = os.path.join(out_dir, "%s_flow.txt"%name)
+	nhost = write_topology(topo, k)
+	write_flows(flow, gen(nhost, rnd, *args))
+	return topo, flow, stop
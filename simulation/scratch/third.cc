@@ -20,7 +20,13 @@
 #include <iostream>
 #include <fstream>
 #include <unordered_map>
+#include <unordered_set>
 #include <time.h> 
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <sstream>
+#include <algorithm>
 #include "ns3/core-module.h"
 #include "ns3/qbb-helper.h"
 // the header of ACK
@@ -41,6 +47,10 @@
 // #the node class for switch
 
 #include <ns3/sim-setting.h>
+#include <ns3/flow-generator.h>
+#include <ns3/pfc-monitor.h>
+#include <ns3/collective-engine.h>
+#include <ns3/rpc-engine.h>
 
 using namespace ns3;
 using namespace std;
@@ -63,7 +73,19 @@ uint32_t fast_recovery_times = 5;
 std::string rate_ai, rate_hai, min_rate = "100Mb/s";
 std::string dctcp_rate_ai = "1000Mb/s";
 
-bool clamp_target_rate = false, l2_back_to_zero = false;
+bool clamp_target_rate = false, l2_back_to_zero = false, l2_selective_repeat = false, ack_coalesce_max_qlen = true;
+uint32_t ack_coalesce_count = 0;
+uint64_t ack_coalesce_time = 0;
+uint32_t routing_mode = 0;
+uint64_t flowlet_timeout = 5000, dre_tau = 40000;
+uint32_t spray_paths = 1, reorder_buffer_size = 0;
+uint32_t rail_policy = 0;
+uint64_t stripe_size = 0;
+bool nic_model = false;
+uint32_t qpc_cache_size = 1024, qpc_size = 256, wqe_size = 64, nic_rx_buffer = 0;
+uint64_t qpc_hit_latency = 0, qpc_miss_latency = 1000, pcie_latency = 600;
+std::string pcie_bandwidth = "256Gb/s";
+uint64_t reorder_timeout = 10000;
 double error_rate_per_link = 0.0;
 uint32_t has_win = 1;
 uint32_t global_t = 1;
@@ -75,6 +97,10 @@ double pint_log_base = 1.05;
 double pint_prob = 1.0;
 double u_target = 0.95;
 uint32_t int_multi = 1;
+// INT geometry, see IntHop::Configure; int_line_rates empty: the default table
+uint32_t int_max_hop = 5, int_time_width = 24, int_bytes_width = 20, int_qlen_width = 17;
+bool int_compact = false;
+vector<uint64_t> int_line_rates;
 bool rate_bound = true;
 
 uint32_t ack_high_prio = 0;
@@ -92,8 +118,52 @@ uint64_t qlen_mon_start = 2000000000, qlen_mon_end = 2100000000;
 
 string qlen_mon_file;
 
+// progress report: every progress_interval wall-clock seconds (0: disabled), to progress_file or stderr
+double progress_interval = 0;
+string progress_file;
+
+// generate flows on the fly instead of reading FLOW_FILE, if FLOW_GEN is set
+bool use_flow_gen = false;
+FlowGenerator flow_gen;
+string flow_gen_cdf;
+double flow_gen_time = 0.1; // seconds of flow arrivals, starting from 2s
+vector<uint32_t> flow_gen_hosts; // generator's host index -> node id
+
+// collective workload (see CollectiveEngine) read from coll_file, if set; the steps and critical paths go to coll_output_file
+string coll_file, coll_output_file;
+CollectiveEngine coll_engine;
+
+// closed-loop workload (see RpcEngine) read from rpc_file, if set; one line per finished RPC goes to rpc_output_file
+string rpc_file, rpc_output_file;
+RpcEngine rpc_engine;
+
+// parameter sweep: at fork_time (s), fork one child per variant; each child applies its parameter delta
+double fork_time = 2;
+vector<pair<string, string> > fork_variants; // <name, delta>
+
+// hybrid fluid mode: flows >= fluid_threshold bytes (0: disabled) are sent in chunks of fluid_chunk MTUs when their rate is stable for fluid_stable packets
+uint64_t fluid_threshold = 0;
+uint32_t fluid_chunk = 16, fluid_stable = 64;
+
+// PFC deadlock and pause storm detector: checks every pfc_mon_interval us (0: disabled) from 2s, reports to pfc_mon_file or stderr
+uint64_t pfc_mon_interval = 0;
+string pfc_mon_file;
+PfcMonitor pfc_mon;
+
+// per-port scheduling rules, applied in order:
+// SWITCH_SCHED <node|*> <port|*> <queue>:<tier>:<weight> ...; NIC_PG_WEIGHT <node|*> <pg>:<weight> ...
+struct SchedRule{
+	int node, port; // -1: all
+	vector<vector<uint32_t> > items;
+};
+vector<SchedRule> switch_sched, nic_pg_weight;
+
 unordered_map<uint64_t, uint32_t> rate2kmax, rate2kmin;
 unordered_map<uint64_t, double> rate2pmax;
+// service pools of the switch buffer, see SwitchMmu::ConfigPool and ConfigPg
+unordered_map<uint32_t, double> pool2ratio, pg2alpha;
+unordered_map<uint32_t, uint32_t> pg2pool;
+vector<uint32_t> lossy_pg;
 
 /************************************************
  * Runtime varibles
@@ -106,6 +176,48 @@ uint64_t nic_rate;
 
 uint64_t maxRtt, maxBdp;
 
+uint32_t n_flow_done = 0;
+// for the FCT_STATS summary
+std::vector<double> fct_slowdown;
+uint64_t fct_bytes = 0, fct_first_start = UINT64_MAX, fct_last_end = 0;
+uint64_t n_pfc_pause = 0;
+// multi-rail hosts: the FCT lines carry the throughput of each rail, and RAIL_STATS is printed at the end
+bool multi_rail = false;
+std::vector<uint64_t> rail_flows, rail_bytes; // index: rail (1: the first NIC)
+// a message striped over the rails of its host, reported as one flow when its last stripe finishes
+struct StripedMsg{
+	uint32_t left; // stripes not finished
+	uint16_t sport; // of the first stripe
+	uint64_t size;
+	Time start;
+	std::vector<uint64_t> bytes; // per rail
+};
+std::unordered_map<uint32_t, StripedMsg> striped_msg;
+std::unordered_map<uint64_t, uint32_t> stripe_of; // (src, dst, sport) of a stripe -> key in striped_msg
+uint32_t n_striped_msg = 0;
+// per-tenant accounting: the tenant of a flow is the optional 8th column of the flow file, or COLLECTIVE_TENANT
+// and RPC_TENANT. With TENANT_STATS, the FCT lines carry the tenant and TENANT_STATS is printed at the end
+bool tenant_stats = false;
+uint32_t coll_tenant = 0, rpc_tenant = 0;
+struct TenantFct{
+	uint64_t flows, bytes;
+	double sum_slowdown, max_slowdown;
+	uint64_t first_start, last_end;
+	uint32_t hist[128]; // slowdowns, 8 buckets per power of 2
+};
+TenantFct tenant_fct[SwitchMmu::tCnt];
+
+// the p-th percentile (0-100) of the slowdowns of a tenant, as the upper end of its bucket
+double tenant_slowdown_pctl(const TenantFct &t, double p){
+	uint64_t k = std::min((uint64_t)(t.flows * p / 100), t.flows - 1), c = 0;
+	for (uint32_t i = 0; i < 128; i++){
+		c += t.hist[i];
+		if (c > k)
+			return std::min(pow(2, (i + 1) / 8.0), t.max_slowdown);
+	}
+	return t.max_slowdown;
+}
+
 struct Interface{
 	uint32_t idx;
 	bool up;
@@ -137,6 +249,25 @@ std::vector<Ipv4Address> serverAddress;	// 服务器地址
 // maintain port number for each host pair
 // （uint16_t 表示 16 位的端口号）。 32位表示主机号
 std::unordered_map<uint32_t, unordered_map<uint32_t, uint16_t> > portNumder;
+std::unordered_set<uint64_t> port_in_use; // (src, dst, sport) of the unfinished qps
+
+uint64_t port_key(uint32_t src, uint32_t dst, uint16_t port){
+	return ((uint64_t)src << 32) | ((uint64_t)dst << 16) | port;
+}
+
+// a new port of the host pair: the ports go up from 10000 and wrap around to 10000 after 65535 (long runs,
+// e.g. rpc), so the ports of the unfinished qps are skipped, which would collide in RdmaHw::GetQpKey
+uint16_t get_new_port(uint32_t src, uint32_t dst){
+	uint16_t &next = portNumder[src][dst];
+	for (uint32_t i = 10000; i <= 65535; i++){
+		uint16_t port = next;
+		next = next == 65535 ? 10000 : next + 1;
+		if (port_in_use.insert(port_key(src, dst, port)).second)
+			return port;
+	}
+	printf("Error: no free port from host %u to %u\n", src, dst);
+	exit(1);
+}
 
 
 // 在网络仿真中，pg 可以表示 Packet Generator，即数据包生成器，用于在网络中产生数据包流量
@@ -146,6 +277,8 @@ std::unordered_map<uint32_t, unordered_map<uint32_t, uint16_t> > portNumder;
 //
 struct FlowInput{
 	uint32_t src, dst, pg, maxPacketCount, port, dport;
+	uint32_t rail; // optional 7th column of the flow file, 0: by RAIL_POLICY
+	uint32_t tenant; // optional 8th column, 0: the default tenant
 	double start_time;
 	uint32_t idx;
 };
@@ -154,9 +287,36 @@ uint32_t flow_num;                //用于存储流的数量
 
 void ReadFlowInput(){
 	if (flow_input.idx < flow_num){
-		//  maxPacketCount对应的数   1000000000
-		// 0 1 3 100 1000000000 2
-		flowf >> flow_input.src >> flow_input.dst >> flow_input.pg >> flow_input.dport >> flow_input.maxPacketCount >> flow_input.start_time;
+		if (use_flow_gen){
+			GenFlow f;
+			if (!flow_gen.Next(f)){ // no more flows
+				flow_num = flow_input.idx;
+				return;
+			}
+			flow_input.src = flow_gen_hosts[f.src];
+			flow_input.dst = flow_gen_hosts[f.dst];
+			flow_input.pg = 3;
+			flow_input.dport = 100;
+			flow_input.maxPacketCount = f.size;
+			flow_input.start_time = f.start * 1e-9;
+			flow_input.rail = 0;
+			flow_input.tenant = 0;
+		}else {
+			//  maxPacketCount对应的数   1000000000
+			// 0 1 3 100 1000000000 2
+			std::string line;
+			while (std::getline(flowf, line) && line.find_first_not_of(" \t\r") == std::string::npos);
+			std::istringstream ss(line);
+			ss >> flow_input.src >> flow_input.dst >> flow_input.pg >> flow_input.dport >> flow_input.maxPacketCount >> flow_input.start_time;
+			if (!(ss >> flow_input.rail))
+				flow_input.rail = 0;
+			if (!(ss >> flow_input.tenant))
+				flow_input.tenant = 0;
+			if (flow_input.tenant >= SwitchMmu::tCnt){
+				printf("Error: tenant %u of flow %u, must be < %u\n", flow_input.tenant, flow_input.idx, SwitchMmu::tCnt);
+				exit(1);
+			}
+		}
 		// NodeContainer n; // 用于存储节点对象的容器。
 		NS_ASSERT(n.Get(flow_input.src)->GetNodeType() == 0 && n.Get(flow_input.dst)->GetNodeType() == 0);
 	}
@@ -173,17 +333,40 @@ void ReadFlowInput(){
 void ScheduleFlowInputs(){
 	// 查当前的流量是否已经到达应启动的时间，确保在仿真时间达到
 	while (flow_input.idx < flow_num && Seconds(flow_input.start_time) == Simulator::Now()){
-		// std::unordered_map<uint32_t, unordered_map<uint32_t, uint16_t> > portNumder;
-		uint32_t port = portNumder[flow_input.src][flow_input.dst]++; // get a new port number 
-		//   RdmaClientHelper (uint16_t pg, Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint64_t size, uint32_t win, uint64_t baseRtt);
-		//  无窗口表示为win = 0,否则为带宽时延积
-		// global T 为是否使用最大的RTT作为global T
-		RdmaClientHelper clientHelper(flow_input.pg, serverAddress[flow_input.src], serverAddress[flow_input.dst], port, flow_input.dport, flow_input.maxPacketCount, has_win?(global_t==1?maxBdp:pairBdp[n.Get(flow_input.src)][n.Get(flow_input.dst)]):0, global_t==1?maxRtt:pairRtt[flow_input.src][flow_input.dst]);
-		
-
-		// 通过 clientHelper.Install 在源节点上安装 RDMA 应用程序，并立即启动该应用程序。
-		ApplicationContainer appCon = clientHelper.Install(n.Get(flow_input.src));
-		appCon.Start(Time(0));  // 这里进入的是代码的哪里？？  是否打个断点去调试一下
+		// a large message without a given rail is striped over all NICs of the host, one qp per NIC
+		uint32_t n_stripe = 1;
+		if (stripe_size > 0 && flow_input.rail == 0 && flow_input.maxPacketCount >= stripe_size)
+			n_stripe = n.Get(flow_input.src)->GetObject<RdmaDriver>()->m_rdma->GetNRails();
+		if (n_stripe > 1){
+			StripedMsg &m = striped_msg[n_striped_msg];
+			m.left = n_stripe;
+			m.size = flow_input.maxPacketCount;
+			m.start = Simulator::Now();
+			m.bytes.assign(n_stripe + 1, 0);
+		}
+		for (uint32_t s = 0; s < n_stripe; s++){
+			// std::unordered_map<uint32_t, unordered_map<uint32_t, uint16_t> > portNumder;
+			uint32_t port = get_new_port(flow_input.src, flow_input.dst); // get a new port number 
+			uint32_t size = flow_input.maxPacketCount / n_stripe + (s < flow_input.maxPacketCount % n_stripe);
+			//   RdmaClientHelper (uint16_t pg, Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint64_t size, uint32_t win, uint64_t baseRtt);
+			//  无窗口表示为win = 0,否则为带宽时延积
+			// global T 为是否使用最大的RTT作为global T
+			RdmaClientHelper clientHelper(flow_input.pg, serverAddress[flow_input.src], serverAddress[flow_input.dst], port, flow_input.dport, size, has_win?(global_t==1?maxBdp:pairBdp[n.Get(flow_input.src)][n.Get(flow_input.dst)]):0, global_t==1?maxRtt:pairRtt[flow_input.src][flow_input.dst]);
+			if (n_stripe > 1){
+				if (s == 0)
+					striped_msg[n_striped_msg].sport = port;
+				clientHelper.SetAttribute("Rail", UintegerValue(s + 1));
+				stripe_of[port_key(flow_input.src, flow_input.dst, port)] = n_striped_msg;
+			}else
+				clientHelper.SetAttribute("Rail", UintegerValue(flow_input.rail));
+			clientHelper.SetAttribute("Tenant", UintegerValue(flow_input.tenant));
+
+			// 通过 clientHelper.Install 在源节点上安装 RDMA 应用程序，并立即启动该应用程序。
+			ApplicationContainer appCon = clientHelper.Install(n.Get(flow_input.src));
+			appCon.Start(Time(0));  // 这里进入的是代码的哪里？？  是否打个断点去调试一下
+		}
+		if (n_stripe > 1)
+			n_striped_msg++;
 
 		// get the next flow input
 		flow_input.idx++;
@@ -198,6 +381,21 @@ void ScheduleFlowInputs(){
 	}
 }
 
+// start a flow of the collective or rpc engine; done is called when it finishes
+void start_rdma_flow(uint32_t src, uint32_t dst, uint32_t pg, uint64_t size, uint32_t tenant, Callback<void> done){
+	uint32_t port = get_new_port(src, dst);
+	uint32_t win = has_win ? (global_t == 1 ? maxBdp : pairBdp[n.Get(src)][n.Get(dst)]) : 0;
+	n.Get(src)->GetObject<RdmaDriver>()->AddQueuePair(size, pg, serverAddress[src], serverAddress[dst], port, 100, win, global_t == 1 ? maxRtt : pairRtt[src][dst], 0, tenant, done);
+}
+
+void start_coll_flow(uint32_t src, uint32_t dst, uint64_t size, Callback<void> done){
+	start_rdma_flow(src, dst, 3, size, coll_tenant, done);
+}
+
+void start_rpc_flow(uint32_t src, uint32_t dst, uint32_t pg, uint64_t size, Callback<void> done){
+	start_rdma_flow(src, dst, pg, size, rpc_tenant, done);
+}
+
 Ipv4Address node_id_to_ip(uint32_t id){
 	// 0x0b000001 是基础 IP 地址（即 11.0.0.1）
 	// 如果 id = 257，得到的 IP 是 11.1.1.0。
@@ -215,27 +413,333 @@ void qp_finish(FILE* fout, Ptr<RdmaQueuePair> q){
 	// 基础往返时延（RTT）                  获取源节点到目标节点的带宽
 	uint64_t base_rtt = pairRtt[sid][did], b = pairBw[sid][did];
 
+	// remove rxQp from the receiver
+	Ptr<Node> dstNode = n.Get(did);
+	Ptr<RdmaDriver> rdma = dstNode->GetObject<RdmaDriver> ();
+	rdma->m_rdma->DeleteRxQp(q->sip.Get(), q->m_pg, q->sport);
+	port_in_use.erase(port_key(sid, did, q->sport));
+	n_flow_done++;
+
+	// the devices of a host are its NICs after the loopback, so the NIC index is the rail
+	uint32_t rail = 0, n_rail = 1;
+	uint16_t sport = q->sport;
+	uint64_t size = q->m_size;
+	Time start = q->startTime;
+	std::vector<uint64_t> bytes;
+	if (multi_rail){
+		Ptr<RdmaHw> rdmaHw = n.Get(sid)->GetObject<RdmaDriver>()->m_rdma;
+		rail = rdmaHw->GetNicIdxOfQp(q);
+		rail_flows[rail]++;
+		rail_bytes[rail] += q->m_size;
+		bytes.assign(rdmaHw->GetNRails() + 1, 0);
+		bytes[rail] = q->m_size;
+		auto it = stripe_of.find(port_key(sid, did, q->sport));
+		if (it != stripe_of.end()){
+			StripedMsg &m = striped_msg[it->second];
+			m.bytes[rail] += q->m_size;
+			if (--m.left > 0){
+				stripe_of.erase(it);
+				return;
+			}
+			n_rail = m.bytes.size() - 1;
+			sport = m.sport;
+			size = m.size;
+			start = m.start;
+			bytes = m.bytes;
+			striped_msg.erase(it->second);
+			stripe_of.erase(it);
+		}
+	}
+
 	///q_msize要传输的数据的大小    按照packet_payload_size 分片  得到的数据包个数 * 数据包的报头长度         
-	uint32_t total_bytes = q->m_size + ((q->m_size-1) / packet_payload_size + 1) * 
+	uint32_t total_bytes = size + ((size-1) / packet_payload_size + 1) * 
 		(CustomHeader::GetStaticWholeHeaderSize() - IntHeader::GetStaticSize()); 
 	// translate to the minimum bytes required (with header but no INT)
 	
 
 	///
-	uint64_t standalone_fct = base_rtt + total_bytes * 8000000000lu / b;
+	uint64_t standalone_fct = base_rtt + total_bytes * 8000000000lu / (b * n_rail);
+	uint64_t fct = (Simulator::Now() - start).GetTimeStep();
 	// sip, dip, sport, dport, size (B), start_time, fct (ns), standalone_fct (ns)
-	fprintf(fout, "%08x %08x %u %u %lu %lu %lu %lu\n", q->sip.Get(), q->dip.Get(), q->sport, q->dport, q->m_size, q->startTime.GetTimeStep(), (Simulator::Now() - q->startTime).GetTimeStep(), standalone_fct);
+	fprintf(fout, "%08x %08x %u %u %lu %lu %lu %lu", q->sip.Get(), q->dip.Get(), sport, q->dport, size, start.GetTimeStep(), fct, standalone_fct);
+	// then the throughput (Gbps) on each rail of the sender
+	for (uint32_t r = 1; r < bytes.size(); r++)
+		fprintf(fout, " %.3lf", bytes[r] * 8.0 / fct);
+	// then the tenant, with TENANT_STATS
+	if (tenant_stats)
+		fprintf(fout, " %u", q->m_tenant);
+	fprintf(fout, "\n");
 	fflush(fout);
-
-	// remove rxQp from the receiver
-	Ptr<Node> dstNode = n.Get(did);
-	Ptr<RdmaDriver> rdma = dstNode->GetObject<RdmaDriver> ();
-	rdma->m_rdma->DeleteRxQp(q->sip.Get(), q->m_pg, q->sport);
+	fct_slowdown.push_back(std::max(1.0, (double)fct / standalone_fct));
+	fct_bytes += size;
+	fct_first_start = std::min(fct_first_start, (uint64_t)start.GetTimeStep());
+	fct_last_end = Simulator::Now().GetTimeStep();
+	if (tenant_stats){
+		TenantFct &t = tenant_fct[q->m_tenant];
+		double slowdown = std::max(1.0, (double)fct / standalone_fct);
+		if (t.flows == 0 || (uint64_t)start.GetTimeStep() < t.first_start)
+			t.first_start = start.GetTimeStep();
+		t.flows++;
+		t.bytes += size;
+		t.sum_slowdown += slowdown;
+		t.max_slowdown = std::max(t.max_slowdown, slowdown);
+		t.last_end = Simulator::Now().GetTimeStep();
+		t.hist[std::min(127, (int)(log2(slowdown) * 8))]++;
+	}
 }
 
 void get_pfc(FILE* fout, Ptr<QbbNetDevice> dev, uint32_t type){
 	//用于记录当前模拟时间、设备信息（包括设备所在的节点、节点类型和接口索引）以及一个类型标志到指定的输出文件中
 	fprintf(fout, "%lu %u %u %u %u\n", Simulator::Now().GetTimeStep(), dev->GetNode()->GetId(), dev->GetNode()->GetNodeType(), dev->GetIfIndex(), type);
+	if (type == 1)
+		n_pfc_pause++;
+}
+
+/******************************************
+ * Progress report
+ *****************************************/
+struct Progress{
+	FILE *fout; // NULL: print to stderr
+	struct timeval start, last_print, last_check;
+	uint64_t last_events, last_sim_ns;
+	uint64_t step; // sim ns between two checks of the wall clock
+} progress;
+
+static double wall_diff(const struct timeval &a, const struct timeval &b){
+	return (a.tv_sec - b.tv_sec) + (a.tv_usec - b.tv_usec) * 1e-6;
+}
+
+// current resident set size in KB
+static uint64_t get_rss_kb(){
+	uint64_t pages = 0;
+	FILE *f = fopen("/proc/self/statm", "r");
+	if (f){
+		if (fscanf(f, "%*u %lu", &pages) != 1)
+			pages = 0;
+		fclose(f);
+	}
+	return pages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+void print_progress(struct timeval &now){
+	uint64_t events = Simulator::GetEventCount();
+	uint64_t sim_ns = Simulator::Now().GetTimeStep();
+	double wall = wall_diff(now, progress.start);
+	double dt = wall_diff(now, progress.last_print);
+	double ev_rate = dt > 0 ? (events - progress.last_events) / dt : 0;
+	// active QPs of all hosts
+	uint32_t n_qp = 0;
+	for (uint32_t i = 0; i < n.GetN(); i++)
+		if (n.Get(i)->GetNodeType() == 0)
+			n_qp += n.Get(i)->GetObject<RdmaDriver>()->m_rdma->m_qpMap.size();
+	uint64_t rss = get_rss_kb();
+	// the total is unknown while FLOW_GEN runs
+	char total[16];
+	if (flow_num == UINT32_MAX)
+		strcpy(total, progress.fout ? "null" : "?");
+	else
+		sprintf(total, "%u", flow_num);
+	if (progress.fout){
+		fprintf(progress.fout, "{\"wall_s\": %.3f, \"sim_ns\": %lu, \"stop_ns\": %lu, \"events\": %lu, \"events_per_s\": %.0f, \"queue\": %u, \"qps\": %u, \"flows_started\": %u, \"flows_total\": %s, \"flows_done\": %u, \"rss_kb\": %lu, \"pfc_pause\": %lu}\n",
+				wall, sim_ns, Seconds(simulator_stop_time).GetTimeStep(), events, ev_rate, Simulator::GetEventQueueSize(), n_qp, flow_input.idx, total, n_flow_done, rss, n_pfc_pause);
+		fflush(progress.fout);
+	}else {
+		fprintf(stderr, "[%.0fs] sim %.6fs/%.2fs (%.1f%%) %.0f ev/s queue %u qps %u flows %u/%s done %u rss %luMB pfc %lu\n",
+				wall, sim_ns * 1e-9, simulator_stop_time, sim_ns * 1e-7 / simulator_stop_time, ev_rate, Simulator::GetEventQueueSize(), n_qp, flow_input.idx, total, n_flow_done, rss / 1024, n_pfc_pause);
+	}
+	progress.last_print = now;
+	progress.last_events = events;
+}
+
+void check_progress(){
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	uint64_t sim_ns = Simulator::Now().GetTimeStep();
+	if (wall_diff(now, progress.last_print) >= progress_interval)
+		print_progress(now);
+	// adapt the step so that the wall clock is checked about 10 times per interval.
+	// the step is capped at 100us, so a sudden slowdown (e.g., when flows start) is noticed soon
+	double dt = wall_diff(now, progress.last_check);
+	if (dt > 0){
+		double step = (sim_ns - progress.last_sim_ns) / dt * progress_interval / 10;
+		progress.step = std::min(std::max(step, 1000.), 100000.);
+	}
+	progress.last_check = now;
+	progress.last_sim_ns = sim_ns;
+	Simulator::Schedule(NanoSeconds(progress.step), &check_progress);
+}
+
+/******************************************
+ * Fork-based parameter sweep
+ *****************************************/
+vector<pair<FILE*, string> > fork_outputs; // output files to be suffixed in the children
+vector<pid_t> fork_children;
+
+// mix/fct.txt -> mix/fct_<suffix>.txt
+string add_suffix(const string &name, const string &suffix){
+	size_t dot = name.rfind('.'), slash = name.rfind('/');
+	if (dot == string::npos || (slash != string::npos && dot < slash))
+		return name + "_" + suffix;
+	return name.substr(0, dot) + "_" + suffix + name.substr(dot);
+}
+
+// in a child, redirect f to the suffixed file, keeping what was written before the fork
+void redirect_output(FILE *f, const string &name, const string &suffix){
+	long len = ftell(f);
+	FILE *src = fopen(name.c_str(), "r");
+	string new_name = add_suffix(name, suffix);
+	if (freopen(new_name.c_str(), "w", f) == NULL){
+		fprintf(stderr, "cannot open %s\n", new_name.c_str());
+		exit(1);
+	}
+	char buf[65536];
+	while (src && len > 0){
+		size_t r = fread(buf, 1, std::min(len, (long)sizeof(buf)), src);
+		if (r == 0)
+			break;
+		fwrite(buf, 1, r, f);
+		len -= r;
+	}
+	if (src)
+		fclose(src);
+}
+
+void set_rdma_attribute(string name, const AttributeValue &v){
+	for (uint32_t i = 0; i < n.GetN(); i++)
+		if (n.Get(i)->GetNodeType() == 0)
+			n.Get(i)->GetObject<RdmaDriver>()->m_rdma->SetAttribute(name, v);
+}
+
+SchedRule parse_sched_rule(const string &rule, bool has_port, uint32_t n_field){
+	std::istringstream in(rule);
+	SchedRule r;
+	string s;
+	in >> s;
+	r.node = s == "*" ? -1 : atoi(s.c_str());
+	r.port = -1;
+	if (has_port){
+		in >> s;
+		r.port = s == "*" ? -1 : atoi(s.c_str());
+	}
+	while (in >> s){
+		vector<uint32_t> v;
+		std::istringstream item(s);
+		for (string f; std::getline(item, f, ':');)
+			v.push_back(atoi(f.c_str()));
+		NS_ASSERT_MSG(v.size() == n_field, "invalid scheduling rule: " + rule);
+		r.items.push_back(v);
+	}
+	return r;
+}
+
+// apply "KEY VALUE KEY VALUE ..." with the same keys and value formats as the config file
+void apply_variant(const string &delta){
+	std::istringstream in(delta);
+	string key;
+	bool ecn_changed = false;
+	while (in >> key){
+		if (key == "U_TARGET"){
+			in >> u_target;
+			set_rdma_attribute("TargetUtil", DoubleValue(u_target));
+		}else if (key == "RATE_AI"){
+			in >> rate_ai;
+			set_rdma_attribute("RateAI", DataRateValue(DataRate(rate_ai)));
+		}else if (key == "RATE_HAI"){
+			in >> rate_hai;
+			set_rdma_attribute("RateHAI", DataRateValue(DataRate(rate_hai)));
+		}else if (key == "MIN_RATE"){
+			in >> min_rate;
+			set_rdma_attribute("MinRate", DataRateValue(DataRate(min_rate)));
+		}else if (key == "DCTCP_RATE_AI"){
+			in >> dctcp_rate_ai;
+			set_rdma_attribute("DctcpRateAI", DataRateValue(DataRate(dctcp_rate_ai)));
+		}else if (key == "MI_THRESH"){
+			in >> mi_thresh;
+			set_rdma_attribute("MiThresh", UintegerValue(mi_thresh));
+		}else if (key == "FAST_REACT"){
+			in >> fast_react;
+			set_rdma_attribute("FastReact", BooleanValue(fast_react));
+		}else if (key == "EWMA_GAIN"){
+			in >> ewma_gain;
+			set_rdma_attribute("EwmaGain", DoubleValue(ewma_gain));
+		}else if (key == "RP_TIMER"){
+			in >> rp_timer;
+			set_rdma_attribute("RPTimer", DoubleValue(rp_timer));
+		}else if (key == "ALPHA_RESUME_INTERVAL"){
+			in >> alpha_resume_interval;
+			set_rdma_attribute("AlphaResumInterval", DoubleValue(alpha_resume_interval));
+		}else if (key == "RATE_DECREASE_INTERVAL"){
+			in >> rate_decrease_interval;
+			set_rdma_attribute("RateDecreaseInterval", DoubleValue(rate_decrease_interval));
+		}else if (key == "MULTI_RATE"){
+			in >> multi_rate;
+			set_rdma_attribute("MultiRate", BooleanValue(multi_rate));
+		}else if (key == "SAMPLE_FEEDBACK"){
+			in >> sample_feedback;
+			set_rdma_attribute("SampleFeedback", BooleanValue(sample_feedback));
+		}else if (key == "KMAX_MAP" || key == "KMIN_MAP" || key == "PMAX_MAP"){
+			int n_k;
+			in >> n_k;
+			for (int i = 0; i < n_k; i++){
+				uint64_t rate;
+				in >> rate;
+				if (key == "KMAX_MAP")
+					in >> rate2kmax[rate];
+				else if (key == "KMIN_MAP")
+					in >> rate2kmin[rate];
+				else
+					in >> rate2pmax[rate];
+			}
+			ecn_changed = true;
+		}else {
+			fprintf(stderr, "FORK_VARIANT: unsupported key %s\n", key.c_str());
+			exit(1);
+		}
+	}
+	if (ecn_changed){
+		for (uint32_t i = 0; i < n.GetN(); i++){
+			if (n.Get(i)->GetNodeType() != 1)
+				continue;
+			Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n.Get(i));
+			for (uint32_t j = 1; j < sw->GetNDevices(); j++){
+				uint64_t rate = DynamicCast<QbbNetDevice>(sw->GetDevice(j))->GetDataRate().GetBitRate();
+				sw->m_mmu->ConfigEcn(j, rate2kmin[rate], rate2kmax[rate], rate2pmax[rate]);
+			}
+		}
+	}
+}
+
+// the parent keeps running the unmodified config; each child becomes one variant
+void fork_sweep(){
+	fflush(stdout);
+	fflush(stderr);
+	for (auto &o : fork_outputs)
+		fflush(o.first);
+	// the flow file is read lazily, and the processes share the offset of its fd, so each child reopens it
+	bool flowf_open = flowf.is_open();
+	std::streampos flowf_pos = flowf_open ? flowf.tellg() : std::streampos(0);
+	for (auto &v : fork_variants){
+		pid_t pid = fork();
+		if (pid < 0){
+			perror("fork");
+			break;
+		}
+		if (pid == 0){
+			fork_children.clear();
+			if (flowf_open){
+				flowf.close();
+				flowf.clear();
+				flowf.open(flow_file.c_str());
+				flowf.seekg(flowf_pos);
+			}
+			for (auto &o : fork_outputs)
+				redirect_output(o.first, o.second, v.first);
+			printf("variant %s (pid %d):%s\n", v.first.c_str(), getpid(), v.second.c_str());
+			apply_variant(v.second);
+			return;
+		}
+		fork_children.push_back(pid);
+	}
 }
 
 struct QlenDistribution{
@@ -390,10 +894,19 @@ void TakeDownLink(NodeContainer n, Ptr<Node> a, Ptr<Node> b){
 	}
 }
 
+// the lowest rate of the NICs of all hosts (a multi-rail host has several), 0 if there is no host
 uint64_t get_nic_rate(NodeContainer &n){
-	for (uint32_t i = 0; i < n.GetN(); i++)
-		if (n.Get(i)->GetNodeType() == 0)
-			return DynamicCast<QbbNetDevice>(n.Get(i)->GetDevice(1))->GetDataRate().GetBitRate();
+	uint64_t res = 0;
+	for (uint32_t i = 0; i < n.GetN(); i++){
+		if (n.Get(i)->GetNodeType() != 0)
+			continue;
+		for (uint32_t j = 1; j < n.Get(i)->GetNDevices(); j++){
+			Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(n.Get(i)->GetDevice(j));
+			if (dev != NULL && (res == 0 || dev->GetDataRate().GetBitRate() < res))
+				res = dev->GetDataRate().GetBitRate();
+		}
+	}
+	return res;
 }
 
 int main(int argc, char *argv[])
@@ -503,6 +1016,115 @@ int main(int argc, char *argv[])
 				else
 					std::cout << "L2_BACK_TO_ZERO\t\t\t" << "No" << "\n";
 			}
+			else if (key.compare("L2_SELECTIVE_REPEAT") == 0)
+			{
+				uint32_t v;
+				conf >> v;
+				l2_selective_repeat = v;
+				std::cout << "L2_SELECTIVE_REPEAT\t\t" << (l2_selective_repeat ? "Yes" : "No") << "\n";
+			}
+			else if (key.compare("ACK_COALESCE_COUNT") == 0)
+			{
+				conf >> ack_coalesce_count;
+				std::cout << "ACK_COALESCE_COUNT\t\t" << ack_coalesce_count << "\n";
+			}
+			else if (key.compare("ACK_COALESCE_TIME") == 0)
+			{
+				conf >> ack_coalesce_time;
+				std::cout << "ACK_COALESCE_TIME\t\t" << ack_coalesce_time << "\n";
+			}
+			else if (key.compare("ACK_COALESCE_MAX_QLEN") == 0)
+			{
+				uint32_t v;
+				conf >> v;
+				ack_coalesce_max_qlen = v;
+				std::cout << "ACK_COALESCE_MAX_QLEN\t\t" << (ack_coalesce_max_qlen ? "Yes" : "No") << "\n";
+			}
+			else if (key.compare("ROUTING_MODE") == 0)
+			{
+				conf >> routing_mode;
+				std::cout << "ROUTING_MODE\t\t\t" << routing_mode << "\n";
+			}
+			else if (key.compare("FLOWLET_TIMEOUT") == 0)
+			{
+				conf >> flowlet_timeout;
+				std::cout << "FLOWLET_TIMEOUT\t\t\t" << flowlet_timeout << "\n";
+			}
+			else if (key.compare("DRE_TAU") == 0)
+			{
+				conf >> dre_tau;
+				std::cout << "DRE_TAU\t\t\t\t" << dre_tau << "\n";
+			}
+			else if (key.compare("SPRAY_PATHS") == 0)
+			{
+				conf >> spray_paths;
+				std::cout << "SPRAY_PATHS\t\t\t" << spray_paths << "\n";
+			}
+			else if (key.compare("REORDER_BUFFER_SIZE") == 0)
+			{
+				conf >> reorder_buffer_size;
+				std::cout << "REORDER_BUFFER_SIZE\t\t" << reorder_buffer_size << "\n";
+			}
+			else if (key.compare("REORDER_TIMEOUT") == 0)
+			{
+				conf >> reorder_timeout;
+				std::cout << "REORDER_TIMEOUT\t\t\t" << reorder_timeout << "\n";
+			}
+			else if (key.compare("RAIL_POLICY") == 0)
+			{
+				conf >> rail_policy;
+				std::cout << "RAIL_POLICY\t\t\t" << rail_policy << "\n";
+			}
+			else if (key.compare("STRIPE_SIZE") == 0)
+			{
+				conf >> stripe_size;
+				std::cout << "STRIPE_SIZE\t\t\t" << stripe_size << "\n";
+			}
+			else if (key.compare("NIC_MODEL") == 0)
+			{
+				conf >> nic_model;
+				std::cout << "NIC_MODEL\t\t\t" << nic_model << "\n";
+			}
+			else if (key.compare("QPC_CACHE_SIZE") == 0)
+			{
+				conf >> qpc_cache_size;
+				std::cout << "QPC_CACHE_SIZE\t\t\t" << qpc_cache_size << "\n";
+			}
+			else if (key.compare("QPC_HIT_LATENCY") == 0)
+			{
+				conf >> qpc_hit_latency;
+				std::cout << "QPC_HIT_LATENCY\t\t" << qpc_hit_latency << "\n";
+			}
+			else if (key.compare("QPC_MISS_LATENCY") == 0)
+			{
+				conf >> qpc_miss_latency;
+				std::cout << "QPC_MISS_LATENCY\t\t" << qpc_miss_latency << "\n";
+			}
+			else if (key.compare("QPC_SIZE") == 0)
+			{
+				conf >> qpc_size;
+				std::cout << "QPC_SIZE\t\t\t" << qpc_size << "\n";
+			}
+			else if (key.compare("WQE_SIZE") == 0)
+			{
+				conf >> wqe_size;
+				std::cout << "WQE_SIZE\t\t\t" << wqe_size << "\n";
+			}
+			else if (key.compare("PCIE_BANDWIDTH") == 0)
+			{
+				conf >> pcie_bandwidth;
+				std::cout << "PCIE_BANDWIDTH\t\t\t" << pcie_bandwidth << "\n";
+			}
+			else if (key.compare("PCIE_LATENCY") == 0)
+			{
+				conf >> pcie_latency;
+				std::cout << "PCIE_LATENCY\t\t\t" << pcie_latency << "\n";
+			}
+			else if (key.compare("NIC_RX_BUFFER") == 0)
+			{
+				conf >> nic_rx_buffer;
+				std::cout << "NIC_RX_BUFFER\t\t\t" << nic_rx_buffer << "\n";
+			}
 			else if (key.compare("TOPOLOGY_FILE") == 0)
 			{
 				std::string v;
@@ -630,6 +1252,30 @@ int main(int argc, char *argv[])
 			}else if (key.compare("INT_MULTI") == 0){
 				conf >> int_multi;
 				std::cout << "INT_MULTI\t\t\t\t" << int_multi << '\n';
+			}else if (key.compare("INT_MAX_HOP") == 0){
+				conf >> int_max_hop;
+				std::cout << "INT_MAX_HOP\t\t\t\t" << int_max_hop << '\n';
+			}else if (key.compare("INT_COMPACT") == 0){
+				conf >> int_compact;
+				std::cout << "INT_COMPACT\t\t\t\t" << int_compact << '\n';
+			}else if (key.compare("INT_TIME_WIDTH") == 0){
+				conf >> int_time_width;
+				std::cout << "INT_TIME_WIDTH\t\t\t\t" << int_time_width << '\n';
+			}else if (key.compare("INT_BYTES_WIDTH") == 0){
+				conf >> int_bytes_width;
+				std::cout << "INT_BYTES_WIDTH\t\t\t\t" << int_bytes_width << '\n';
+			}else if (key.compare("INT_QLEN_WIDTH") == 0){
+				conf >> int_qlen_width;
+				std::cout << "INT_QLEN_WIDTH\t\t\t\t" << int_qlen_width << '\n';
+			}else if (key.compare("INT_LINE_RATES") == 0){
+				std::string rates;
+				std::getline(conf >> std::ws, rates);
+				std::istringstream ss(rates);
+				double g;
+				int_line_rates.clear();
+				while (ss >> g)
+					int_line_rates.push_back(g * 1e9 + 0.5);
+				std::cout << "INT_LINE_RATES\t\t\t\t" << rates << '\n';
 			}else if (key.compare("RATE_BOUND") == 0){
 				uint32_t v;
 				conf >> v;
@@ -689,6 +1335,52 @@ int main(int argc, char *argv[])
 			}else if (key.compare("BUFFER_SIZE") == 0){
 				conf >> buffer_size;
 				std::cout << "BUFFER_SIZE\t\t\t\t" << buffer_size << '\n';
+			}else if (key.compare("SERVICE_POOL_MAP") == 0){
+				int n_k;
+				conf >> n_k;
+				std::cout << "SERVICE_POOL_MAP\t\t\t";
+				for (int i = 0; i < n_k; i++){
+					uint32_t pool;
+					double r;
+					conf >> pool >> r;
+					pool2ratio[pool] = r;
+					std::cout << ' ' << pool << ' ' << r;
+				}
+				std::cout<<'\n';
+			}else if (key.compare("PG_POOL_MAP") == 0){
+				int n_k;
+				conf >> n_k;
+				std::cout << "PG_POOL_MAP\t\t\t\t";
+				for (int i = 0; i < n_k; i++){
+					uint32_t pg, pool;
+					conf >> pg >> pool;
+					pg2pool[pg] = pool;
+					std::cout << ' ' << pg << ' ' << pool;
+				}
+				std::cout<<'\n';
+			}else if (key.compare("LOSSY_PG") == 0){
+				int n_k;
+				conf >> n_k;
+				std::cout << "LOSSY_PG\t\t\t\t";
+				for (int i = 0; i < n_k; i++){
+					uint32_t pg;
+					conf >> pg;
+					lossy_pg.push_back(pg);
+					std::cout << ' ' << pg;
+				}
+				std::cout<<'\n';
+			}else if (key.compare("EGRESS_ALPHA_MAP") == 0){
+				int n_k;
+				conf >> n_k;
+				std::cout << "EGRESS_ALPHA_MAP\t\t\t";
+				for (int i = 0; i < n_k; i++){
+					uint32_t pg;
+					double a;
+					conf >> pg >> a;
+					pg2alpha[pg] = a;
+					std::cout << ' ' << pg << ' ' << a;
+				}
+				std::cout<<'\n';
 			}else if (key.compare("QLEN_MON_FILE") == 0){
 				conf >> qlen_mon_file;   ///  记录的是egress  size += sw->m_mmu->egress_bytes[j][k];
 				std::cout << "QLEN_MON_FILE\t\t\t\t" << qlen_mon_file << '\n';
@@ -714,6 +1406,122 @@ int main(int argc, char *argv[])
 			}else if (key.compare("PINT_PROB") == 0){
 				conf >> pint_prob;
 				std::cout << "PINT_PROB\t\t\t\t" << pint_prob << '\n';
+			}else if (key.compare("PROGRESS_INTERVAL") == 0){
+				conf >> progress_interval;
+				std::cout << "PROGRESS_INTERVAL\t\t\t\t" << progress_interval << '\n';
+			}else if (key.compare("PROGRESS_FILE") == 0){
+				conf >> progress_file;
+				std::cout << "PROGRESS_FILE\t\t\t\t" << progress_file << '\n';
+			}else if (key.compare("FLOW_GEN") == 0){
+				std::string v;
+				conf >> v;
+				if (!FlowGenerator::ParsePattern(v, flow_gen.pattern)){
+					std::cout << "Error: unknown FLOW_GEN pattern " << v << "\n";
+					return 1;
+				}
+				use_flow_gen = true;
+				std::cout << "FLOW_GEN\t\t\t\t" << v << '\n';
+			}else if (key.compare("FLOW_GEN_CDF") == 0){
+				conf >> flow_gen_cdf;
+				std::cout << "FLOW_GEN_CDF\t\t\t\t" << flow_gen_cdf << '\n';
+			}else if (key.compare("FLOW_GEN_LOAD") == 0){
+				conf >> flow_gen.load;
+				std::cout << "FLOW_GEN_LOAD\t\t\t\t" << flow_gen.load << '\n';
+			}else if (key.compare("FLOW_GEN_TIME") == 0){
+				conf >> flow_gen_time;
+				std::cout << "FLOW_GEN_TIME\t\t\t\t" << flow_gen_time << '\n';
+			}else if (key.compare("FLOW_GEN_SEED") == 0){
+				conf >> flow_gen.seed;
+				std::cout << "FLOW_GEN_SEED\t\t\t\t" << flow_gen.seed << '\n';
+			}else if (key.compare("FLOW_GEN_SIZE") == 0){
+				conf >> flow_gen.flow_size;
+				std::cout << "FLOW_GEN_SIZE\t\t\t\t" << flow_gen.flow_size << '\n';
+			}else if (key.compare("FLOW_GEN_FANIN") == 0){
+				conf >> flow_gen.fanin;
+				std::cout << "FLOW_GEN_FANIN\t\t\t\t" << flow_gen.fanin << '\n';
+			}else if (key.compare("FLUID_THRESHOLD") == 0){
+				conf >> fluid_threshold;
+				std::cout << "FLUID_THRESHOLD\t\t\t\t" << fluid_threshold << '\n';
+			}else if (key.compare("FLUID_CHUNK") == 0){
+				conf >> fluid_chunk;
+				std::cout << "FLUID_CHUNK\t\t\t\t" << fluid_chunk << '\n';
+			}else if (key.compare("FLUID_STABLE") == 0){
+				conf >> fluid_stable;
+				std::cout << "FLUID_STABLE\t\t\t\t" << fluid_stable << '\n';
+			}else if (key.compare("COLLECTIVE_FILE") == 0){
+				conf >> coll_file;
+				std::cout << "COLLECTIVE_FILE\t\t\t\t" << coll_file << '\n';
+			}else if (key.compare("COLLECTIVE_OUTPUT_FILE") == 0){
+				conf >> coll_output_file;
+				std::cout << "COLLECTIVE_OUTPUT_FILE\t\t\t\t" << coll_output_file << '\n';
+			}else if (key.compare("RPC_FILE") == 0){
+				conf >> rpc_file;
+				std::cout << "RPC_FILE\t\t\t\t" << rpc_file << '\n';
+			}else if (key.compare("RPC_OUTPUT_FILE") == 0){
+				conf >> rpc_output_file;
+				std::cout << "RPC_OUTPUT_FILE\t\t\t\t" << rpc_output_file << '\n';
+			}else if (key.compare("RPC_SEED") == 0){
+				conf >> rpc_engine.seed;
+				std::cout << "RPC_SEED\t\t\t\t" << rpc_engine.seed << '\n';
+			}else if (key.compare("TENANT_STATS") == 0){
+				conf >> tenant_stats;
+				std::cout << "TENANT_STATS\t\t\t\t" << tenant_stats << '\n';
+			}else if (key.compare("COLLECTIVE_TENANT") == 0){
+				conf >> coll_tenant;
+				std::cout << "COLLECTIVE_TENANT\t\t\t\t" << coll_tenant << '\n';
+				if (coll_tenant >= SwitchMmu::tCnt){
+					std::cout << "Error: COLLECTIVE_TENANT must be < " << SwitchMmu::tCnt << "\n";
+					return 1;
+				}
+			}else if (key.compare("RPC_TENANT") == 0){
+				conf >> rpc_tenant;
+				std::cout << "RPC_TENANT\t\t\t\t" << rpc_tenant << '\n';
+				if (rpc_tenant >= SwitchMmu::tCnt){
+					std::cout << "Error: RPC_TENANT must be < " << SwitchMmu::tCnt << "\n";
+					return 1;
+				}
+			}else if (key.compare("PFC_MON_INTERVAL") == 0){
+				conf >> pfc_mon_interval;
+				std::cout << "PFC_MON_INTERVAL\t\t\t\t" << pfc_mon_interval << '\n';
+			}else if (key.compare("PFC_MON_FILE") == 0){
+				conf >> pfc_mon_file;
+				std::cout << "PFC_MON_FILE\t\t\t\t" << pfc_mon_file << '\n';
+			}else if (key.compare("PFC_DEADLOCK_TIME") == 0){
+				uint64_t v;
+				conf >> v;
+				pfc_mon.deadlock_time = MicroSeconds(v);
+				std::cout << "PFC_DEADLOCK_TIME\t\t\t\t" << v << '\n';
+			}else if (key.compare("PFC_STORM_TIME") == 0){
+				uint64_t v;
+				conf >> v;
+				pfc_mon.storm_time = MicroSeconds(v);
+				std::cout << "PFC_STORM_TIME\t\t\t\t" << v << '\n';
+			}else if (key.compare("PFC_STORM_RATIO") == 0){
+				conf >> pfc_mon.storm_ratio;
+				std::cout << "PFC_STORM_RATIO\t\t\t\t" << pfc_mon.storm_ratio << '\n';
+			}else if (key.compare("SWITCH_SCHED") == 0){
+				std::string rule;
+				std::getline(conf >> std::ws, rule);
+				switch_sched.push_back(parse_sched_rule(rule, true, 3));
+				std::cout << "SWITCH_SCHED\t\t\t\t" << rule << '\n';
+			}else if (key.compare("NIC_PG_WEIGHT") == 0){
+				std::string rule;
+				std::getline(conf >> std::ws, rule);
+				nic_pg_weight.push_back(parse_sched_rule(rule, false, 2));
+				std::cout << "NIC_PG_WEIGHT\t\t\t\t" << rule << '\n';
+			}else if (key.compare("PFC_MON_STOP") == 0){
+				conf >> pfc_mon.stop;
+				std::cout << "PFC_MON_STOP\t\t\t\t" << pfc_mon.stop << '\n';
+			}else if (key.compare("FORK_TIME") == 0){
+				conf >> fork_time;
+				std::cout << "FORK_TIME\t\t\t\t" << fork_time << '\n';
+			}else if (key.compare("FORK_VARIANT") == 0){
+				// FORK_VARIANT <name> <key> <value> [<key> <value> ...]
+				std::string name, delta;
+				conf >> name;
+				std::getline(conf, delta);
+				fork_variants.push_back(make_pair(name, delta));
+				std::cout << "FORK_VARIANT\t\t\t\t" << name << delta << '\n';
 			}
 			fflush(stdout);
 		}
@@ -738,6 +1546,51 @@ int main(int argc, char *argv[])
 
 	// set int_multi
 	IntHop::multi = int_multi;
+	{
+		std::string err = IntHop::Configure(int_time_width, int_bytes_width, int_qlen_width, int_line_rates.empty() ? IntHop::lineRateValues : int_line_rates);
+		if (err.empty())
+			err = IntHeader::SetMaxHop(int_max_hop);
+		if (!err.empty()){
+			std::cout << "Error: INT " << err << "\n";
+			return 1;
+		}
+		IntHeader::compact = int_compact;
+	}
+	// service pools: the pools not in SERVICE_POOL_MAP share what the listed pools leave, if a PG uses them
+	if (!pool2ratio.empty()){
+		double left = 1;
+		for (auto &it : pool2ratio){
+			if (it.first >= SwitchMmu::poolCnt || it.second < 0){
+				std::cout << "Error: SERVICE_POOL_MAP pool " << it.first << " must be < " << SwitchMmu::poolCnt << " with a ratio >= 0\n";
+				return 1;
+			}
+			left -= it.second;
+		}
+		if (left < -1e-9){
+			std::cout << "Error: SERVICE_POOL_MAP ratios sum to " << 1 - left << ", more than 1\n";
+			return 1;
+		}
+		vector<uint32_t> unlisted;
+		for (uint32_t pool = 0; pool < SwitchMmu::poolCnt; pool++){
+			bool used = false;
+			for (uint32_t pg = 0; pg < SwitchMmu::qCnt; pg++)
+				used |= (pg2pool.count(pg) ? pg2pool[pg] : 0) == pool;
+			if (used && !pool2ratio.count(pool))
+				unlisted.push_back(pool);
+		}
+		if (!unlisted.empty() && left <= 1e-9){
+			std::cout << "Error: SERVICE_POOL_MAP leaves no buffer for pool " << unlisted[0] << ", which a PG uses\n";
+			return 1;
+		}
+		for (uint32_t pool : unlisted)
+			pool2ratio[pool] = left / unlisted.size();
+	}
+	// the egress threshold drops packets, so only lossy PGs have it
+	for (auto &it : pg2alpha)
+		if (it.second > 0 && std::find(lossy_pg.begin(), lossy_pg.end(), it.first) == lossy_pg.end()){
+			std::cout << "Error: EGRESS_ALPHA_MAP PG " << it.first << " is lossless, only a PG in LOSSY_PG can have an egress threshold\n";
+			return 1;
+		}
 	// IntHeader::mode
 	if (cc_mode == 7) // timely, use ts
 		IntHeader::mode = IntHeader::TS;
@@ -854,18 +1707,18 @@ int main(int argc, char *argv[])
 		// because we want our IP to be the primary IP (first in the IP address list),
 		// so that the global routing is based on our IP
 		NetDeviceContainer d = qbb.Install(snode, dnode);   //  安装QbbNetDevice到源节点和目的节点，并返回一个NetDeviceContainer对象，包含两个QbbNetDevice对象。
+		// a host with several links has one NIC (rail) per link, all with the host's IP
 		if (snode->GetNodeType() == 0){   //   是主机节点
 			Ptr<Ipv4> ipv4 = snode->GetObject<Ipv4>();
-			ipv4->AddInterface(d.Get(0)); //   将网络设备添加到节点的接口列表中
-			ipv4->AddAddress(1, Ipv4InterfaceAddress(serverAddress[src], Ipv4Mask(0xff000000)));  // 1应该表示是第一个端口（the primary IP）， mask表示子网掩码为 255.0.0.0
+			uint32_t intf = ipv4->AddInterface(d.Get(0)); //   将网络设备添加到节点的接口列表中
+			ipv4->AddAddress(intf, Ipv4InterfaceAddress(serverAddress[src], Ipv4Mask(0xff000000)));  // 1应该表示是第一个端口（the primary IP）， mask表示子网掩码为 255.0.0.0
 		}
 		if (dnode->GetNodeType() == 0){   //是主机节点
 			Ptr<Ipv4> ipv4 = dnode->GetObject<Ipv4>();
-			ipv4->AddInterface(d.Get(1));
-			ipv4->AddAddress(1, Ipv4InterfaceAddress(serverAddress[dst], Ipv4Mask(0xff000000)));
+			uint32_t intf = ipv4->AddInterface(d.Get(1));
+			ipv4->AddAddress(intf, Ipv4InterfaceAddress(serverAddress[dst], Ipv4Mask(0xff000000)));
 		}
 
-		6
 		nbr2if[snode][dnode].idx = DynamicCast<QbbNetDevice>(d.Get(0))->GetIfIndex();   //GetIfIndex(); ???具体实现在哪里
 		nbr2if[snode][dnode].up = true;// 表示link正常工作  skip down link
 		nbr2if[snode][dnode].delay = DynamicCast<QbbChannel>(DynamicCast<QbbNetDevice>(d.Get(0))->GetChannel())->GetDelay().GetTimeStep();
@@ -874,6 +1727,10 @@ int main(int argc, char *argv[])
 		nbr2if[dnode][snode].up = true;
 		nbr2if[dnode][snode].delay = DynamicCast<QbbChannel>(DynamicCast<QbbNetDevice>(d.Get(1))->GetChannel())->GetDelay().GetTimeStep();
 		nbr2if[dnode][snode].bw = DynamicCast<QbbNetDevice>(d.Get(1))->GetDataRate().GetBitRate();
+		if (IntHeader::mode == IntHeader::NORMAL && IntHop::GetRateIndex(nbr2if[snode][dnode].bw) < 0){
+			std::cout << "Error: link rate " << nbr2if[snode][dnode].bw << " is not in INT_LINE_RATES\n";
+			return 1;
+		}
 
 		// This is just to set up the connectivity between nodes. The IP addresses are useless
 		char ipstring[16];
@@ -929,10 +1786,22 @@ int main(int argc, char *argv[])
 					sw->m_mmu->pfc_a_shift[j]--;
 					rate /= 2;
 				}
+
+				// set scheduling
+				for (auto &r : switch_sched)
+					if ((r.node < 0 || r.node == (int)i) && (r.port < 0 || r.port == (int)j))
+						for (auto &v : r.items)
+							dev->GetQueue()->SetScheduling(v[0], v[1], v[2]);
 			}
 			sw->m_mmu->ConfigNPort(sw->GetNDevices()-1);
 			sw->m_mmu->ConfigBufferSize(buffer_size* 1024 * 1024);
 			sw->m_mmu->node_id = sw->GetId();
+			for (auto &it : pool2ratio)
+				sw->m_mmu->ConfigPool(it.first, it.second);
+			for (uint32_t pg = 0; pg < SwitchMmu::qCnt; pg++){
+				bool lossless = std::find(lossy_pg.begin(), lossy_pg.end(), pg) == lossy_pg.end();
+				sw->m_mmu->ConfigPg(pg, pg2pool.count(pg) ? pg2pool[pg] : 0, lossless, pg2alpha.count(pg) ? pg2alpha[pg] : 0);
+			}
 		}
 	}
 
@@ -954,6 +1823,23 @@ int main(int argc, char *argv[])
 			rdmaHw->SetAttribute("RateAI", DataRateValue(DataRate(rate_ai)));
 			rdmaHw->SetAttribute("RateHAI", DataRateValue(DataRate(rate_hai)));
 			rdmaHw->SetAttribute("L2BackToZero", BooleanValue(l2_back_to_zero));
+			rdmaHw->SetAttribute("L2SelectiveRepeat", BooleanValue(l2_selective_repeat));
+			rdmaHw->SetAttribute("AckCoalesceCount", UintegerValue(ack_coalesce_count));
+			rdmaHw->SetAttribute("AckCoalesceTime", UintegerValue(ack_coalesce_time));
+			rdmaHw->SetAttribute("AckCoalesceMaxQlen", BooleanValue(ack_coalesce_max_qlen));
+			rdmaHw->SetAttribute("SprayPaths", UintegerValue(spray_paths));
+			rdmaHw->SetAttribute("ReorderBufferSize", UintegerValue(reorder_buffer_size));
+			rdmaHw->SetAttribute("ReorderTimeout", UintegerValue(reorder_timeout));
+			rdmaHw->SetAttribute("RailPolicy", UintegerValue(rail_policy));
+			rdmaHw->SetAttribute("NicModel", BooleanValue(nic_model));
+			rdmaHw->SetAttribute("QpcCacheSize", UintegerValue(qpc_cache_size));
+			rdmaHw->SetAttribute("QpcHitLatency", UintegerValue(qpc_hit_latency));
+			rdmaHw->SetAttribute("QpcMissLatency", UintegerValue(qpc_miss_latency));
+			rdmaHw->SetAttribute("QpcSize", UintegerValue(qpc_size));
+			rdmaHw->SetAttribute("WqeSize", UintegerValue(wqe_size));
+			rdmaHw->SetAttribute("PcieBandwidth", DataRateValue(DataRate(pcie_bandwidth)));
+			rdmaHw->SetAttribute("PcieLatency", UintegerValue(pcie_latency));
+			rdmaHw->SetAttribute("NicRxBuffer", UintegerValue(nic_rx_buffer));
 			rdmaHw->SetAttribute("L2ChunkSize", UintegerValue(l2_chunk_size));
 			rdmaHw->SetAttribute("L2AckInterval", UintegerValue(l2_ack_interval));
 			rdmaHw->SetAttribute("CcMode", UintegerValue(cc_mode));
@@ -965,9 +1851,13 @@ int main(int argc, char *argv[])
 			rdmaHw->SetAttribute("FastReact", BooleanValue(fast_react));
 			rdmaHw->SetAttribute("MultiRate", BooleanValue(multi_rate));
 			rdmaHw->SetAttribute("SampleFeedback", BooleanValue(sample_feedback));
+			rdmaHw->SetAttribute("AdaptiveRouting", BooleanValue(routing_mode != SwitchNode::ROUTE_ECMP));
 			rdmaHw->SetAttribute("TargetUtil", DoubleValue(u_target));
 			rdmaHw->SetAttribute("RateBound", BooleanValue(rate_bound));
 			rdmaHw->SetAttribute("DctcpRateAI", DataRateValue(DataRate(dctcp_rate_ai)));
+			rdmaHw->SetAttribute("FluidThreshold", UintegerValue(fluid_threshold));
+			rdmaHw->SetAttribute("FluidChunk", UintegerValue(fluid_chunk));
+			rdmaHw->SetAttribute("FluidStableCount", UintegerValue(fluid_stable));
 			rdmaHw->SetPintSmplThresh(pint_prob);
 			// create and install RdmaDriver
 			Ptr<RdmaDriver> rdma = CreateObject<RdmaDriver>();
@@ -978,6 +1868,18 @@ int main(int argc, char *argv[])
 			node->AggregateObject (rdma);
 			rdma->Init();
 			rdma->TraceConnectWithoutContext("QpComplete", MakeBoundCallback (qp_finish, fct_output));
+			if (rdmaHw->GetNRails() > 1){
+				multi_rail = true;
+				if (rail_flows.size() <= rdmaHw->GetNRails()){
+					rail_flows.resize(rdmaHw->GetNRails() + 1, 0);
+					rail_bytes.resize(rdmaHw->GetNRails() + 1, 0);
+				}
+			}
+			for (auto &r : nic_pg_weight)
+				if (r.node < 0 || r.node == (int)i)
+					for (uint32_t j = 1; j < node->GetNDevices(); j++)
+						for (auto &v : r.items)
+							DynamicCast<QbbNetDevice>(node->GetDevice(j))->GetRdmaQueue()->SetPgWeight(v[0], v[1]);
 		}
 	}
 	#endif
@@ -1025,6 +1927,10 @@ int main(int argc, char *argv[])
 			Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n.Get(i));
 			sw->SetAttribute("CcMode", UintegerValue(cc_mode));
 			sw->SetAttribute("MaxRtt", UintegerValue(maxRtt));
+			sw->SetAttribute("RoutingMode", UintegerValue(routing_mode));
+			sw->SetAttribute("FlowletTimeout", UintegerValue(flowlet_timeout));
+			sw->SetAttribute("DreTau", UintegerValue(dre_tau));
+			sw->SetAttribute("TenantStats", BooleanValue(tenant_stats));
 		}
 	}
 
@@ -1080,6 +1986,65 @@ int main(int argc, char *argv[])
 			}
 	}
 
+	// setup the flow generator, at the NIC rate of the hosts
+	if (use_flow_gen){
+		for (uint32_t i = 0; i < node_num; i++)
+			if (n.Get(i)->GetNodeType() == 0)
+				flow_gen_hosts.push_back(i);
+		flow_gen.nhost = flow_gen_hosts.size();
+		// the load is relative to all NICs of a host
+		flow_gen.bw = 0;
+		for (uint32_t j = 1; j < n.Get(flow_gen_hosts[0])->GetNDevices(); j++)
+			flow_gen.bw += DynamicCast<QbbNetDevice>(n.Get(flow_gen_hosts[0])->GetDevice(j))->GetDataRate().GetBitRate();
+		flow_gen.start = 2000000000;
+		flow_gen.end = flow_gen.start + flow_gen_time * 1e9;
+		if (flow_gen.flow_size == 0 && !flow_gen.cdf.Load(flow_gen_cdf.c_str())){
+			std::cout << "Error: invalid FLOW_GEN_CDF " << flow_gen_cdf << "\n";
+			return 1;
+		}
+		if (!flow_gen.Init()){
+			std::cout << "Error: invalid FLOW_GEN parameters\n";
+			return 1;
+		}
+		flow_num = UINT32_MAX; // unknown until the generator runs out
+		printf("FLOW_GEN: about %lu flows\n", flow_gen.Estimate());
+	}
+
+	// collectives, on the hosts in the order of node id
+	FILE *coll_output = NULL;
+	if (!coll_file.empty()){
+		vector<uint32_t> hosts;
+		for (uint32_t i = 0; i < node_num; i++)
+			if (n.Get(i)->GetNodeType() == 0)
+				hosts.push_back(i);
+		std::string err = coll_engine.Load(coll_file.c_str(), hosts);
+		if (!err.empty()){
+			std::cout << "Error: COLLECTIVE_FILE " << err << "\n";
+			return 1;
+		}
+		coll_engine.startFlow = MakeCallback(&start_coll_flow);
+		coll_engine.Start();
+		if (!coll_output_file.empty())
+			coll_output = fopen(coll_output_file.c_str(), "w");
+	}
+
+	// closed-loop flows and rpc clients
+	if (!rpc_file.empty()){
+		vector<uint32_t> hosts;
+		for (uint32_t i = 0; i < node_num; i++)
+			if (n.Get(i)->GetNodeType() == 0)
+				hosts.push_back(i);
+		std::string err = rpc_engine.Load(rpc_file.c_str(), hosts);
+		if (!err.empty()){
+			std::cout << "Error: RPC_FILE " << err << "\n";
+			return 1;
+		}
+		rpc_engine.startFlow = MakeCallback(&start_rpc_flow);
+		if (!rpc_output_file.empty())
+			rpc_engine.fout = fopen(rpc_output_file.c_str(), "w");
+		rpc_engine.Start();
+	}
+
 	flow_input.idx = 0;
 	if (flow_num > 0){
 		ReadFlowInput();
@@ -1099,6 +2064,44 @@ int main(int argc, char *argv[])
 	FILE* qlen_output = fopen(qlen_mon_file.c_str(), "w");
 	Simulator::Schedule(NanoSeconds(qlen_mon_start), &monitor_buffer, qlen_output, &n);
 
+	// schedule PFC deadlock and pause storm detector
+	if (pfc_mon_interval > 0){
+		if (!pfc_mon_file.empty())
+			pfc_mon.fout = fopen(pfc_mon_file.c_str(), "w");
+		pfc_mon.interval = MicroSeconds(pfc_mon_interval);
+		pfc_mon.Install(n);
+		pfc_mon.Start(Seconds(2));
+	}
+
+	// schedule progress report
+	if (progress_interval > 0){
+		progress.fout = progress_file.empty() ? NULL : fopen(progress_file.c_str(), "w");
+		gettimeofday(&progress.start, NULL);
+		progress.last_print = progress.last_check = progress.start;
+		progress.last_events = progress.last_sim_ns = 0;
+		progress.step = 1000;
+		Simulator::Schedule(Seconds(0), &check_progress);
+	}
+
+	// schedule parameter sweep
+	if (fork_variants.size() > 0){
+		#if ENABLE_QP
+		fork_outputs.push_back(make_pair(fct_output, fct_output_file));
+		#endif
+		fork_outputs.push_back(make_pair(pfc_file, pfc_output_file));
+		fork_outputs.push_back(make_pair(trace_output, trace_output_file));
+		fork_outputs.push_back(make_pair(qlen_output, qlen_mon_file));
+		if (progress.fout)
+			fork_outputs.push_back(make_pair(progress.fout, progress_file));
+		if (pfc_mon_interval > 0 && !pfc_mon_file.empty())
+			fork_outputs.push_back(make_pair(pfc_mon.fout, pfc_mon_file));
+		if (coll_output)
+			fork_outputs.push_back(make_pair(coll_output, coll_output_file));
+		if (rpc_engine.fout)
+			fork_outputs.push_back(make_pair(rpc_engine.fout, rpc_output_file));
+		Simulator::Schedule(Seconds(fork_time), &fork_sweep);
+	}
+
 	//
 	// Now, do the actual simulation.
 	//
@@ -1107,6 +2110,169 @@ int main(int argc, char *argv[])
 	NS_LOG_INFO("Run Simulation.");
 	Simulator::Stop(Seconds(simulator_stop_time));
 	Simulator::Run();
+	// one-line summary parsed by benchmarks/run_bench.py
+	printf("SIM_STATS events %lu sim_ns %lu\n", Simulator::GetEventCount(), Simulator::Now().GetTimeStep());
+	if (!fct_slowdown.empty()){
+		// tail FCT and goodput of the finished flows, to compare routing modes and other settings
+		std::sort(fct_slowdown.begin(), fct_slowdown.end());
+		double sum = 0;
+		for (double s : fct_slowdown)
+			sum += s;
+		uint32_t nf = fct_slowdown.size();
+		printf("FCT_STATS flows %u avg_slowdown %.3lf p99_slowdown %.3lf goodput_gbps %.3lf\n", nf, sum / nf,
+				fct_slowdown[std::min(nf - 1, (uint32_t)(nf * 0.99))], fct_bytes * 8.0 / (fct_last_end - fct_first_start));
+	}
+	for (uint32_t i = 0; i < coll_engine.coll.size(); i++){
+		CollectiveEngine::Collective &c = coll_engine.coll[i];
+		printf("COLL_STATS coll %u op %s algo %s hosts %lu bytes %lu steps %u", i, CollectiveEngine::OpName(c.op), CollectiveEngine::AlgoName(c.algo), c.hosts.size(), c.size, c.nstep);
+		if (c.end >= 0)
+			printf(" time_us %.3lf busbw_gbps %.3lf\n", (c.end - c.begin) / 1e3, coll_engine.BusBw(c));
+		else
+			printf(" unfinished\n");
+	}
+	if (coll_output){
+		coll_engine.Report(coll_output);
+		fclose(coll_output);
+	}
+	if (!rpc_engine.flow.empty()){
+		uint64_t done = 0;
+		int64_t first = -1, last = -1;
+		for (auto &f : rpc_engine.flow){
+			if (f.begin >= 0 && (first < 0 || f.begin < first))
+				first = f.begin;
+			if (f.end >= 0){
+				done++;
+				last = std::max(last, f.end);
+			}
+		}
+		printf("RPC_FLOWS flows %lu done %lu first_start %ld last_end %ld\n", rpc_engine.flow.size(), done, first, last);
+	}
+	for (uint32_t i = 0; i < rpc_engine.client.size(); i++){
+		RpcEngine::Client &c = rpc_engine.client[i];
+		std::sort(c.lat.begin(), c.lat.end());
+		double avg = 0;
+		for (int64_t l : c.lat)
+			avg += l;
+		if (!c.lat.empty())
+			avg /= c.lat.size();
+		// the rate is over the time from the client's start to the end of the simulation
+		double dur = (Simulator::Now().GetTimeStep() - c.start) / 1e9;
+		printf("RPC_STATS client %u src %u dst %u rpcs %lu avg_us %.3lf p50_us %.3lf p99_us %.3lf max_us %.3lf krps %.3lf\n", i, c.src, c.dst, c.done,
+				avg / 1e3, RpcEngine::Percentile(c.lat, 50) / 1e3, RpcEngine::Percentile(c.lat, 99) / 1e3, c.lat.empty() ? 0 : c.lat.back() / 1e3, dur > 0 ? c.done / dur / 1e3 : 0);
+	}
+	if (rpc_engine.fout)
+		fclose(rpc_engine.fout);
+	if (multi_rail){
+		// qps per rail; a striped message counts once on each rail
+		for (uint32_t r = 1; r < rail_flows.size(); r++)
+			printf("RAIL_STATS rail %u flows %lu bytes %lu goodput_gbps %.3lf\n", r, rail_flows[r], rail_bytes[r], rail_bytes[r] * 8.0 / (fct_last_end - fct_first_start));
+	}
+	if (tenant_stats){
+		// per tenant: the finished flows (goodput over the span of its flows), then the sums over the switches,
+		// with the largest buffer bytes of the tenant in a switch
+		for (uint32_t k = 0; k < SwitchMmu::tCnt; k++){
+			TenantFct &t = tenant_fct[k];
+			uint64_t tx = 0, drops = 0, pauses = 0;
+			uint32_t peak = 0;
+			for (uint32_t i = 0; i < node_num; i++){
+				if (n.Get(i)->GetNodeType() != 1)
+					continue;
+				Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n.Get(i));
+				tx += sw->m_tenantTxBytes[k];
+				drops += sw->m_mmu->tenant_drops[k];
+				pauses += sw->m_mmu->tenant_pauses[k];
+				peak = std::max(peak, sw->m_mmu->tenant_peak[k]);
+			}
+			if (t.flows == 0 && tx == 0)
+				continue;
+			printf("TENANT_STATS tenant %u flows %lu bytes %lu avg_slowdown %.3lf p50_slowdown %.3lf p99_slowdown %.3lf goodput_gbps %.3lf switch_tx_bytes %lu max_buffer_bytes %u drops %lu pauses %lu\n",
+					k, t.flows, t.bytes, t.flows ? t.sum_slowdown / t.flows : 0, t.flows ? tenant_slowdown_pctl(t, 50) : 0, t.flows ? tenant_slowdown_pctl(t, 99) : 0,
+					t.last_end > t.first_start ? t.bytes * 8.0 / (t.last_end - t.first_start) : 0, tx, peak, drops, pauses);
+		}
+	}
+	if (nic_model){
+		// per NIC, then the total; PCIe throughput over the time of the finished flows
+		double span = fct_last_end > fct_first_start ? fct_last_end - fct_first_start : 1;
+		NicModel sum;
+		for (uint32_t i = 0; i < node_num; i++){
+			if (n.Get(i)->GetNodeType() != 0)
+				continue;
+			Ptr<RdmaHw> rdmaHw = n.Get(i)->GetObject<RdmaDriver>()->m_rdma;
+			for (uint32_t j = 0; j < rdmaHw->m_nic.size(); j++){
+				if (rdmaHw->m_nic[j].dev == NULL)
+					continue;
+				NicModel &m = rdmaHw->m_nic[j].model;
+				printf("NIC_STATS node %u nic %u qpc_hit %lu qpc_miss %lu pcie_rd_gbps %.3lf pcie_wr_gbps %.3lf rx_drops %lu rx_wait_us %.3lf\n", i, j,
+						m.hits, m.misses, m.rdBytes * 8 / span, m.wrBytes * 8 / span, m.rxDrops, m.rxWait.GetNanoSeconds() / 1e3);
+				sum.hits += m.hits;
+				sum.misses += m.misses;
+				sum.rdBytes += m.rdBytes;
+				sum.wrBytes += m.wrBytes;
+				sum.rxDrops += m.rxDrops;
+				sum.rxWait += m.rxWait;
+			}
+		}
+		printf("NIC_STATS total qpc_hit %lu qpc_miss %lu pcie_rd_gbps %.3lf pcie_wr_gbps %.3lf rx_drops %lu rx_wait_us %.3lf\n",
+				sum.hits, sum.misses, sum.rdBytes * 8 / span, sum.wrBytes * 8 / span, sum.rxDrops, sum.rxWait.GetNanoSeconds() / 1e3);
+	}
+	if (routing_mode != SwitchNode::ROUTE_ECMP){
+		uint64_t n_flowlet = 0, n_reroute = 0;
+		for (uint32_t i = 0; i < node_num; i++){
+			if (n.Get(i)->GetNodeType() == 1){
+				Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(n.Get(i));
+				n_flowlet += sw->m_nFlowlet;
+				n_reroute += sw->m_nReroute;
+			}
+		}
+		printf("ROUTE_STATS mode %u flowlets %lu reroutes %lu\n", routing_mode, n_flowlet, n_reroute);
+	}
+	if (error_rate_per_link > 0 || l2_selective_repeat || spray_paths > 1 || reorder_buffer_size > 0){
+		uint64_t retx_pkts = 0, retx_bytes = 0, reorder_pkts = 0, reorder_nacks = 0;
+		for (uint32_t i = 0; i < node_num; i++){
+			if (n.Get(i)->GetNodeType() == 0){
+				Ptr<RdmaHw> rdmaHw = n.Get(i)->GetObject<RdmaDriver>()->m_rdma;
+				retx_pkts += rdmaHw->m_retxPkts;
+				retx_bytes += rdmaHw->m_retxBytes;
+				reorder_pkts += rdmaHw->m_reorderPkts;
+				reorder_nacks += rdmaHw->m_reorderNacks;
+			}
+		}
+		printf("RETX packets %lu bytes %lu\n", retx_pkts, retx_bytes);
+		if (reorder_buffer_size > 0)
+			printf("REORDER kept %lu nacks %lu\n", reorder_pkts, reorder_nacks);
+	}
+	if (!pool2ratio.empty() || !pg2pool.empty() || !lossy_pg.empty() || !pg2alpha.empty()){
+		// drops summed over the switches, peaks are the max of one switch
+		for (uint32_t p = 0; p < SwitchMmu::poolCnt; p++){
+			uint64_t drops = 0;
+			uint32_t size = 0, peak = 0, hdrm_peak = 0;
+			for (uint32_t i = 0; i < node_num; i++){
+				if (n.Get(i)->GetNodeType() == 1){
+					Ptr<SwitchMmu> mmu = DynamicCast<SwitchNode>(n.Get(i))->m_mmu;
+					drops += mmu->pool_drops[p];
+					size = std::max(size, mmu->pool_size[p]);
+					peak = std::max(peak, mmu->pool_peak[p]);
+					hdrm_peak = std::max(hdrm_peak, mmu->pool_hdrm_peak[p]);
+				}
+			}
+			if (size > 0)
+				printf("MMU_STATS pool %u size %u drops %lu peak_used %u peak_hdrm %u\n", p, size, drops, peak, hdrm_peak);
+		}
+	}
+	if (pfc_mon_interval > 0){
+		printf("PFC_MON deadlock %u storm %u\n", pfc_mon.n_deadlock, pfc_mon.n_storm);
+		if (pfc_mon.fout != stderr)
+			fclose(pfc_mon.fout);
+	}
+	if (progress_interval > 0){
+		struct timeval now;
+		gettimeofday(&now, NULL);
+		print_progress(now);
+		if (progress.fout)
+			fclose(progress.fout);
+	}
+	for (auto pid : fork_children)
+		waitpid(pid, NULL, 0);
 	Simulator::Destroy();
 	NS_LOG_INFO("Done.");
 	fclose(trace_output);
@@ -30,6 +30,7 @@
 #include "ns3/uinteger.h"
 #include "ns3/random-variable.h"
 #include "ns3/qbb-net-device.h"
+#include "ns3/switch-mmu.h"
 #include "ns3/ipv4-end-point.h"
 #include "rdma-client.h"
 #include "ns3/seq-ts-header.h"
@@ -87,6 +88,16 @@ RdmaClient::GetTypeId (void)
                    UintegerValue (0),
                    MakeUintegerAccessor (&RdmaClient::m_baseRtt),
                    MakeUintegerChecker<uint64_t> ())
+    .AddAttribute ("Rail",
+                   "The NIC to send on (1: the first NIC of the host), 0: picked by the RDMA hw",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&RdmaClient::m_rail),
+                   MakeUintegerChecker<uint32_t> ())
+    .AddAttribute ("Tenant",
+                   "The tenant (job) of the flow, for the per-tenant accounting",
+                   UintegerValue (0),
+                   MakeUintegerAccessor (&RdmaClient::m_tenant),
+                   MakeUintegerChecker<uint16_t> (0, SwitchMmu::tCnt - 1))
   ;
   return tid;
 }
@@ -138,7 +149,7 @@ void RdmaClient::StartApplication (void)
   // get RDMA driver and add up queue pair
   Ptr<Node> node = GetNode();
   Ptr<RdmaDriver> rdma = node->GetObject<RdmaDriver>();
-  rdma->AddQueuePair(m_size, m_pg, m_sip, m_dip, m_sport, m_dport, m_win, m_baseRtt, MakeCallback(&RdmaClient::Finish, this));
+  rdma->AddQueuePair(m_size, m_pg, m_sip, m_dip, m_sport, m_dport, m_win, m_baseRtt, m_rail, m_tenant, MakeCallback(&RdmaClient::Finish, this));
 }
 
 void RdmaClient::StopApplication ()
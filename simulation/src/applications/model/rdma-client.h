@@ -76,6 +76,8 @@ private:
   uint16_t m_sport, m_dport;
   uint32_t m_win; // bound of on-the-fly packets
   uint64_t m_baseRtt; // base Rtt
+  uint32_t m_rail; // NIC of the host, 0: any
+  uint16_t m_tenant;
 };
 
 } // namespace ns3
@@ -64,6 +64,8 @@ public:
   virtual void SetScheduler (ObjectFactory schedulerFactory);
   virtual uint32_t GetSystemId (void) const; 
   virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+  virtual uint32_t GetEventQueueSize (void) const;
 
 private:
   virtual void DoDispose (void);
@@ -89,6 +91,7 @@ private:
 
   uint32_t m_uid;
   uint32_t m_currentUid;
+  uint64_t m_eventCount;
   uint64_t m_currentTs;
   uint32_t m_currentContext;
   // number of events that have been inserted but not yet scheduled,
@@ -73,6 +73,8 @@ public:
   virtual void SetScheduler (ObjectFactory schedulerFactory);
   virtual uint32_t GetSystemId (void) const; 
   virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+  virtual uint32_t GetEventQueueSize (void) const;
 
   void ScheduleRealtimeWithContext (uint32_t context, Time const &time, EventImpl *event);
   void ScheduleRealtime (Time const &time, EventImpl *event);
@@ -103,6 +105,7 @@ private:
   int m_unscheduledEvents;
   uint32_t m_uid;
   uint32_t m_currentUid;
+  uint64_t m_eventCount;
   uint64_t m_currentTs;
   uint32_t m_currentContext;
 
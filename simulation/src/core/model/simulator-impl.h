@@ -182,6 +182,15 @@ public:
    * \return the current simulation context
    */
   virtual uint32_t GetContext (void) const = 0;
+  /**
+   * \return the number of events executed so far
+   */
+  virtual uint64_t GetEventCount (void) const = 0;
+  /**
+   * \return the number of events waiting in the queue, including
+   *         cancelled events that have not been removed yet
+   */
+  virtual uint32_t GetEventQueueSize (void) const = 0;
 };
 
 } // namespace ns3
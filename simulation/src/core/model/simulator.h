@@ -748,6 +748,17 @@ public:
    */
   static uint32_t GetContext (void);
 
+  /**
+   * \returns the number of events executed so far
+   */
+  static uint64_t GetEventCount (void);
+
+  /**
+   * \returns the number of events waiting in the queue, including
+   *          cancelled events that have not been removed yet
+   */
+  static uint32_t GetEventQueueSize (void);
+
   /**
    * \param time delay until the event expires
    * \param event the event to schedule
@@ -90,7 +90,7 @@ SeqTsHeader::Print (std::ostream &os) const
 uint32_t
 SeqTsHeader::GetSerializedSize (void) const
 {
-	return GetHeaderSize();
+	return 6 + ih.GetSerializedSize();
 }
 uint32_t SeqTsHeader::GetHeaderSize(void){
 	return 6 + IntHeader::GetStaticSize();
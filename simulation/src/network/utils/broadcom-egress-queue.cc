@@ -41,6 +41,11 @@ namespace ns3 {
 				DoubleValue(1000.0 * 1024 * 1024),
 				MakeDoubleAccessor(&BEgressQueue::m_maxBytes),
 				MakeDoubleChecker<double>())
+			.AddAttribute("QueueCount",
+				"The number of queues of this BEgressQueue.",
+				UintegerValue(qCnt),
+				MakeUintegerAccessor(&BEgressQueue::SetQueueCount, &BEgressQueue::GetQueueCount),
+				MakeUintegerChecker<uint32_t>(1, maxCnt))
 			.AddTraceSource ("BeqEnqueue", "Enqueue a packet in the BEgressQueue. Multiple queue",
 					MakeTraceSourceAccessor (&BEgressQueue::m_traceBeqEnqueue))
 			.AddTraceSource ("BeqDequeue", "Dequeue a packet in the BEgressQueue. Multiple queue",
@@ -56,30 +61,90 @@ namespace ns3 {
 		NS_LOG_FUNCTION_NOARGS();
 		m_bytesInQueueTotal = 0;
 		m_rrlast = 0;
+		m_qlast = 0;
+		m_nonEmpty = 0;
+		SetQueueCount(qCnt);
+	}
+
+	BEgressQueue::~BEgressQueue()
+	{
+		NS_LOG_FUNCTION_NOARGS();
+	}
 
-		// 网卡队列数量 fcnt     交换机队列数量 qcnt
-		for (uint32_t i = 0; i < fCnt; i++)
+	void
+		BEgressQueue::PacketRing::Push(Ptr<Packet> p)
+	{
+		if (n == buf.size())
 		{
-			m_bytesInQueue[i] = 0;
-			m_queues.push_back(CreateObject<DropTailQueue>());
+			// unroll the ring into a new array of twice the size
+			std::vector<Ptr<Packet> > nbuf(buf.empty() ? 16 : buf.size() * 2);
+			for (uint32_t i = 0; i < n; i++)
+				nbuf[i] = buf[(head + i) & (buf.size() - 1)];
+			buf.swap(nbuf);
+			head = 0;
 		}
+		buf[(head + n) & (buf.size() - 1)] = p;
+		n++;
+		bytes += p->GetSize();
 	}
 
-	BEgressQueue::~BEgressQueue()
+	Ptr<Packet>
+		BEgressQueue::PacketRing::Pop()
 	{
-		NS_LOG_FUNCTION_NOARGS();
+		Ptr<Packet> p = buf[head];
+		buf[head] = 0;
+		head = (head + 1) & (buf.size() - 1);
+		n--;
+		bytes -= p->GetSize();
+		return p;
+	}
+
+	void
+		BEgressQueue::SetQueueCount(uint32_t n)
+	{
+		NS_ASSERT_MSG(n >= 1 && n <= maxCnt, "BEgressQueue::SetQueueCount: invalid number of queues");
+		NS_ASSERT_MSG(m_bytesInQueueTotal == 0, "BEgressQueue::SetQueueCount: the queue is not empty");
+		m_queues.assign(n, PacketRing());
+		m_rrlast = 0;
+		// one round robin tier of queues 1..n-1
+		m_tier.assign(n, 0);
+		m_tierMask.assign(1, (n == maxCnt ? ~0u : (1u << n) - 1) & ~1u);
+		m_tierSched.assign(1, DwrrScheduler());
+	}
+
+	void
+		BEgressQueue::SetScheduling(uint32_t qIndex, uint32_t tier, uint32_t weight)
+	{
+		NS_ASSERT_MSG(qIndex > 0 && qIndex < m_queues.size(), "BEgressQueue::SetScheduling: invalid qIndex");
+		NS_ASSERT_MSG(tier < maxCnt, "BEgressQueue::SetScheduling: invalid tier");
+		if (tier >= m_tierMask.size())
+		{
+			m_tierMask.resize(tier + 1, 0);
+			m_tierSched.resize(tier + 1);
+		}
+		m_tierMask[m_tier[qIndex]] &= ~(1u << qIndex);
+		m_tier[qIndex] = tier;
+		m_tierMask[tier] |= 1u << qIndex;
+		m_tierSched[tier].SetWeight(qIndex, weight);
+	}
+
+	uint32_t
+		BEgressQueue::GetQueueCount() const
+	{
+		return m_queues.size();
 	}
 
 	bool
 		BEgressQueue::DoEnqueue(Ptr<Packet> p, uint32_t qIndex)
 	{
 		NS_LOG_FUNCTION(this << p);
+		NS_ASSERT_MSG(qIndex < m_queues.size(), "BEgressQueue::DoEnqueue: qIndex >= QueueCount");
 
 		if (m_bytesInQueueTotal + p->GetSize() < m_maxBytes)  //infinite queue
 		{
-			m_queues[qIndex]->Enqueue(p);
+			m_queues[qIndex].Push(p);
+			m_nonEmpty |= 1u << qIndex;
 			m_bytesInQueueTotal += p->GetSize();
-			m_bytesInQueue[qIndex] += p->GetSize();
 		}
 		else
 		{
@@ -101,34 +166,52 @@ namespace ns3 {
 		bool found = false;
 		uint32_t qIndex;
 
-		if (m_queues[0]->GetNPackets() > 0) //0 is the highest priority
+		if (m_nonEmpty & 1) //0 is the highest priority
 		{
 			found = true;
 			qIndex = 0;
 		}
 		else    //查看其余的队列
 		{
-			if (!found)
+			// the non-empty and not paused queues, round robin from m_rrlast + 1
+			uint32_t ready = 0;
+			for (uint32_t m = m_nonEmpty; m; m &= m - 1)
+			{
+				uint32_t i = __builtin_ctz(m);
+				if (!paused[i])
+					ready |= 1u << i;
+			}
+			// the first tier that has a ready queue
+			for (uint32_t t = 0; t < m_tierMask.size() && !found; t++)
 			{
-				for (qIndex = 1; qIndex <= qCnt; qIndex++)
+				uint32_t r = ready & m_tierMask[t];
+				if (r == 0)
+					continue;
+				if (m_tierSched[t].IsEnabled())
+					qIndex = m_tierSched[t].Select(r);
+				else
 				{
-					// 队列未暂停，                          且队列中有数据
-					if (!paused[(qIndex + m_rrlast) % qCnt] && m_queues[(qIndex + m_rrlast) % qCnt]->GetNPackets() > 0)  //round robin
-					{
-						found = true;
-						break;
-					}
+					uint32_t start = (m_rrlast + 1) % m_queues.size();
+					uint32_t after = r & ~((1u << start) - 1);
+					qIndex = __builtin_ctz(after ? after : r);
 				}
-				// 找到为qindex     没有找到则是 m_rrlast+1 
-				qIndex = (qIndex + m_rrlast) % qCnt;     
+				found = true;
 			}
 		}
 		if (found)  // 找到数据 , 排除form循环中qindex+1的情况
 		{
-			Ptr<Packet> p = m_queues[qIndex]->Dequeue();
+			Ptr<Packet> p = m_queues[qIndex].Pop();
+			if (qIndex != 0)
+			{
+				DwrrScheduler &sched = m_tierSched[m_tier[qIndex]];
+				sched.Charge(qIndex, p->GetSize());
+				if (m_queues[qIndex].n == 0)
+					sched.Reset(qIndex);
+			}
+			if (m_queues[qIndex].n == 0)
+				m_nonEmpty &= ~(1u << qIndex);
 			m_traceBeqDequeue(p, qIndex);
 			m_bytesInQueueTotal -= p->GetSize();
-			m_bytesInQueue[qIndex] -= p->GetSize();
 			if (qIndex != 0)
 			{
 				m_rrlast = qIndex;
@@ -191,9 +274,9 @@ namespace ns3 {
 		NS_LOG_FUNCTION(this << p);
 		if (m_bytesInQueueTotal + p->GetSize() < m_maxBytes)
 		{
-			m_queues[qIndex]->Enqueue(p);
+			m_queues[qIndex].Push(p);
+			m_nonEmpty |= 1u << qIndex;
 			m_bytesInQueueTotal += p->GetSize();
-			m_bytesInQueue[qIndex] += p->GetSize();
 		}
 		else
 		{
@@ -222,14 +305,16 @@ namespace ns3 {
 			NS_LOG_LOGIC("Queue empty");
 			return 0;
 		}
-		NS_LOG_LOGIC("Number bytes " << m_bytesInQueue);
-		return m_queues[0]->Peek();
+		NS_LOG_LOGIC("Number bytes " << m_bytesInQueueTotal);
+		if (m_queues[0].n == 0)
+			return 0;
+		return m_queues[0].buf[m_queues[0].head];
 	}
 
 	uint32_t
 		BEgressQueue::GetNBytes(uint32_t qIndex) const
 	{
-		return m_bytesInQueue[qIndex];
+		return qIndex < m_queues.size() ? m_queues[qIndex].bytes : 0;
 	}
 
 
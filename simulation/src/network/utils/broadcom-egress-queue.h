@@ -23,6 +23,7 @@
 #include "ns3/packet.h"
 #include "queue.h"
 #include "drop-tail-queue.h"
+#include "dwrr-scheduler.h"
 #include "ns3/point-to-point-net-device.h"
 #include "ns3/event-id.h"
 
@@ -35,6 +36,7 @@ namespace ns3 {
 		static TypeId GetTypeId(void);
 		static const unsigned fCnt = 128; //max number of queues, 128 for NICs
 		static const unsigned qCnt = 8; //max number of queues, 8 for switches
+		static const unsigned maxCnt = 32; //max number of queues of the bitmask
 		BEgressQueue();
 		virtual ~BEgressQueue();
 		bool Enqueue(Ptr<Packet> p, uint32_t qIndex);
@@ -42,6 +44,11 @@ namespace ns3 {
 		uint32_t GetNBytes(uint32_t qIndex) const;
 		uint32_t GetNBytesTotal() const;
 		uint32_t GetLastQueue();
+		void SetQueueCount(uint32_t n);
+		uint32_t GetQueueCount() const;
+		// queue 0 is always served first; the others are served by tier (0 first), and within a tier
+		// by DWRR if any queue of the tier has a weight, otherwise by round robin
+		void SetScheduling(uint32_t qIndex, uint32_t tier, uint32_t weight);
 
 		TracedCallback<Ptr<const Packet>, uint32_t> m_traceBeqEnqueue;
 		TracedCallback<Ptr<const Packet>, uint32_t> m_traceBeqDequeue;
@@ -53,12 +60,26 @@ namespace ns3 {
 		virtual bool DoEnqueue(Ptr<Packet> p);
 		virtual Ptr<Packet> DoDequeue(void);
 		virtual Ptr<const Packet> DoPeek(void) const;
+
+		// a FIFO of packets in a circular array, which doubles when full
+		struct PacketRing{
+			std::vector<Ptr<Packet> > buf; // the size is 0 or a power of 2
+			uint32_t head, n;
+			uint32_t bytes;
+			PacketRing() : head(0), n(0), bytes(0) {}
+			void Push(Ptr<Packet> p);
+			Ptr<Packet> Pop();
+		};
+
 		double m_maxBytes; //total bytes limit
-		uint32_t m_bytesInQueue[fCnt];
 		uint32_t m_bytesInQueueTotal;
 		uint32_t m_rrlast;
 		uint32_t m_qlast;
-		std::vector<Ptr<Queue> > m_queues; // uc queues
+		std::vector<PacketRing> m_queues; // uc queues, only as many as the QueueCount
+		uint32_t m_nonEmpty; // bit i: queue i has packets
+		std::vector<uint32_t> m_tier; // queue -> tier
+		std::vector<uint32_t> m_tierMask; // tier -> its queues
+		std::vector<DwrrScheduler> m_tierSched;
 	};
 
 } // namespace ns3
@@ -95,10 +95,10 @@ uint32_t CustomHeader::GetSerializedSize (void) const{
 			len += tcp.length * 4; // len 加上 5 * 4 字节
 			// 一行为4个字节
 		else if (l3Prot == 0x11) // UDP
-			len += GetUdpHeaderSize();
+			len += 8 + sizeof(udp.pg) + sizeof(udp.seq) + udp.ih.GetSerializedSize();
 			// return 8 + sizeof(udp.pg) + sizeof(udp.seq) + IntHeader::GetStaticSize();
 		else if (l3Prot == 0xFC || l3Prot == 0xFD)
-			len += GetAckSerializedSize();
+			len += GetAckSerializedSize() - IntHeader::GetStaticSize() + ack.ih.GetSerializedSize() + (((ack.flags >> 1) & 1) ? 8 : 0); // qbbHeader::FLAG_SACK
 		else if (l3Prot == 0xFF)
 			len += 8;
 		else if (l3Prot == 0xFE)
@@ -187,7 +187,11 @@ void CustomHeader::Serialize (Buffer::Iterator start) const{
 		  i.WriteU16(ack.flags);
 		  i.WriteU16(ack.pg);
 		  i.WriteU32(ack.seq);
-		  udp.ih.Serialize(i);
+		  if ((ack.flags >> 1) & 1){ // qbbHeader::FLAG_SACK
+			  i.WriteU32(ack.sackBegin);
+			  i.WriteU32(ack.sackEnd);
+		  }
+		  ack.ih.Serialize(i); // not udp.ih, which is at another offset in the union since the SACK fields
 	  }else if (l3Prot == 0xFE){ // PFC
 		  i.WriteU32 (pfc.time);
 		  i.WriteU32 (pfc.qlen);
@@ -306,10 +310,7 @@ CustomHeader::Deserialize (Buffer::Iterator start)
 		  // SeqTsHeader
 		  udp.seq = i.ReadNtohU32 ();
 		  udp.pg =  i.ReadNtohU16 ();
-		  if (getInt)
-			  udp.ih.Deserialize(i);
-
-		  l4Size = GetUdpHeaderSize();
+		  l4Size = 8 + sizeof(udp.pg) + sizeof(udp.seq) + udp.ih.Deserialize(i, getInt);
 	  }else if (l3Prot == 0xFF){
 		  cnp.qIndex = i.ReadU8();
 		  cnp.fid = i.ReadU16();
@@ -323,9 +324,13 @@ CustomHeader::Deserialize (Buffer::Iterator start)
 		  ack.flags = i.ReadU16();
 		  ack.pg = i.ReadU16();
 		  ack.seq = i.ReadU32();
-		  if (getInt)
-			  ack.ih.Deserialize(i);
-		  l4Size = GetAckSerializedSize();
+		  l4Size = GetAckSerializedSize() - IntHeader::GetStaticSize();
+		  if ((ack.flags >> 1) & 1){ // qbbHeader::FLAG_SACK
+			  ack.sackBegin = i.ReadU32();
+			  ack.sackEnd = i.ReadU32();
+			  l4Size += 8;
+		  }
+		  l4Size += ack.ih.Deserialize(i, getInt);
 	  }else if (l3Prot == 0xFE){ // PFC
 		  pfc.time = i.ReadU32 ();
 		  pfc.qlen = i.ReadU32 ();
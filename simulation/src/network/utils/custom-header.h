@@ -127,6 +127,7 @@ public:
 		  uint16_t flags;     // cnp = (ch.ack.flags >> qbbHeader::FLAG_CNP) & 1;
 		  uint16_t pg;
 		  uint32_t seq; // the qbb sequence number.
+		  uint32_t sackBegin, sackEnd; // only with qbbHeader::FLAG_SACK
 		  IntHeader ih;
 	  } ack;
 	  // PauseHeader
@@ -0,0 +1,73 @@
+#ifndef DWRR_SCHEDULER_H
+#define DWRR_SCHEDULER_H
+
+#include <stdint.h>
+#include "ns3/assert.h"
+
+namespace ns3 {
+
+/*
+ * Deficit weighted round robin over up to 32 classes (queues or PGs).
+ * The caller passes the classes that can send as a bit mask, and charges the bytes sent after each packet.
+ * The current class keeps the turn while its deficit is positive; then the next ready class gets a quantum
+ * of weight * unit bytes. With unit no less than a packet, each selection takes O(1) amortized steps.
+ */
+class DwrrScheduler{
+public:
+	static const uint32_t maxCnt = 32;
+	static const uint32_t unit = 1500; // bytes per unit of weight
+
+	DwrrScheduler() : m_cur(0), m_enabled(false) {
+		for (uint32_t i = 0; i < maxCnt; i++){
+			m_quantum[i] = unit;
+			m_deficit[i] = 0;
+		}
+	}
+
+	// weight 0 leaves the class at the default weight 1
+	void SetWeight(uint32_t i, uint32_t weight){
+		NS_ASSERT_MSG(i < maxCnt, "DwrrScheduler::SetWeight: class out of range");
+		if (weight == 0)
+			return;
+		m_quantum[i] = weight * unit;
+		m_enabled = true;
+	}
+	uint32_t GetWeight(uint32_t i) const{
+		return m_quantum[i] / unit;
+	}
+	// whether any weight is set; otherwise the user does plain round robin
+	bool IsEnabled() const{
+		return m_enabled;
+	}
+
+	// ready must not be 0
+	uint32_t Select(uint32_t ready){
+		if (((ready >> m_cur) & 1) && m_deficit[m_cur] > 0)
+			return m_cur;
+		for (;;){
+			// the next ready class after m_cur, wrapping around
+			uint32_t after = m_cur + 1 < maxCnt ? ready & ~((2u << m_cur) - 1) : 0;
+			m_cur = __builtin_ctz(after ? after : ready);
+			m_deficit[m_cur] += m_quantum[m_cur];
+			if (m_deficit[m_cur] > 0)
+				return m_cur;
+		}
+	}
+	void Charge(uint32_t i, uint32_t bytes){
+		m_deficit[i] -= bytes;
+	}
+	// the class has nothing to send, so it does not keep its deficit
+	void Reset(uint32_t i){
+		m_deficit[i] = 0;
+	}
+
+private:
+	uint32_t m_quantum[maxCnt];
+	int64_t m_deficit[maxCnt];
+	uint32_t m_cur;
+	bool m_enabled;
+};
+
+} // namespace ns3
+
+#endif /* DWRR_SCHEDULER_H */
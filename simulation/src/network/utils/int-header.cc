@@ -2,20 +2,54 @@
 
 namespace ns3 {
 
-const uint64_t IntHop::lineRateValues[8] = {25000000000lu,50000000000lu,100000000000lu,200000000000lu,400000000000lu,0,0,0};
+uint32_t IntHop::timeWidth = 24;
+uint32_t IntHop::bytesWidth = 20;
+uint32_t IntHop::qlenWidth = 17;
+uint32_t IntHop::rateWidth = 3;
+uint32_t IntHop::nBytes = 8;
+std::vector<uint64_t> IntHop::lineRateValues = {25000000000lu,50000000000lu,100000000000lu,200000000000lu,400000000000lu,800000000000lu,1600000000000lu};
 uint32_t IntHop::multi = 1;
 
 IntHeader::Mode IntHeader::mode = NONE;
 int IntHeader::pint_bytes = 2;
+uint32_t IntHeader::maxHop = 5;
+bool IntHeader::compact = false;
 
-IntHeader::IntHeader() : nhop(0) {
-	for (uint32_t i = 0; i < maxHop; i++)
+std::string IntHop::Configure(uint32_t _timeWidth, uint32_t _bytesWidth, uint32_t _qlenWidth, const std::vector<uint64_t> &rates){
+	if (rates.empty())
+		return "no line rate";
+	if (_timeWidth < 1 || _timeWidth > 40 || _bytesWidth < 1 || _bytesWidth > 40 || _qlenWidth < 1 || _qlenWidth > 32)
+		return "widths must be in [1, 40] for time and bytes, [1, 32] for qlen";
+	uint32_t r = 0;
+	while ((1lu << r) < rates.size())
+		r++;
+	uint32_t total = r + _timeWidth + _bytesWidth + _qlenWidth;
+	if (total > 64)
+		return "the fields take " + std::to_string(total) + " bits, more than 64";
+	timeWidth = _timeWidth;
+	bytesWidth = _bytesWidth;
+	qlenWidth = _qlenWidth;
+	rateWidth = r;
+	nBytes = (total + 7) / 8;
+	lineRateValues = rates;
+	return "";
+}
+
+IntHeader::IntHeader() : nhop(0), nslot(maxHop) {
+	for (uint32_t i = 0; i < hopCapacity; i++)
 		hop[i] = {0};
 }
 
+std::string IntHeader::SetMaxHop(uint32_t n){
+	if (n < 1 || n > hopCapacity)
+		return "the hop count must be in [1, " + std::to_string(hopCapacity) + "]";
+	maxHop = n;
+	return "";
+}
+
 uint32_t IntHeader::GetStaticSize(){
 	if (mode == NORMAL){  //  int mode
-		return sizeof(hop) + sizeof(nhop);
+		return compact ? 4 + maxHop * IntHop::nBytes : maxHop * IntHop::nBytes + 2;
 	}else if (mode == TS){
 		return sizeof(ts);
 	}else if (mode == PINT){
@@ -25,23 +59,72 @@ uint32_t IntHeader::GetStaticSize(){
 	}
 }
 
-void IntHeader::PushHop(uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate){
+uint32_t IntHeader::GetSerializedSize() const{
+	if (mode == NORMAL && compact)
+		return 4 + nslot * IntHop::nBytes;
+	return GetStaticSize();
+}
+
+static void WriteHop(Buffer::Iterator &i, const IntHop &h){
+	for (uint32_t b = 0; b < IntHop::nBytes; b++)
+		i.WriteU8(h.v >> (8 * b));
+}
+
+static void ReadHop(Buffer::Iterator &i, IntHop &h){
+	h.v = 0;
+	for (uint32_t b = 0; b < IntHop::nBytes; b++)
+		h.v |= (uint64_t)i.ReadU8() << (8 * b);
+}
+
+void IntHeader::PushHop(uint8_t *buf, uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate){
 	// only do this in INT mode
-	if (mode == NORMAL){
-		uint32_t idx = nhop % maxHop;
-		hop[idx].Set(time, bytes, qlen, rate);
-		nhop++;
+	if (mode != NORMAL)
+		return;
+	// the layout of Serialize, in little endian
+	uint8_t *pn, *slots;
+	uint32_t n;
+	if (compact){
+		pn = buf;
+		n = buf[2] | (buf[3] << 8);
+		slots = buf + 4;
+	}else {
+		pn = buf + maxHop * IntHop::nBytes;
+		n = maxHop;
+		slots = buf;
 	}
+	uint16_t nh = pn[0] | (pn[1] << 8);
+	if (n > 0){
+		IntHop h;
+		h.v = 0;
+		h.Set(time, bytes, qlen, rate);
+		uint8_t *p = slots + (nh % n) * IntHop::nBytes;
+		for (uint32_t b = 0; b < IntHop::nBytes; b++)
+			p[b] = h.v >> (8 * b);
+	}
+	nh++;
+	pn[0] = nh & 0xff;
+	pn[1] = nh >> 8;
+}
+
+void IntHeader::Trim(){
+	if (compact && nhop < nslot)
+		nslot = nhop;
 }
 
+// NORMAL: maxHop hops then nhop, or if compact, nhop and nslot then nslot hops
 void IntHeader::Serialize (Buffer::Iterator start) const{
 	Buffer::Iterator i = start;
 	if (mode == NORMAL){
-		for (uint32_t j = 0; j < maxHop; j++){
-			i.WriteU32(hop[j].buf[0]);
-			i.WriteU32(hop[j].buf[1]);
+		if (compact){
+			i.WriteU16(nhop);
+			i.WriteU16(nslot);
+			for (uint32_t j = 0; j < nslot; j++)
+				WriteHop(i, hop[j]);
+		}else {
+			for (uint32_t j = 0; j < maxHop; j++)
+				WriteHop(i, hop[j]);
+			i.WriteU16(nhop);
 		}
-		i.WriteU16(nhop);
 	}else if (mode == TS){
 		i.WriteU64(ts);
 	}else if (mode == PINT){
@@ -52,14 +135,21 @@ void IntHeader::Serialize (Buffer::Iterator start) const{
 	}
 }
 
-uint32_t IntHeader::Deserialize (Buffer::Iterator start){
+uint32_t IntHeader::Deserialize (Buffer::Iterator start, bool withHops){
 	Buffer::Iterator i = start;
-	if (mode == NORMAL){
-		for (uint32_t j = 0; j < maxHop; j++){
-			hop[j].buf[0] = i.ReadU32();
-			hop[j].buf[1] = i.ReadU32();
-		}
+	if (mode == NORMAL && compact){
 		nhop = i.ReadU16();
+		nslot = i.ReadU16();
+		if (withHops)
+			for (uint32_t j = 0; j < nslot; j++)
+				ReadHop(i, hop[j]);
+	}else if (!withHops){
+		// the size does not depend on the content
+	}else if (mode == NORMAL){
+		for (uint32_t j = 0; j < maxHop; j++)
+			ReadHop(i, hop[j]);
+		nhop = i.ReadU16();
+		nslot = maxHop;
 	}else if (mode == TS){
 		ts = i.ReadU64();
 	}else if (mode == PINT){
@@ -68,7 +158,7 @@ uint32_t IntHeader::Deserialize (Buffer::Iterator start){
 		else if (pint_bytes == 2)
 			pint.power = i.ReadU16();
 	}
-	return GetStaticSize();
+	return GetSerializedSize();
 }
 
 uint64_t IntHeader::GetTs(void){
@@ -2,8 +2,11 @@
 #define INT_HEADER_H
 
 #include "ns3/buffer.h"
+#include "ns3/fatal-error.h"
 #include <stdint.h>
 #include <cstdio>
+#include <string>
+#include <vector>
 // IntHop 类被用来表示每个网络跳的遥测数据，
 // IntHeader 则是一个包含多个网络跳数据的结构体
 
@@ -13,71 +16,78 @@ namespace ns3 {
 // 被设计用于在网络数据包中嵌入遥测数据，例如每个网络跳的速率、字节数、队列长度和时间戳等信息
 class IntHop{   //IntHop 类用于表示每个网络跳的遥测数据。遥测数据包括链路速率、传输的字节数、队列长度以及时间
 public:
-	static const uint32_t timeWidth = 24;
-	static const uint32_t bytesWidth = 20;
-	static const uint32_t qlenWidth = 17;
-	static const uint64_t lineRateValues[8]; 
-	//lineRateValues[8]：存储了可能的链路速率值，如 25Gbps、50Gbps、100Gbps、200Gbps、400Gbps。
-	union{
-		struct {
-			uint64_t lineRate: 64-timeWidth-bytesWidth-qlenWidth,
-					 time: timeWidth,
-					 bytes: bytesWidth,
-					 qlen: qlenWidth;
-		};
-		uint32_t buf[2];
-	};
+	// field widths in bits; the line rate takes the bits needed to index lineRateValues, and the hop is
+	// serialized in the bytes needed for all fields (at most 8). See Configure
+	static uint32_t timeWidth;
+	static uint32_t bytesWidth;
+	static uint32_t qlenWidth;
+	static uint32_t rateWidth;
+	static uint32_t nBytes; // serialized size of a hop
+	static std::vector<uint64_t> lineRateValues; // bps, indexed by the lineRate field
+	//lineRateValues：存储了可能的链路速率值，默认 25/50/100/200/400/800/1600Gbps。
+	// the fields from the lowest bits: lineRate, time, bytes, qlen
+	uint64_t v;
 
 	static const uint32_t byteUnit = 128;
 	static const uint32_t qlenUnit = 80;
 	static uint32_t multi;//multi：是一个静态倍数，用于扩展 byteUnit 和 qlenUnit
 
-	uint64_t GetLineRate(){
-		return lineRateValues[lineRate];  // ??
+	// set the widths and the rate table; returns an error message, empty if OK
+	static std::string Configure(uint32_t _timeWidth, uint32_t _bytesWidth, uint32_t _qlenWidth, const std::vector<uint64_t> &rates);
+	// index of rate in lineRateValues, -1 if not there
+	static int32_t GetRateIndex(uint64_t rate){
+		for (uint32_t i = 0; i < lineRateValues.size(); i++)
+			if (lineRateValues[i] == rate)
+				return i;
+		return -1;
+	}
+
+	uint64_t GetLineRate() const{
+		return lineRateValues[Field(0, rateWidth)];
+	}
+	uint64_t GetBytes() const{
+		return Field(rateWidth + timeWidth, bytesWidth) * byteUnit * multi;
 	}
-	uint64_t GetBytes(){
-		//??
-		return (uint64_t)bytes * byteUnit * multi;
+	uint32_t GetQlen() const{
+		return Field(rateWidth + timeWidth + bytesWidth, qlenWidth) * qlenUnit * multi;
 	}
-	uint32_t GetQlen(){
-		// ??
-		return (uint32_t)qlen * qlenUnit * multi;
+	uint64_t GetTime() const{
+		return Field(rateWidth, timeWidth);
 	}
-	uint64_t GetTime(){
-		return time;
+	void SetQlen(uint32_t _qlen){
+		SetField(rateWidth + timeWidth + bytesWidth, qlenWidth, _qlen / (qlenUnit * multi));
 	}
 	void Set(uint64_t _time, uint64_t _bytes, uint32_t _qlen, uint64_t _rate){
-		time = _time;
-		bytes = _bytes / (byteUnit * multi);
-		qlen = _qlen / (qlenUnit * multi);
-		switch (_rate){
-			case 25000000000lu:
-				lineRate=0;break;
-			case 50000000000lu:
-				lineRate=1;break;
-			case 100000000000lu:
-				lineRate=2;break;
-			case 200000000000lu:
-				lineRate=3;break;
-			case 400000000000lu:
-				lineRate=4;break;
-			default:
-				printf("Error: IntHeader unknown rate: %lu\n", _rate);
-				break;
-		}
+		int32_t r = GetRateIndex(_rate);
+		if (r < 0)
+			NS_FATAL_ERROR("IntHeader unknown rate: " << _rate);
+		v = r;
+		SetField(rateWidth, timeWidth, _time);
+		SetField(rateWidth + timeWidth, bytesWidth, _bytes / (byteUnit * multi));
+		SetQlen(_qlen);
 	}
 	uint64_t GetBytesDelta(IntHop &b){ //计算当前对象与另一个 IntHop 对象之间的字节差异（用于比较两次遥测数据的变化）
-		if (bytes >= b.bytes)
-			return (bytes - b.bytes) * byteUnit * multi;
+		uint64_t bytes = Field(rateWidth + timeWidth, bytesWidth), b_bytes = b.Field(rateWidth + timeWidth, bytesWidth);
+		if (bytes >= b_bytes)
+			return (bytes - b_bytes) * byteUnit * multi;
 		else
 			// 如果 bytes 为 30，而 b.bytes 为 250（且字节计数器最大值为 256），则采用计数器环绕的逻辑：(30 + 256 - 250) * byteUnit * multi。         字节循环（环绕）计算：
-			return (bytes + (1<<bytesWidth) - b.bytes) * byteUnit * multi;
+			return (bytes + (1lu<<bytesWidth) - b_bytes) * byteUnit * multi;
 	}
 	uint64_t GetTimeDelta(IntHop &b){
-		if (time >= b.time)
-			return time - b.time;
+		uint64_t time = GetTime(), b_time = b.GetTime();
+		if (time >= b_time)
+			return time - b_time;
 		else
-			return time + (1<<timeWidth) - b.time;
+			return time + (1lu<<timeWidth) - b_time;
+	}
+
+	uint64_t Field(uint32_t shift, uint32_t width) const{
+		return (v >> shift) & ((1lu << width) - 1);
+	}
+	void SetField(uint32_t shift, uint32_t width, uint64_t x){
+		uint64_t mask = ((1lu << width) - 1) << shift;
+		v = (v & ~mask) | ((x << shift) & mask);
 	}
 };
 
@@ -85,7 +95,9 @@ public:
 //在数据包的头部用于存储多个网络跳的遥测信息。
 class IntHeader{  
 public:
-	static const uint32_t maxHop = 5;
+	static const uint32_t hopCapacity = 16; // the bound of maxHop
+	static uint32_t maxHop; // hop slots in data packets
+	static bool compact; // serialize only the slots in use, see Serialize
 	enum Mode{
 		NORMAL = 0,
 		TS = 1,
@@ -95,25 +107,33 @@ public:
 	static Mode mode;
 	static int pint_bytes; //是一个静态整数，表示 PINT 模式下的字节数。
 
-	// Note: the structure of IntHeader must have no internal padding, because we will directly transform the part of packet buffer to IntHeader*
 	union{
 		struct {
-			IntHop hop[maxHop];
+			IntHop hop[hopCapacity];
 			uint16_t nhop; //nhop：存储跳数。
+			uint16_t nslot; // hop slots carried by the packet
 		};
 		uint64_t ts;     //    ts：存储时间戳。
 		union {
-			uint16_t power;  //：获取或设置 PINT 模式下的功率值。			struct{
+			uint16_t power;  //：获取或设置 PINT 模式下的功率值。
+			struct{
 				uint8_t power_lo8, power_hi8;
 			};
 		}pint;
 	};
 
 	IntHeader();
-	static uint32_t GetStaticSize();
-	void PushHop(uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate);
+	// set the hop slots of data packets; returns an error message, empty if OK
+	static std::string SetMaxHop(uint32_t n);
+	static uint32_t GetStaticSize(); // with maxHop slots
+	uint32_t GetSerializedSize() const;
+	// push a hop into a serialized header in the packet buffer, by the switch
+	static void PushHop(uint8_t *buf, uint64_t time, uint64_t bytes, uint32_t qlen, uint64_t rate);
+	// for an ACK: keep only the slots in use
+	void Trim();
 	void Serialize (Buffer::Iterator start) const;
-	uint32_t Deserialize (Buffer::Iterator start);
+	// without hops, only the counts are read (if compact), to get the size
+	uint32_t Deserialize (Buffer::Iterator start, bool withHops = true);
 	uint64_t GetTs(void);
 	uint16_t GetPower(void);
 	void SetPower(uint16_t);
@@ -0,0 +1,278 @@
+#include <fstream>
+#include <algorithm>
+#include "ns3/simulator.h"
+#include "collective-engine.h"
+
+namespace ns3 {
+
+const char* CollectiveEngine::OpName(Op op){
+	static const char *name[] = {"allreduce", "allgather", "reducescatter", "alltoall"};
+	return name[op];
+}
+
+const char* CollectiveEngine::AlgoName(Algo algo){
+	static const char *name[] = {"ring", "tree", "hier", "direct"};
+	return name[algo];
+}
+
+std::string CollectiveEngine::Load(const char *file, const std::vector<uint32_t> &hosts){
+	std::ifstream f(file);
+	uint32_t num;
+	if (!(f >> num))
+		return std::string("cannot read ") + file;
+	for (uint32_t i = 0; i < num; i++){
+		std::string op, algo;
+		double start;
+		uint32_t first, nhost;
+		Collective c;
+		if (!(f >> op >> algo >> c.size >> start >> first >> nhost >> c.local >> c.chunks))
+			return "collective " + std::to_string(i) + ": bad line";
+		uint32_t k;
+		for (k = 0; k < 4 && op != OpName((Op)k); k++);
+		if (k == 4)
+			return "collective " + std::to_string(i) + ": unknown op " + op;
+		c.op = (Op)k;
+		for (k = 0; k < 4 && algo != AlgoName((Algo)k); k++);
+		if (k == 4)
+			return "collective " + std::to_string(i) + ": unknown algorithm " + algo;
+		c.algo = (Algo)k;
+		if (i == 0 && start < 0)
+			return "the first collective needs a start time";
+		c.start = start < 0 ? -1 : (int64_t)(start * 1e9 + 0.5);
+		if (first + nhost > hosts.size())
+			return "collective " + std::to_string(i) + ": not enough hosts";
+		c.hosts.assign(hosts.begin() + first, hosts.begin() + first + nhost);
+		std::string err = Build(c);
+		if (!err.empty())
+			return "collective " + std::to_string(i) + ": " + err;
+		coll.push_back(c);
+	}
+	return "";
+}
+
+uint32_t CollectiveEngine::Add(Collective &c, uint32_t src, uint32_t dst, uint64_t size, uint32_t step, int32_t d0, int32_t d1){
+	Transfer x;
+	x.src = c.hosts[src];
+	x.dst = c.hosts[dst];
+	x.size = std::max(size, (uint64_t)1);
+	x.step = step;
+	x.deps = 0;
+	x.last = -1;
+	x.start = x.end = -1;
+	uint32_t id = c.t.size();
+	c.t.push_back(x);
+	AddDep(c, id, d0);
+	if (d1 != d0)
+		AddDep(c, id, d1);
+	c.nstep = std::max(c.nstep, step + 1);
+	return id;
+}
+
+void CollectiveEngine::AddDep(Collective &c, uint32_t id, int32_t d){
+	if (d < 0)
+		return;
+	c.t[d].next.push_back(id);
+	c.t[id].deps++;
+}
+
+void CollectiveEngine::Ring(Collective &c, const std::vector<uint32_t> &g, uint64_t chunk, uint32_t step0, std::vector<int32_t> &lastSend, std::vector<int32_t> &lastRecv){
+	uint32_t m = g.size();
+	std::vector<int32_t> prev(m), cur(m);
+	for (uint32_t k = 0; k + 1 < m; k++){
+		for (uint32_t i = 0; i < m; i++){
+			uint32_t r = g[i];
+			if (k == 0)
+				cur[i] = Add(c, r, g[(i + 1) % m], chunk, step0, lastSend[r], lastRecv[r]);
+			else
+				cur[i] = Add(c, r, g[(i + 1) % m], chunk, step0 + k, prev[i], prev[(i + m - 1) % m]);
+		}
+		prev.swap(cur);
+	}
+	if (m < 2)
+		return;
+	for (uint32_t i = 0; i < m; i++){
+		lastSend[g[i]] = prev[i];
+		lastRecv[g[(i + 1) % m]] = prev[i];
+	}
+}
+
+void CollectiveEngine::Tree(Collective &c){
+	// binary tree in heap order, rank 0 is the root. Children have larger ranks than their parent
+	uint32_t m = c.hosts.size();
+	std::vector<uint32_t> height(m, 0), depth(m, 0);
+	for (uint32_t i = m - 1; i > 0; i--)
+		height[(i - 1) / 2] = std::max(height[(i - 1) / 2], height[i] + 1);
+	for (uint32_t i = 1; i < m; i++)
+		depth[i] = depth[(i - 1) / 2] + 1;
+	std::vector<int32_t> up(m, -1), down(m, -1); // transfers of the previous chunk: i -> parent, parent -> i
+	for (uint32_t j = 0; j < c.chunks; j++){
+		uint64_t size = c.size / c.chunks + (j < c.size % c.chunks);
+		// reduce: a rank sends to its parent after it has received from its children
+		std::vector<int32_t> cu(m, -1), cd(m, -1);
+		for (uint32_t i = m - 1; i > 0; i--){
+			cu[i] = Add(c, i, (i - 1) / 2, size, height[i], up[i], -1);
+			for (uint32_t ch = 2 * i + 1; ch <= 2 * i + 2 && ch < m; ch++)
+				AddDep(c, cu[i], cu[ch]);
+		}
+		// broadcast: the root sends after it has received from its children, the others after their parent
+		for (uint32_t i = 1; i < m; i++){
+			uint32_t p = (i - 1) / 2;
+			if (p == 0){
+				cd[i] = Add(c, 0, i, size, height[0] + depth[p], down[i], cu[1]);
+				if (m > 2)
+					AddDep(c, cd[i], cu[2]);
+			}else
+				cd[i] = Add(c, p, i, size, height[0] + depth[p], down[i], cd[p]);
+		}
+		up.swap(cu);
+		down.swap(cd);
+	}
+}
+
+std::string CollectiveEngine::Build(Collective &c){
+	uint32_t n = c.hosts.size();
+	if (n < 2)
+		return "needs at least 2 hosts";
+	if (c.size == 0)
+		return "size must be > 0";
+	if (c.chunks == 0)
+		c.chunks = 1;
+	if (c.op == ALL_TO_ALL ? c.algo != RING && c.algo != DIRECT : c.algo == DIRECT)
+		return std::string(AlgoName(c.algo)) + " does not support " + OpName(c.op);
+	if (c.algo == TREE && c.op != ALL_REDUCE)
+		return "tree only supports allreduce";
+	if (c.algo == HIER && (c.local < 1 || n % c.local != 0))
+		return "local must divide the number of hosts";
+	c.t.clear();
+	c.nstep = 0;
+	c.begin = c.end = -1;
+
+	std::vector<int32_t> lastSend(n, -1), lastRecv(n, -1);
+	std::vector<uint32_t> all(n);
+	for (uint32_t i = 0; i < n; i++)
+		all[i] = i;
+	if (c.op == ALL_TO_ALL){
+		for (uint32_t k = 1; k < n; k++)
+			for (uint32_t i = 0; i < n; i++){
+				if (c.algo == DIRECT)
+					Add(c, i, (i + k) % n, c.size / n, 0, -1, -1);
+				else
+					lastSend[i] = Add(c, i, (i + k) % n, c.size / n, k - 1, lastSend[i], -1);
+			}
+	}else if (c.algo == RING){
+		if (c.op != ALL_GATHER)
+			Ring(c, all, c.size / n, 0, lastSend, lastRecv);
+		if (c.op != REDUCE_SCATTER)
+			Ring(c, all, c.size / n, c.nstep, lastSend, lastRecv);
+	}else if (c.algo == TREE){
+		Tree(c);
+	}else {
+		// groups of `local` consecutive ranks; the cross rings connect the ranks with the same local index
+		uint32_t L = c.local, G = n / L;
+		std::vector<std::vector<uint32_t> > local(G), cross(L);
+		for (uint32_t i = 0; i < n; i++){
+			local[i / L].push_back(i);
+			cross[i % L].push_back(i);
+		}
+		// reduce-scatter: local, then cross; all-gather: cross, then local. All-reduce does both
+		std::vector<std::pair<std::vector<std::vector<uint32_t> >*, uint64_t> > phases;
+		if (c.op != ALL_GATHER){
+			phases.push_back(std::make_pair(&local, c.size / L));
+			phases.push_back(std::make_pair(&cross, c.size / n));
+		}
+		if (c.op != REDUCE_SCATTER){
+			phases.push_back(std::make_pair(&cross, c.size / n));
+			phases.push_back(std::make_pair(&local, c.size / L));
+		}
+		for (auto &ph : phases){
+			uint32_t step0 = c.nstep;
+			for (auto &g : *ph.first)
+				Ring(c, g, ph.second, step0, lastSend, lastRecv);
+		}
+	}
+	c.left = c.t.size();
+	return "";
+}
+
+void CollectiveEngine::Start(){
+	for (uint32_t i = 0; i < coll.size(); i++)
+		if (coll[i].start >= 0)
+			Simulator::Schedule(NanoSeconds(coll[i].start) - Simulator::Now(), &CollectiveEngine::Begin, this, i);
+}
+
+void CollectiveEngine::Begin(uint32_t ci){
+	Collective &c = coll[ci];
+	c.begin = Simulator::Now().GetTimeStep();
+	for (uint32_t i = 0; i < c.t.size(); i++)
+		if (c.t[i].deps == 0)
+			Issue(ci, i);
+}
+
+void CollectiveEngine::Issue(uint32_t ci, uint32_t ti){
+	Transfer &t = coll[ci].t[ti];
+	t.start = Simulator::Now().GetTimeStep();
+	startFlow(t.src, t.dst, t.size, MakeCallback(&CollectiveEngine::Done, this).TwoBind(ci, ti));
+}
+
+void CollectiveEngine::Done(uint32_t ci, uint32_t ti){
+	Collective &c = coll[ci];
+	c.t[ti].end = Simulator::Now().GetTimeStep();
+	for (uint32_t k = 0; k < c.t[ti].next.size(); k++){
+		Transfer &x = c.t[c.t[ti].next[k]];
+		x.last = ti;
+		if (--x.deps == 0)
+			Issue(ci, c.t[ti].next[k]);
+	}
+	if (--c.left == 0){
+		c.end = c.t[ti].end;
+		if (ci + 1 < coll.size() && coll[ci + 1].start < 0)
+			Begin(ci + 1);
+	}
+}
+
+double CollectiveEngine::BusBw(const Collective &c){
+	uint32_t n = c.hosts.size();
+	double factor = c.op == ALL_REDUCE ? 2.0 * (n - 1) / n : (n - 1.0) / n;
+	return c.size * 8.0 / (c.end - c.begin) * factor;
+}
+
+void CollectiveEngine::Report(FILE *fout){
+	for (uint32_t ci = 0; ci < coll.size(); ci++){
+		Collective &c = coll[ci];
+		if (c.begin < 0)
+			continue;
+		// walk back from the transfer that finished last through the dependency that finished last
+		std::vector<int32_t> crit(c.nstep, -1);
+		int32_t last = -1;
+		for (uint32_t i = 0; i < c.t.size(); i++)
+			if (c.t[i].end >= 0 && (last < 0 || c.t[i].end > c.t[last].end))
+				last = i;
+		for (int32_t i = last; i >= 0; i = c.t[i].last)
+			if (crit[c.t[i].step] < 0)
+				crit[c.t[i].step] = i;
+		std::vector<uint32_t> flows(c.nstep, 0);
+		std::vector<int64_t> first(c.nstep, -1), end(c.nstep, -1);
+		for (auto &t : c.t){
+			if (t.start < 0)
+				continue;
+			flows[t.step]++;
+			if (first[t.step] < 0 || t.start < first[t.step])
+				first[t.step] = t.start;
+			if (t.end < 0 || end[t.step] == -2)
+				end[t.step] = -2; // not finished
+			else
+				end[t.step] = std::max(end[t.step], t.end);
+		}
+		// coll step flows first_start last_end [critical: src dst size start end]
+		for (uint32_t s = 0; s < c.nstep; s++){
+			fprintf(fout, "%u %u %u %ld %ld", ci, s, flows[s], first[s], end[s]);
+			if (crit[s] >= 0){
+				Transfer &t = c.t[crit[s]];
+				fprintf(fout, " %u %u %lu %ld %ld", t.src, t.dst, t.size, t.start, t.end);
+			}
+			fprintf(fout, "\n");
+		}
+	}
+}
+
+} /* namespace ns3 */
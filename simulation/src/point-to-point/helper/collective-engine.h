@@ -0,0 +1,93 @@
+#ifndef COLLECTIVE_ENGINE_H
+#define COLLECTIVE_ENGINE_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "ns3/callback.h"
+
+namespace ns3 {
+
+/*
+ * Collective communication workload: all-reduce, all-gather, reduce-scatter and all-to-all over groups of hosts.
+ * A collective is a DAG of transfers (flows), and a transfer starts when the transfers it depends on finish.
+ * In a ring, a rank sends step k after it has received step k-1 and sent its own step k-1. A tree reduces up
+ * and broadcasts down a binary tree, in pipelined chunks. The hierarchical algorithm runs rings within
+ * groups of `local` consecutive ranks and rings across the groups. All-to-all sends to all ranks at once
+ * (direct), or in n-1 shifted steps (ring).
+ * The size of a collective is the full buffer: a rank reduces size bytes, gathers size bytes, or sends
+ * size/n bytes to each rank in all-to-all.
+ * The user starts the flows through startFlow, and calls back `done` when a flow finishes.
+ */
+class CollectiveEngine{
+public:
+	enum Op{
+		ALL_REDUCE = 0,
+		ALL_GATHER = 1,
+		REDUCE_SCATTER = 2,
+		ALL_TO_ALL = 3
+	};
+	enum Algo{
+		RING = 0,
+		TREE = 1,
+		HIER = 2,
+		DIRECT = 3
+	};
+	struct Transfer{
+		uint32_t src, dst; // node ids
+		uint64_t size;
+		uint32_t step;
+		uint32_t deps; // unfinished transfers it waits for
+		int32_t last; // the dependency that finished last, -1: none
+		int64_t start, end; // ns, -1: not yet
+		std::vector<uint32_t> next;
+	};
+	struct Collective{
+		Op op;
+		Algo algo;
+		uint64_t size;
+		int64_t start; // ns, < 0: when the previous collective finishes
+		std::vector<uint32_t> hosts; // node ids, in the order of ranks
+		uint32_t local; // ranks per group, for HIER
+		uint32_t chunks; // for TREE
+		std::vector<Transfer> t;
+		uint32_t nstep;
+		uint32_t left; // unfinished transfers
+		int64_t begin, end; // ns, -1: not yet
+	};
+	// src, dst, size, done
+	typedef Callback<void, uint32_t, uint32_t, uint64_t, Callback<void> > StartFlowCallback;
+
+	StartFlowCallback startFlow;
+	std::vector<Collective> coll;
+
+	static const char* OpName(Op op);
+	static const char* AlgoName(Algo algo);
+	// read a collective file: the number of collectives, then one per line:
+	// op algo size start(s) first_host n_hosts local chunks
+	// hosts are indices into `hosts` (node ids). Returns an error message, empty if OK
+	std::string Load(const char *file, const std::vector<uint32_t> &hosts);
+	// check c and build its transfers. Returns an error message, empty if OK
+	std::string Build(Collective &c);
+	// schedule the collectives; call before the simulation runs
+	void Start();
+	// bus bandwidth (Gbps) of a finished collective, as in nccl-tests
+	double BusBw(const Collective &c);
+	// per step: the flows, first start, last end, and the transfer on the critical path of the collective
+	void Report(FILE *fout);
+
+private:
+	uint32_t Add(Collective &c, uint32_t src, uint32_t dst, uint64_t size, uint32_t step, int32_t d0, int32_t d1);
+	void AddDep(Collective &c, uint32_t id, int32_t d);
+	// a ring over ranks g with chunk bytes per step, from step0; lastSend/lastRecv are updated
+	void Ring(Collective &c, const std::vector<uint32_t> &g, uint64_t chunk, uint32_t step0, std::vector<int32_t> &lastSend, std::vector<int32_t> &lastRecv);
+	void Tree(Collective &c);
+	void Begin(uint32_t ci);
+	void Issue(uint32_t ci, uint32_t ti);
+	void Done(uint32_t ci, uint32_t ti);
+};
+
+} /* namespace ns3 */
+
+#endif /* COLLECTIVE_ENGINE_H */
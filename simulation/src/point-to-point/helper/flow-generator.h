@@ -0,0 +1,224 @@
+#ifndef FLOW_GENERATOR_H
+#define FLOW_GENERATOR_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <deque>
+#include <queue>
+#include <random>
+#include <algorithm>
+
+/*
+ * Flow generator, the C++ version of traffic_gen/traffic_gen.py.
+ * It is used by scratch/third.cc to generate flows on the fly (FLOW_GEN in the config),
+ * and by traffic_gen/traffic_gen.cpp to write a flow file.
+ * Flows are returned lazily in the order of start time. Hosts are numbered 0..nhost-1.
+ */
+
+// a flow size distribution, read from the cdf files in traffic_gen/ (lines of "<size> <percentile>")
+class FlowCdf{
+public:
+	std::vector<std::pair<double, double> > cdf;
+
+	bool Load(const char* file){
+		FILE* f = fopen(file, "r");
+		if (f == NULL)
+			return false;
+		cdf.clear();
+		double x, y;
+		while (fscanf(f, "%lf%lf", &x, &y) == 2)
+			cdf.push_back(std::make_pair(x, y));
+		fclose(f);
+		return Valid();
+	}
+	bool Valid(){
+		if (cdf.size() < 2 || cdf[0].second != 0 || cdf.back().second != 100)
+			return false;
+		for (uint32_t i = 1; i < cdf.size(); i++)
+			if (cdf[i].second <= cdf[i-1].second || cdf[i].first <= cdf[i-1].first)
+				return false;
+		return true;
+	}
+	double GetAvg(){
+		double s = 0;
+		for (uint32_t i = 1; i < cdf.size(); i++)
+			s += (cdf[i].first + cdf[i-1].first) / 2.0 * (cdf[i].second - cdf[i-1].second);
+		return s / 100;
+	}
+	// y is in [0, 100]
+	double GetValueFromPercentile(double y){
+		uint32_t i = std::lower_bound(cdf.begin() + 1, cdf.end() - 1, std::make_pair(0.0, y), CmpY) - cdf.begin();
+		double x0 = cdf[i-1].first, y0 = cdf[i-1].second, x1 = cdf[i].first, y1 = cdf[i].second;
+		return x0 + (x1 - x0) / (y1 - y0) * (y - y0);
+	}
+private:
+	static bool CmpY(const std::pair<double, double> &a, const std::pair<double, double> &b){
+		return a.second < b.second;
+	}
+};
+
+struct GenFlow{
+	uint32_t src, dst;
+	uint64_t size;
+	uint64_t start; // ns
+};
+
+class FlowGenerator{
+public:
+	enum Pattern{
+		POISSON = 0, // every host starts flows with Poisson arrivals to random destinations
+		INCAST = 1, // in each round, `fanin` random hosts send to one random host
+		ALL_TO_ALL = 2 // in each round, every host sends to every other host
+	};
+
+	Pattern pattern;
+	uint32_t nhost;
+	double load; // fraction of the host bandwidth
+	double bw; // host bandwidth in bps
+	uint64_t start, end; // ns, flows start in [start, end]
+	uint64_t seed;
+	uint64_t flow_size; // fixed flow size; 0 means sampling from cdf
+	uint32_t fanin;
+	FlowCdf cdf;
+
+	FlowGenerator() : pattern(POISSON), nhost(0), load(0.3), bw(10e9), start(2000000000), end(2000000000), seed(1), flow_size(0), fanin(2) {}
+
+	static bool ParsePattern(const std::string &s, Pattern &p){
+		if (s == "poisson")
+			p = POISSON;
+		else if (s == "incast")
+			p = INCAST;
+		else if (s == "a2a" || s == "all-to-all")
+			p = ALL_TO_ALL;
+		else
+			return false;
+		return true;
+	}
+
+	// call after setting the parameters (and loading the cdf, if flow_size == 0)
+	bool Init(){
+		if (nhost < 2 || load <= 0 || bw <= 0 || (flow_size == 0 && !cdf.Valid()))
+			return false;
+		if (pattern == INCAST && (fanin < 1 || fanin >= nhost))
+			return false;
+		double avg = flow_size > 0 ? flow_size : cdf.GetAvg();
+		// mean interval between two arrivals, so that each host (or the network on average) is loaded by `load`
+		if (pattern == POISSON)
+			avg_inter_arrival = avg * 8 / (bw * load) * 1e9;
+		else if (pattern == INCAST)
+			avg_inter_arrival = avg * fanin * 8 / (bw * load * nhost) * 1e9;
+		else
+			avg_inter_arrival = avg * (nhost - 1) * 8 / (bw * load) * 1e9;
+		// one rng stream per host, and one for the rounds of incast/all-to-all
+		rng.clear();
+		for (uint32_t i = 0; i <= nhost; i++){
+			std::seed_seq s{seed, (uint64_t)i};
+			rng.push_back(std::mt19937_64(s));
+		}
+		heap = std::priority_queue<Arrival, std::vector<Arrival>, std::greater<Arrival> >();
+		pending.clear();
+		if (pattern == POISSON){
+			for (uint32_t i = 0; i < nhost; i++)
+				heap.push(Arrival(start + Poisson(rng[i]), i));
+		}else
+			next_round = start + Poisson(rng[nhost]);
+		return true;
+	}
+
+	// get the next flow in the order of start time; return false if there is no more flow
+	bool Next(GenFlow &f){
+		if (pattern == POISSON){
+			while (!heap.empty()){
+				Arrival a = heap.top();
+				heap.pop();
+				if (a.first > end)
+					continue;
+				std::mt19937_64 &r = rng[a.second];
+				f.src = a.second;
+				f.dst = RandomHost(r, f.src);
+				f.size = Size(r);
+				f.start = a.first;
+				heap.push(Arrival(a.first + Poisson(r), a.second));
+				return true;
+			}
+			return false;
+		}
+		if (pending.empty())
+			GenerateRound();
+		if (pending.empty())
+			return false;
+		f = pending.front();
+		pending.pop_front();
+		return true;
+	}
+
+	// estimated number of flows
+	uint64_t Estimate(){
+		uint64_t rounds = (end - start) / avg_inter_arrival;
+		if (pattern == POISSON)
+			return rounds * nhost;
+		if (pattern == INCAST)
+			return rounds * fanin;
+		return rounds * nhost * (nhost - 1);
+	}
+
+private:
+	typedef std::pair<uint64_t, uint32_t> Arrival; // <time, host>
+	double avg_inter_arrival; // ns
+	std::vector<std::mt19937_64> rng;
+	std::priority_queue<Arrival, std::vector<Arrival>, std::greater<Arrival> > heap;
+	uint64_t next_round;
+	std::deque<GenFlow> pending;
+
+	static double Uniform(std::mt19937_64 &r){
+		return std::generate_canonical<double, 53>(r);
+	}
+	uint64_t Poisson(std::mt19937_64 &r){
+		return -log(1 - Uniform(r)) * avg_inter_arrival;
+	}
+	uint32_t RandomHost(std::mt19937_64 &r, uint32_t except){
+		uint32_t h = r() % (nhost - 1);
+		return h >= except ? h + 1 : h;
+	}
+	uint64_t Size(std::mt19937_64 &r){
+		if (flow_size > 0)
+			return flow_size;
+		uint64_t s = cdf.GetValueFromPercentile(Uniform(r) * 100);
+		return s > 0 ? s : 1;
+	}
+	void GenerateRound(){
+		if (next_round > end)
+			return;
+		std::mt19937_64 &r = rng[nhost];
+		GenFlow f;
+		f.start = next_round;
+		if (pattern == INCAST){
+			// pick the receiver, then fanin distinct senders
+			f.dst = r() % nhost;
+			std::vector<uint32_t> senders;
+			while (senders.size() < fanin){
+				uint32_t s = RandomHost(r, f.dst);
+				if (std::find(senders.begin(), senders.end(), s) == senders.end())
+					senders.push_back(s);
+			}
+			for (uint32_t s : senders){
+				f.src = s;
+				f.size = Size(rng[s]);
+				pending.push_back(f);
+			}
+		}else {
+			for (f.src = 0; f.src < nhost; f.src++)
+				for (f.dst = 0; f.dst < nhost; f.dst++)
+					if (f.src != f.dst){
+						f.size = Size(rng[f.src]);
+						pending.push_back(f);
+					}
+		}
+		next_round += Poisson(r);
+	}
+};
+
+#endif /* FLOW_GENERATOR_H */
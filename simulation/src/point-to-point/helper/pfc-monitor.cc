@@ -0,0 +1,190 @@
+#include <algorithm>
+#include "ns3/simulator.h"
+#include "ns3/qbb-channel.h"
+#include "ns3/switch-node.h"
+#include "ns3/switch-mmu.h"
+#include "pfc-monitor.h"
+
+namespace ns3 {
+
+PfcMonitor::PfcMonitor() :
+	interval(MicroSeconds(10)), deadlock_time(MicroSeconds(500)), storm_time(MicroSeconds(1000)), storm_ratio(0.95),
+	stop(STOP_NONE), fout(stderr), n_deadlock(0), n_storm(0), n_node(0), n_paused(0), window_start(0)
+{
+}
+
+void PfcMonitor::Install(NodeContainer &n){
+	for (uint32_t i = 0; i < n.GetN(); i++){
+		Ptr<Node> node = n.Get(i);
+		n_node = std::max(n_node, node->GetId() + 1);
+		for (uint32_t j = 0; j < node->GetNDevices(); j++){
+			Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(node->GetDevice(j));
+			if (dev == 0)
+				continue;
+			Ptr<QbbChannel> ch = DynamicCast<QbbChannel>(dev->GetChannel());
+			Port p;
+			p.dev = dev;
+			p.peer_dev = DynamicCast<QbbNetDevice>(ch->GetDevice(0) == dev ? ch->GetDevice(1) : ch->GetDevice(0));
+			p.node = node->GetId();
+			p.intf = dev->GetIfIndex();
+			p.peer = p.peer_dev->GetNode()->GetId();
+			p.peer_intf = p.peer_dev->GetIfIndex();
+			p.is_switch = node->GetNodeType() > 0;
+			p.peer_is_switch = p.peer_dev->GetNode()->GetNodeType() > 0;
+			for (uint32_t q = 0; q < qCnt; q++){
+				p.since[q] = -1;
+				p.paused_ns[q] = 0;
+				p.storm[q] = false;
+			}
+			dev->TraceConnectWithoutContext("QbbPfc", MakeBoundCallback(&PfcMonitor::PfcEvent, this, (uint32_t)ports.size()));
+			ports.push_back(p);
+		}
+	}
+}
+
+void PfcMonitor::Start(Time t){
+	window_start = t.GetTimeStep();
+	Simulator::Schedule(t, &PfcMonitor::Check, this);
+}
+
+void PfcMonitor::PfcEvent(PfcMonitor *m, uint32_t idx, uint32_t type){
+	// the trace does not tell the queue, so compare with the device's pause state
+	Port &p = m->ports[idx];
+	int64_t now = Simulator::Now().GetTimeStep();
+	for (uint32_t q = 0; q < qCnt; q++){
+		bool paused = p.dev->IsPaused(q);
+		if (paused && p.since[q] < 0){
+			p.since[q] = now;
+			m->n_paused++;
+		}else if (!paused && p.since[q] >= 0){
+			p.paused_ns[q] += now - std::max(p.since[q], m->window_start);
+			p.since[q] = -1;
+			m->n_paused--;
+		}
+	}
+}
+
+void PfcMonitor::Check(){
+	int64_t now = Simulator::Now().GetTimeStep();
+	if (n_paused > 0)
+		CheckDeadlock(now);
+	if (now - window_start >= storm_time.GetTimeStep())
+		CheckStorm(now);
+	Simulator::Schedule(interval, &PfcMonitor::Check, this);
+}
+
+void PfcMonitor::CheckDeadlock(int64_t now){
+	int64_t t = now - deadlock_time.GetTimeStep();
+	for (uint32_t q = 0; q < qCnt; q++){
+		// the wait-for graph of priority q: switch -> the ports paused by another switch for deadlock_time
+		std::vector<std::vector<uint32_t> > adj(n_node);
+		bool any = false;
+		for (uint32_t i = 0; i < ports.size(); i++){
+			Port &p = ports[i];
+			if (p.is_switch && p.peer_is_switch && p.since[q] >= 0 && p.since[q] <= t){
+				adj[p.node].push_back(i);
+				any = true;
+			}
+		}
+		if (!any)
+			continue;
+
+		// DFS, each back edge closes a cycle
+		std::vector<uint8_t> color(n_node, 0); // 0: not visited, 1: on the path, 2: done
+		std::vector<uint32_t> next(n_node, 0);
+		std::vector<uint32_t> path; // the ports on the DFS path
+		for (uint32_t s = 0; s < n_node; s++){
+			if (color[s] != 0 || adj[s].empty())
+				continue;
+			color[s] = 1;
+			for (uint32_t u = s; ;){
+				if (next[u] < adj[u].size()){
+					uint32_t e = adj[u][next[u]++];
+					uint32_t v = ports[e].peer;
+					if (color[v] == 0){
+						color[v] = 1;
+						path.push_back(e);
+						u = v;
+					}else if (color[v] == 1){
+						uint32_t k = path.size();
+						while (ports[path[k - 1]].node != v)
+							k--;
+						std::vector<uint32_t> cycle(path.begin() + k - 1, path.end());
+						cycle.push_back(e);
+
+						std::vector<uint32_t> key;
+						for (uint32_t c : cycle)
+							key.push_back(c * qCnt + q);
+						std::sort(key.begin(), key.end());
+						if (!reported.insert(key).second)
+							continue;
+						n_deadlock++;
+						fprintf(fout, "%ld PFC DEADLOCK prio %u: node %u", now, q, ports[cycle[0]].node);
+						for (uint32_t c : cycle)
+							fprintf(fout, " -> %u", ports[c].peer);
+						fprintf(fout, "\n");
+						for (uint32_t c : cycle)
+							PrintPort(ports[c], q, now);
+						Detected(true);
+					}
+				}else {
+					color[u] = 2;
+					if (path.empty())
+						break;
+					u = ports[path.back()].node;
+					path.pop_back();
+				}
+			}
+		}
+	}
+}
+
+void PfcMonitor::CheckStorm(int64_t now){
+	int64_t len = now - window_start;
+	for (uint32_t i = 0; i < ports.size(); i++){
+		Port &p = ports[i];
+		for (uint32_t q = 0; q < qCnt; q++){
+			int64_t t = p.paused_ns[q];
+			if (p.since[q] >= 0)
+				t += now - std::max(p.since[q], window_start);
+			bool storm = t >= storm_ratio * len;
+			if (storm && !p.storm[q]){
+				n_storm++;
+				fprintf(fout, "%ld PFC STORM prio %u: paused %.1lf%% of the last %.3lfus\n", now, q, t * 100.0 / len, len / 1e3);
+				PrintPort(p, q, now);
+				Detected(false);
+			}
+			p.storm[q] = storm;
+			p.paused_ns[q] = 0;
+		}
+	}
+	window_start = now;
+}
+
+void PfcMonitor::PrintPort(const Port &p, uint32_t q, int64_t now){
+	fprintf(fout, "  node %u port %u -> node %u port %u:", p.node, p.intf, p.peer, p.peer_intf);
+	if (p.since[q] >= 0)
+		fprintf(fout, " paused for %.3lfus", (now - p.since[q]) / 1e3);
+	if (p.is_switch){
+		Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(p.dev->GetNode());
+		fprintf(fout, " egress %uB", sw->m_mmu->egress_bytes[p.intf][q]);
+	}
+	if (p.peer_is_switch){
+		// the peer's ingress buffer of this link, which made it send the pause
+		Ptr<SwitchNode> sw = DynamicCast<SwitchNode>(p.peer_dev->GetNode());
+		Ptr<SwitchMmu> mmu = sw->m_mmu;
+		fprintf(fout, " peer ingress %uB hdrm %uB pool %u shared %uB%s", mmu->ingress_bytes[p.peer_intf][q], mmu->hdrm_bytes[p.peer_intf][q],
+				mmu->pg_pool[q], mmu->pool_used[mmu->pg_pool[q]], mmu->paused[p.peer_intf][q] ? " pausing" : "");
+	}
+	fprintf(fout, "\n");
+}
+
+void PfcMonitor::Detected(bool deadlock){
+	if (stop == STOP_ANY || (deadlock && stop == STOP_DEADLOCK)){
+		fprintf(fout, "%ld stop the simulation\n", Simulator::Now().GetTimeStep());
+		Simulator::Stop();
+	}
+	fflush(fout);
+}
+
+} /* namespace ns3 */
@@ -0,0 +1,69 @@
+#ifndef PFC_MONITOR_H
+#define PFC_MONITOR_H
+
+#include <cstdio>
+#include <set>
+#include <vector>
+#include "ns3/nstime.h"
+#include "ns3/node-container.h"
+#include "ns3/qbb-net-device.h"
+
+namespace ns3 {
+
+/*
+ * Online PFC deadlock and pause storm detector.
+ * It follows the pause state of every egress queue through the QbbPfc trace. An egress queue of switch A
+ * paused by switch B means A waits for B to drain, so the paused queues of one priority form a wait-for
+ * graph between switches. A cycle whose queues all stay paused for deadlock_time is a deadlock.
+ * A queue (of a switch or a host) paused for storm_ratio of a storm_time window is in a pause storm.
+ * Each detection writes a snapshot of the involved ports to fout, and may stop the simulation.
+ */
+class PfcMonitor{
+public:
+	enum StopMode{
+		STOP_NONE = 0,
+		STOP_DEADLOCK = 1, // stop at the first deadlock
+		STOP_ANY = 2 // stop at the first deadlock or pause storm
+	};
+	static const uint32_t qCnt = QbbNetDevice::qCnt;
+
+	Time interval; // between two deadlock checks
+	Time deadlock_time;
+	Time storm_time;
+	double storm_ratio;
+	uint32_t stop;
+	FILE *fout;
+
+	uint32_t n_deadlock, n_storm;
+
+	PfcMonitor();
+	// follow the QbbPfc trace of all QbbNetDevices of n
+	void Install(NodeContainer &n);
+	void Start(Time t);
+
+private:
+	struct Port{
+		Ptr<QbbNetDevice> dev, peer_dev;
+		uint32_t node, intf, peer, peer_intf;
+		bool is_switch, peer_is_switch;
+		int64_t since[qCnt]; // when the queue was paused, -1 if not paused
+		int64_t paused_ns[qCnt]; // paused time in the current storm window, excluding the ongoing pause
+		bool storm[qCnt]; // in a pause storm in the last window
+	};
+	std::vector<Port> ports;
+	uint32_t n_node;
+	uint32_t n_paused; // number of paused queues
+	int64_t window_start;
+	std::set<std::vector<uint32_t> > reported; // deadlocks reported, as sorted port*qCnt+q
+
+	static void PfcEvent(PfcMonitor *m, uint32_t idx, uint32_t type);
+	void Check();
+	void CheckDeadlock(int64_t now);
+	void CheckStorm(int64_t now);
+	void PrintPort(const Port &p, uint32_t q, int64_t now);
+	void Detected(bool deadlock);
+};
+
+} /* namespace ns3 */
+
+#endif /* PFC_MONITOR_H */
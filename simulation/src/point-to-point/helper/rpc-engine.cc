@@ -0,0 +1,142 @@
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include "ns3/simulator.h"
+#include "rpc-engine.h"
+
+namespace ns3 {
+
+RpcEngine::RpcEngine() : fout(NULL), seed(1)
+{
+}
+
+std::string RpcEngine::Load(const char *file, const std::vector<uint32_t> &hosts){
+	std::ifstream f(file);
+	uint32_t num;
+	if (!(f >> num))
+		return std::string("cannot read ") + file;
+	std::unordered_map<uint32_t, uint32_t> id2idx;
+	for (uint32_t i = 0; i < num; i++){
+		std::string type, line = "line " + std::to_string(i + 2);
+		uint32_t src, dst;
+		f >> type;
+		if (type == "flow"){
+			uint32_t id, ndep;
+			double start, think;
+			Flow x;
+			if (!(f >> id >> x.src >> x.dst >> x.pg >> x.size >> start >> think >> ndep))
+				return line + ": bad flow";
+			if (id2idx.count(id))
+				return line + ": duplicate flow id " + std::to_string(id);
+			x.size = std::max(x.size, (uint64_t)1);
+			x.start = start * 1e9 + 0.5;
+			x.think = think * 1e3 + 0.5;
+			x.deps = 0;
+			x.begin = x.end = -1;
+			for (uint32_t k = 0; k < ndep; k++){
+				uint32_t d;
+				if (!(f >> d))
+					return line + ": bad flow";
+				if (!id2idx.count(d))
+					return line + ": flow " + std::to_string(d) + " is not defined before";
+				flow[id2idx[d]].next.push_back(flow.size());
+				x.deps++;
+			}
+			id2idx[id] = flow.size();
+			src = x.src;
+			dst = x.dst;
+			flow.push_back(x);
+		}else if (type == "rpc"){
+			double think, start;
+			Client c;
+			if (!(f >> c.src >> c.dst >> c.pg >> c.req >> c.resp >> c.outstanding >> think >> start >> c.count))
+				return line + ": bad rpc";
+			if (c.req == 0 || c.outstanding == 0)
+				return line + ": request size and outstanding must be > 0";
+			c.think = think * 1e3;
+			c.start = start * 1e9 + 0.5;
+			c.issued = c.done = 0;
+			std::seed_seq s{seed, (uint64_t)client.size()};
+			c.rng.seed(s);
+			src = c.src;
+			dst = c.dst;
+			client.push_back(c);
+		}else
+			return line + ": unknown type " + type;
+		if (src == dst || std::find(hosts.begin(), hosts.end(), src) == hosts.end() || std::find(hosts.begin(), hosts.end(), dst) == hosts.end())
+			return line + ": src and dst must be different hosts";
+	}
+	return "";
+}
+
+void RpcEngine::Start(){
+	for (uint32_t i = 0; i < flow.size(); i++)
+		if (flow[i].deps == 0)
+			Simulator::Schedule(NanoSeconds(flow[i].start) - Simulator::Now(), &RpcEngine::StartFlow, this, i);
+	for (uint32_t i = 0; i < client.size(); i++)
+		for (uint32_t k = 0; k < client[i].outstanding && (client[i].count == 0 || k < client[i].count); k++)
+			Simulator::Schedule(NanoSeconds(client[i].start) - Simulator::Now(), &RpcEngine::Issue, this, i);
+}
+
+void RpcEngine::StartFlow(uint32_t fi){
+	Flow &x = flow[fi];
+	x.begin = Simulator::Now().GetTimeStep();
+	startFlow(x.src, x.dst, x.pg, x.size, MakeCallback(&RpcEngine::FlowDone, this).Bind(fi));
+}
+
+void RpcEngine::FlowDone(uint32_t fi){
+	int64_t now = Simulator::Now().GetTimeStep();
+	flow[fi].end = now;
+	for (uint32_t k = 0; k < flow[fi].next.size(); k++){
+		uint32_t ni = flow[fi].next[k];
+		Flow &x = flow[ni];
+		if (--x.deps == 0)
+			Simulator::Schedule(NanoSeconds(std::max(x.start, now + x.think) - now), &RpcEngine::StartFlow, this, ni);
+	}
+}
+
+void RpcEngine::Issue(uint32_t ci){
+	Client &c = client[ci];
+	uint64_t seq = c.issued++;
+	Rpc &r = c.inflight[seq];
+	r.issue = Simulator::Now().GetTimeStep();
+	r.reqEnd = -1;
+	startFlow(c.src, c.dst, c.pg, c.req, MakeCallback(&RpcEngine::RequestDone, this).TwoBind(ci, seq));
+}
+
+void RpcEngine::RequestDone(uint32_t ci, uint64_t seq){
+	Client &c = client[ci];
+	c.inflight[seq].reqEnd = Simulator::Now().GetTimeStep();
+	if (c.resp > 0)
+		startFlow(c.dst, c.src, c.pg, c.resp, MakeCallback(&RpcEngine::ResponseDone, this).TwoBind(ci, seq));
+	else
+		ResponseDone(ci, seq);
+}
+
+void RpcEngine::ResponseDone(uint32_t ci, uint64_t seq){
+	Client &c = client[ci];
+	int64_t now = Simulator::Now().GetTimeStep();
+	Rpc r = c.inflight[seq];
+	c.inflight.erase(seq);
+	c.lat.push_back(now - r.issue);
+	c.done++;
+	// client seq src dst request response issue request_end end latency (ns)
+	if (fout)
+		fprintf(fout, "%u %lu %u %u %lu %lu %ld %ld %ld %ld\n", ci, seq, c.src, c.dst, c.req, c.resp, r.issue, r.reqEnd, now, now - r.issue);
+	if (c.count > 0 && c.issued >= c.count)
+		return;
+	if (c.think > 0){
+		double t = -log(1 - std::generate_canonical<double, 53>(c.rng)) * c.think;
+		Simulator::Schedule(NanoSeconds((int64_t)t), &RpcEngine::Issue, this, ci);
+	}else
+		Issue(ci);
+}
+
+int64_t RpcEngine::Percentile(const std::vector<int64_t> &lat, double p){
+	if (lat.empty())
+		return 0;
+	uint64_t i = std::min((uint64_t)(lat.size() * p / 100), (uint64_t)lat.size() - 1);
+	return lat[i];
+}
+
+} /* namespace ns3 */
@@ -0,0 +1,78 @@
+#ifndef RPC_ENGINE_H
+#define RPC_ENGINE_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <random>
+#include "ns3/callback.h"
+
+namespace ns3 {
+
+/*
+ * Closed-loop workloads, driven by flow completions instead of absolute start times.
+ * A dependent flow starts `think` after the last of the flows it depends on finishes (and not before its start).
+ * An RPC client keeps `outstanding` RPCs to one server: an RPC is a request flow, then a response flow back,
+ * and the client issues the next RPC an exponential think time (of mean `think`) after a response arrives.
+ * So the offered load follows how fast the fabric completes the flows.
+ * The user starts the flows through startFlow, and calls back `done` when a flow finishes.
+ */
+class RpcEngine{
+public:
+	struct Flow{
+		uint32_t src, dst, pg; // node ids
+		uint64_t size;
+		int64_t start; // ns
+		int64_t think; // ns after the last dependency finishes
+		uint32_t deps; // unfinished flows it waits for
+		std::vector<uint32_t> next;
+		int64_t begin, end; // ns, -1: not yet
+	};
+	struct Rpc{
+		int64_t issue, reqEnd; // ns
+	};
+	struct Client{
+		uint32_t src, dst, pg; // node ids, src is the client
+		uint64_t req, resp; // bytes, resp 0: no response
+		uint32_t outstanding;
+		double think; // mean, ns
+		int64_t start; // ns
+		uint64_t count; // RPCs to issue, 0: until the simulation stops
+		uint64_t issued, done;
+		std::unordered_map<uint64_t, Rpc> inflight; // by sequence number
+		std::vector<int64_t> lat; // ns, of the finished RPCs
+		std::mt19937_64 rng;
+	};
+	// src, dst, pg, size, done
+	typedef Callback<void, uint32_t, uint32_t, uint32_t, uint64_t, Callback<void> > StartFlowCallback;
+
+	StartFlowCallback startFlow;
+	FILE *fout; // one line per finished RPC, NULL: none
+	uint64_t seed;
+	std::vector<Flow> flow;
+	std::vector<Client> client;
+
+	RpcEngine();
+	// read a workload file: the number of entries, then one per line, either
+	// flow <id> <src> <dst> <pg> <size> <start s> <think us> <n deps> <dep id>...
+	// rpc <src> <dst> <pg> <request size> <response size> <outstanding> <think us> <start s> <count>
+	// src and dst are node ids of hosts; a flow depends on flows of earlier lines. Returns an error message, empty if OK
+	std::string Load(const char *file, const std::vector<uint32_t> &hosts);
+	// schedule the flows and clients; call before the simulation runs
+	void Start();
+	// the p-th percentile (0-100) of the latencies of a client; lat must be sorted
+	static int64_t Percentile(const std::vector<int64_t> &lat, double p);
+
+private:
+	void StartFlow(uint32_t fi);
+	void FlowDone(uint32_t fi);
+	void Issue(uint32_t ci);
+	void RequestDone(uint32_t ci, uint64_t seq);
+	void ResponseDone(uint32_t ci, uint64_t seq);
+};
+
+} /* namespace ns3 */
+
+#endif /* RPC_ENGINE_H */
@@ -0,0 +1,54 @@
+#include "flow-hash-tag.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (FlowHashTag);
+
+TypeId FlowHashTag::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::FlowHashTag")
+		.SetParent<Tag> ()
+		.AddConstructor<FlowHashTag> ()
+		;
+	return tid;
+}
+
+TypeId FlowHashTag::GetInstanceTypeId (void) const
+{
+	return GetTypeId ();
+}
+
+uint32_t FlowHashTag::GetSerializedSize (void) const
+{
+	return 4;
+}
+
+void FlowHashTag::Serialize (TagBuffer buf) const
+{
+	buf.WriteU32 (m_hash);
+}
+
+void FlowHashTag::Deserialize (TagBuffer buf)
+{
+	m_hash = buf.ReadU32 ();
+}
+
+void FlowHashTag::Print (std::ostream &os) const
+{
+	os << "FlowHash=" << m_hash;
+}
+
+FlowHashTag::FlowHashTag () : m_hash (0)
+{
+}
+
+FlowHashTag::FlowHashTag (uint32_t hash) : m_hash (hash)
+{
+}
+
+uint32_t FlowHashTag::GetHash (void) const
+{
+	return m_hash;
+}
+
+} /* namespace ns3 */
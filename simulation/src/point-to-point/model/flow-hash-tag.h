@@ -0,0 +1,31 @@
+#ifndef FLOW_HASH_TAG_H
+#define FLOW_HASH_TAG_H
+
+#include "ns3/tag.h"
+
+namespace ns3 {
+
+/*
+ * The hash of the (sip, dip, sport, dport) of a packet, computed once by the sender (the QP), so that the switches
+ * only mix it with their ECMP seed instead of hashing the header at every hop.
+ * Packets without it (e.g., CNPs and PFC frames) are hashed from their header.
+ */
+class FlowHashTag : public Tag{
+public:
+	static TypeId GetTypeId (void);
+	virtual TypeId GetInstanceTypeId (void) const;
+	virtual uint32_t GetSerializedSize (void) const;
+	virtual void Serialize (TagBuffer buf) const;
+	virtual void Deserialize (TagBuffer buf);
+	virtual void Print (std::ostream &os) const;
+	FlowHashTag ();
+	FlowHashTag (uint32_t hash);
+	uint32_t GetHash (void) const;
+
+private:
+	uint32_t m_hash;
+};
+
+} /* namespace ns3 */
+
+#endif /* FLOW_HASH_TAG_H */
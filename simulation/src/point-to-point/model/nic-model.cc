@@ -0,0 +1,75 @@
+#include "ns3/simulator.h"
+#include "nic-model.h"
+
+namespace ns3 {
+
+NicModel::NicModel() :
+	cacheSize(1024), hitTime(0), missTime(NanoSeconds(1000)), ctxSize(256), wqeSize(64), pcieRate("256Gb/s"),
+	pcieDelay(NanoSeconds(600)), rxBuffer(0), hits(0), misses(0), rdBytes(0), wrBytes(0), rxDrops(0), rxWait(0),
+	m_rdFree(0), m_wrFree(0), m_rxFree(0), m_rxQBytes(0)
+{
+}
+
+bool NicModel::Lookup(uint64_t key){
+	auto it = m_ctx.find(key);
+	if (it != m_ctx.end()){
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		hits++;
+		return true;
+	}
+	misses++;
+	if (m_ctx.size() >= cacheSize){
+		m_ctx.erase(m_lru.back());
+		m_lru.pop_back();
+	}
+	m_lru.push_front(key);
+	m_ctx[key] = m_lru.begin();
+	return false;
+}
+
+Time NicModel::Read(Time start, uint32_t bytes){
+	m_rdFree = Max(start, m_rdFree) + Seconds(pcieRate.CalculateTxTime(bytes));
+	rdBytes += bytes;
+	return m_rdFree;
+}
+
+Time NicModel::Doorbell(uint32_t bytes){
+	Time t = Read(Simulator::Now(), wqeSize) + pcieDelay;
+	return Read(t, bytes) + pcieDelay;
+}
+
+Time NicModel::Tx(uint64_t key, uint32_t bytes){
+	Time now = Simulator::Now();
+	if (Lookup(key))
+		return Max(Read(now, bytes), now + hitTime);
+	Time t = Read(now, ctxSize) + missTime;
+	return Read(t, bytes) + pcieDelay;
+}
+
+bool NicModel::Rx(uint64_t key, uint32_t size, uint32_t bytes, Time &t){
+	Time now = Simulator::Now();
+	while (!m_rxQ.empty() && m_rxQ.front().first <= now){
+		m_rxQBytes -= m_rxQ.front().second;
+		m_rxQ.pop_front();
+	}
+	if (rxBuffer > 0 && m_rxQBytes + size > rxBuffer){
+		rxDrops++;
+		return false;
+	}
+	m_rxFree = Max(now, m_rxFree);
+	if (Lookup(key))
+		m_rxFree += hitTime;
+	else {
+		Read(now, ctxSize);
+		m_rxFree += missTime;
+	}
+	m_wrFree = Max(m_rxFree, m_wrFree) + Seconds(pcieRate.CalculateTxTime(bytes));
+	wrBytes += bytes;
+	t = m_wrFree;
+	rxWait += t - now;
+	m_rxQ.push_back(std::make_pair(t, size));
+	m_rxQBytes += size;
+	return true;
+}
+
+} /* namespace ns3 */
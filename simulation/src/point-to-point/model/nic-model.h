@@ -0,0 +1,57 @@
+#ifndef NIC_MODEL_H
+#define NIC_MODEL_H
+
+#include <stdint.h>
+#include <deque>
+#include <list>
+#include <unordered_map>
+#include "ns3/nstime.h"
+#include "ns3/data-rate.h"
+
+namespace ns3 {
+
+/*
+ * Resources of one NIC: an LRU cache of QP contexts and the PCIe link to host memory.
+ * TX: a new qp rings the doorbell, then the NIC reads the WQE and the first payload, each after one PCIe
+ * latency. Later payloads are prefetched, so they only take PCIe read bandwidth, shared by all qps of the NIC.
+ * A context miss reads the context, and the payload after it, so the qp stalls for missTime + pcieDelay.
+ * RX: packets wait in the NIC buffer for one context lookup at a time (hitTime or missTime), then the payload
+ * is written over PCIe. A packet that does not fit in rxBuffer is dropped.
+ * Keys are the qp keys of RdmaHw, with bit 63 set for rx qps.
+ */
+class NicModel{
+public:
+	uint32_t cacheSize; // QP contexts in the cache
+	Time hitTime, missTime; // of a context lookup
+	uint32_t ctxSize, wqeSize; // bytes read over PCIe at a context miss, per WQE
+	DataRate pcieRate; // of each direction
+	Time pcieDelay; // of a PCIe read, from the request to the data
+	uint32_t rxBuffer; // bytes, 0: unlimited
+
+	uint64_t hits, misses;
+	uint64_t rdBytes, wrBytes; // over PCIe
+	uint64_t rxDrops;
+	Time rxWait; // total time packets wait in the NIC buffer
+
+	NicModel();
+	// a new qp with its first packet of bytes: when the packet may be sent
+	Time Doorbell(uint32_t bytes);
+	// a packet of bytes of the qp is sent: when its next packet may be sent
+	Time Tx(uint64_t key, uint32_t bytes);
+	// a packet of size (bytes written to the host) arrives: false if it is dropped, otherwise t is when it is processed
+	bool Rx(uint64_t key, uint32_t size, uint32_t bytes, Time &t);
+
+private:
+	bool Lookup(uint64_t key); // true on a hit; the key becomes the most recent
+	Time Read(Time start, uint32_t bytes); // when the read leaves the PCIe link, without the latency
+
+	std::list<uint64_t> m_lru; // most recent first
+	std::unordered_map<uint64_t, std::list<uint64_t>::iterator> m_ctx;
+	Time m_rdFree, m_wrFree, m_rxFree; // when the PCIe directions and the rx lookup are free
+	std::deque<std::pair<Time, uint32_t> > m_rxQ; // packets in the NIC buffer: (processed time, size)
+	uint64_t m_rxQBytes;
+};
+
+} /* namespace ns3 */
+
+#endif /* NIC_MODEL_H */
@@ -12,12 +12,12 @@ namespace ns3 {
 	NS_OBJECT_ENSURE_REGISTERED(qbbHeader);
 
 	qbbHeader::qbbHeader(uint16_t pg)
-		: m_pg(pg), sport(0), dport(0), flags(0), m_seq(0)
+		: m_pg(pg), sport(0), dport(0), flags(0), m_seq(0), m_sackBegin(0), m_sackEnd(0)
 	{
 	}
 
 	qbbHeader::qbbHeader()
-		: m_pg(0), sport(0), dport(0), flags(0), m_seq(0)
+		: m_pg(0), sport(0), dport(0), flags(0), m_seq(0), m_sackBegin(0), m_sackEnd(0)
 	{}
 
 	qbbHeader::~qbbHeader()
@@ -48,8 +48,14 @@ namespace ns3 {
 		//如果 FLAG_CNP 的值是 2，那么 1 << 2 产生的结果是 00000100，也就是在第三位设置为 1
 		flags |= 1 << FLAG_CNP;
 	}
+	void qbbHeader::SetSack(uint32_t begin, uint32_t end){
+		flags |= 1 << FLAG_SACK;
+		m_sackBegin = begin;
+		m_sackEnd = end;
+	}
 	void qbbHeader::SetIntHeader(const IntHeader &_ih){
 		ih = _ih;
+		ih.Trim();
 	}
 
 	uint16_t qbbHeader::GetPG() const
@@ -77,6 +83,15 @@ namespace ns3 {
 	uint8_t qbbHeader::GetCnp() const{
 		return (flags >> FLAG_CNP) & 1;
 	}
+	uint8_t qbbHeader::GetSack() const{
+		return (flags >> FLAG_SACK) & 1;
+	}
+	uint32_t qbbHeader::GetSackBegin() const{
+		return m_sackBegin;
+	}
+	uint32_t qbbHeader::GetSackEnd() const{
+		return m_sackEnd;
+	}
 
 	TypeId
 		qbbHeader::GetTypeId(void)
@@ -98,7 +113,7 @@ namespace ns3 {
 	}
 	uint32_t qbbHeader::GetSerializedSize(void)  const
 	{
-		return GetBaseSize() + IntHeader::GetStaticSize();
+		return GetBaseSize() + (GetSack() ? 8 : 0) + ih.GetSerializedSize();
 	}
 	uint32_t qbbHeader::GetBaseSize() {
 		qbbHeader tmp;
@@ -112,6 +127,10 @@ namespace ns3 {
 		i.WriteU16(flags);
 		i.WriteU16(m_pg);
 		i.WriteU32(m_seq);
+		if (GetSack()){
+			i.WriteU32(m_sackBegin);
+			i.WriteU32(m_sackEnd);
+		}
 
 		// write IntHeader
 		ih.Serialize(i);
@@ -125,6 +144,10 @@ namespace ns3 {
 		flags = i.ReadU16();
 		m_pg = i.ReadU16();
 		m_seq = i.ReadU32();
+		if (GetSack()){
+			m_sackBegin = i.ReadU32();
+			m_sackEnd = i.ReadU32();
+		}
 
 		// read IntHeader
 		ih.Deserialize(i);
@@ -25,7 +25,8 @@ class qbbHeader : public Header
 public:
  
   enum {
-	  FLAG_CNP = 0
+	  FLAG_CNP = 0,
+	  FLAG_SACK = 1 // selective repeat: the receiver has [sackBegin, sackEnd), which follows the seq
   };
   qbbHeader (uint16_t pg);
   qbbHeader ();
@@ -41,6 +42,7 @@ public:
   void SetDport(uint32_t _dport);
   void SetTs(uint64_t ts);
   void SetCnp();
+  void SetSack(uint32_t begin, uint32_t end);
   void SetIntHeader(const IntHeader &_ih);
 
 //Getters
@@ -54,6 +56,9 @@ public:
   uint16_t GetDport() const;
   uint64_t GetTs() const;
   uint8_t GetCnp() const;
+  uint8_t GetSack() const;
+  uint32_t GetSackBegin() const;
+  uint32_t GetSackEnd() const;
 
   static TypeId GetTypeId (void);
   virtual TypeId GetInstanceTypeId (void) const;
@@ -68,6 +73,7 @@ private:
   uint16_t flags;   // flags当中有一位表示cnp
   uint16_t m_pg;
   uint32_t m_seq; // the qbb sequence number.
+  uint32_t m_sackBegin, m_sackEnd;
   IntHeader ih;
   
 };
@@ -70,6 +70,8 @@ namespace ns3 {
 	RdmaEgressQueue::RdmaEgressQueue(){
 		m_rrlast = 0;
 		m_qlast = 0;
+		for (uint32_t i = 0; i < qCnt; i++)
+			m_pgLast[i] = 0;
 		m_ackQ = CreateObject<DropTailQueue>();
 		m_ackQ->SetAttribute("MaxBytes", UintegerValue(0xffffffff)); // queue limit is on a higher level, not here
 	}
@@ -85,6 +87,8 @@ namespace ns3 {
 			//???  具体是怎么做的呢,好像并没有数据包出队列
 			//  答案可能在rdma-hw.cc中
 			Ptr<Packet> p = m_rdmaGetNxtPkt(m_qpGrp->Get(qIndex));
+			if (m_pgSched.IsEnabled())
+				m_pgSched.Charge(m_qpGrp->Get(qIndex)->m_pg, p->GetSize());
 
 			m_rrlast = qIndex;
 			m_qlast = qIndex;
@@ -107,7 +111,44 @@ namespace ns3 {
 		int res = -1024;
 		uint32_t fcount = m_qpGrp->GetN(); // number of qp
 		uint32_t min_finish_id = 0xffffffff;
-		for (qIndex = 1; qIndex <= fcount; qIndex++){
+		// with PG weights, let DWRR pick a PG, and only scan the qps of that PG
+		bool weighted = m_pgSched.IsEnabled();
+		if (weighted){
+			uint32_t pgCand = 0;
+			for (uint32_t pg = 0; pg < qCnt; pg++){
+				if (pg < m_qpGrp->m_pgQps.size() && !m_qpGrp->m_pgQps[pg].empty()){
+					if (!paused[pg])
+						pgCand |= 1u << pg;
+				}else
+					m_pgSched.Reset(pg);
+			}
+			while (pgCand && res < 0){
+				uint32_t pg = m_pgSched.Select(pgCand);
+				std::vector<uint32_t> &v = m_qpGrp->m_pgQps[pg];
+				bool hasData = false;
+				for (uint32_t i = 1; i <= v.size(); i++){
+					uint32_t j = (m_pgLast[pg] + i) % v.size();
+					Ptr<RdmaQueuePair> qp = m_qpGrp->Get(v[j]);
+					hasData |= qp->GetBytesLeft() > 0;
+					if (qp->GetBytesLeft() > 0 && !qp->IsWinBound()){
+						if (qp->m_nextAvail.GetTimeStep() > Simulator::Now().GetTimeStep())
+							continue;
+						res = v[j];
+						m_pgLast[pg] = j;
+						break;
+					}else if (qp->IsFinished())
+						min_finish_id = v[j] < min_finish_id ? v[j] : min_finish_id;
+				}
+				// nothing to send in this PG now; only a PG without data loses its deficit (as an empty queue in DRR),
+				// a paced or window-bound one keeps it
+				if (res < 0){
+					if (!hasData)
+						m_pgSched.Reset(pg);
+					pgCand &= ~(1u << pg);
+				}
+			}
+		}
+		for (qIndex = 1; !weighted && qIndex <= fcount; qIndex++){
 			uint32_t idx = (qIndex + m_rrlast) % fcount;
 			Ptr<RdmaQueuePair> qp = m_qpGrp->Get(idx);
 			// 对每个队列进行检查：
@@ -139,10 +180,16 @@ namespace ns3 {
 			}
 			qps.resize(nxt);    /// resize 会保留nxt个元素，后面的元素会被删除  
 			//  刚好nxt++,多一个，数组从0开始，队列从1开始计数
+			m_qpGrp->UpdatePgQps();
 		}
 		return res;
 	}
 
+	void RdmaEgressQueue::SetPgWeight(uint32_t pg, uint32_t weight){
+		NS_ASSERT_MSG(pg < qCnt, "RdmaEgressQueue::SetPgWeight: pg >= qCnt");
+		m_pgSched.SetWeight(pg, weight);
+	}
+
 	int RdmaEgressQueue::GetLastQueue(){
 		return m_qlast;
 	}
@@ -412,11 +459,11 @@ namespace ns3 {
 			if (!m_qbbEnabled) return;
 			unsigned qIndex = ch.pfc.qIndex;
 			if (ch.pfc.time > 0){    // PFC Pause
-				m_tracePfc(1);
 				m_paused[qIndex] = true;
+				m_tracePfc(1);
 			}else{		// PFC Resume  PFC 恢复帧
-				m_tracePfc(0);
 				Resume(qIndex);
+				m_tracePfc(0);
 			}
 		}else { // non-PFC packets (data, ACK, NACK, CNP...)
 
@@ -542,6 +589,10 @@ namespace ns3 {
 	   DequeueAndTransmit();
    }
 
+   bool QbbNetDevice::IsPaused(uint32_t qIndex) const{
+	   return m_paused[qIndex];
+   }
+
 	void QbbNetDevice::SetQueue(Ptr<BEgressQueue> q){
 		NS_LOG_FUNCTION(this << q);
 		m_queue = q;
@@ -569,9 +620,13 @@ namespace ns3 {
 			// notify driver/RdmaHw that this link is down
 			m_rdmaLinkDownCb(this);
 		}else { // switch
-			// clean the queue
-			for (uint32_t i = 0; i < qCnt; i++)
-				m_paused[i] = false;
+			// clean the queue; a paused queue is resumed, and the PFC traces (e.g., PfcMonitor) see the resume
+			for (uint32_t i = 0; i < qCnt; i++){
+				if (m_paused[i]){
+					m_paused[i] = false;
+					m_tracePfc(0);
+				}
+			}
 			while (1){
 				Ptr<Packet> p = m_queue->DequeueRR(m_paused);
 				if (p == 0)
@@ -50,6 +50,8 @@ public:
   Ptr<DropTailQueue> m_ackQ; // highest priority queue
   //指向队列对（Queue Pair）组的指针
 	Ptr<RdmaQueuePairGroup> m_qpGrp; // queue pairs
+	DwrrScheduler m_pgSched; // shares the bandwidth among PGs if they have weights, otherwise round robin among QPs
+	uint32_t m_pgLast[qCnt]; // with PG weights, round robin among the QPs of each PG: the position in m_qpGrp->m_pgQps of the last QP picked
 
 	// callback for get next packet
   // Callback<Ptr<Packet>, Ptr<RdmaQueuePair>> 是一个模板类，它表示一个可以被调用的回调函数类型，该类型的回调函数接受一个 Ptr<RdmaQueuePair> 参数，并返回一个 Ptr<Packet>
@@ -62,6 +64,7 @@ public:
 	Ptr<Packet> DequeueQindex(int qIndex);  
   // 根据队列状态（可能是某些队列暂停）选择下一个应该被处理的队列的索引
 	int GetNextQindex(bool paused[]);
+	void SetPgWeight(uint32_t pg, uint32_t weight);
 
 	int GetLastQueue();  //获取上一次处理的队列索引
 
@@ -143,13 +146,14 @@ public:
    void NewQp(Ptr<RdmaQueuePair> qp);
    void ReassignedQp(Ptr<RdmaQueuePair> qp); ///重新分配qp
    void TriggerTransmit(void);
+   bool IsPaused(uint32_t qIndex) const; // whether the egress queue is paused by the peer's PFC
 
 	void SendPfc(uint32_t qIndex, uint32_t type); // type: 0 = pause, 1 = resume
 
 	TracedCallback<Ptr<const Packet>, uint32_t> m_traceEnqueue; // 入队
 	TracedCallback<Ptr<const Packet>, uint32_t> m_traceDequeue; //出队
 	TracedCallback<Ptr<const Packet>, uint32_t> m_traceDrop;  //丢弃
-	TracedCallback<uint32_t> m_tracePfc; // 0: resume, 1: pause
+	TracedCallback<uint32_t> m_tracePfc; // 0: resume, 1: pause; fired after the pause state is updated
 protected:
 
 	//Ptr<Node> m_node;
@@ -73,8 +73,8 @@ void RdmaDriver::SetRdmaHw(Ptr<RdmaHw> rdma){
 	m_rdma = rdma;
 }
 
-void RdmaDriver::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint32_t win, uint64_t baseRtt, Callback<void> notifyAppFinish){
-	m_rdma->AddQueuePair(size, pg, sip, dip, sport, dport, win, baseRtt, notifyAppFinish);
+void RdmaDriver::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint32_t win, uint64_t baseRtt, uint32_t rail, uint16_t tenant, Callback<void> notifyAppFinish){
+	m_rdma->AddQueuePair(size, pg, sip, dip, sport, dport, win, baseRtt, rail, tenant, notifyAppFinish);
 }
 
 void RdmaDriver::QpComplete(Ptr<RdmaQueuePair> q){
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ns3/simulator.h>
 #include <ns3/seq-ts-header.h>
 #include <ns3/udp-header.h>
@@ -12,6 +13,8 @@
 #include "ppp-header.h"
 #include "qbb-header.h"
 #include "cn-header.h"
+#include "tenant-tag.h"
+#include "flow-hash-tag.h"
 
 namespace ns3{   ///各种基础属性
 
@@ -54,6 +57,91 @@ TypeId RdmaHw::GetTypeId (void)
 				BooleanValue(false),
 				MakeBooleanAccessor(&RdmaHw::m_backto0),
 				MakeBooleanChecker())
+		.AddAttribute("L2SelectiveRepeat",
+				"Layer 2 selective repeat instead of go-back-N.",
+				BooleanValue(false),
+				MakeBooleanAccessor(&RdmaHw::m_selectiveRepeat),
+				MakeBooleanChecker())
+		.AddAttribute("AckCoalesceCount",
+				"Send one ACK for this many in-order data packets. 0 or 1: no limit by count",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_ackCoalesceCount),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("AckCoalesceTime",
+				"Max delay (ns) of a coalesced ACK. 0: no ACK coalescing unless AckCoalesceCount > 1",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_ackCoalesceTime),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("AckCoalesceMaxQlen",
+				"A coalesced ACK carries the max qlen of each hop over its packets, instead of the latest",
+				BooleanValue(true),
+				MakeBooleanAccessor(&RdmaHw::m_ackCoalesceMaxQlen),
+				MakeBooleanChecker())
+		.AddAttribute("SprayPaths",
+				"Spray the packets of each QP round robin over this many paths. 1: no spraying",
+				UintegerValue(1),
+				MakeUintegerAccessor(&RdmaHw::m_sprayPaths),
+				MakeUintegerChecker<uint32_t>(1, 65535))
+		.AddAttribute("ReorderBufferSize",
+				"Out-of-order packets the go-back-N receiver keeps before it NACKs. 0: NACK at once",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_reorderBufSize),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("ReorderTimeout",
+				"How long (ns) a hole in the reorder buffer may stay open before the NACK",
+				UintegerValue(10000),
+				MakeUintegerAccessor(&RdmaHw::m_reorderTimeout),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("RailPolicy",
+				"How a qp without a given rail picks the NIC of a multi-NIC host. 0: flow hash, 1: least loaded",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_railPolicy),
+				MakeUintegerChecker<uint32_t>(0, 1))
+		.AddAttribute("NicModel",
+				"Model the QP context cache and the PCIe link of each NIC",
+				BooleanValue(false),
+				MakeBooleanAccessor(&RdmaHw::m_nicModel),
+				MakeBooleanChecker())
+		.AddAttribute("QpcCacheSize",
+				"QP contexts cached in a NIC",
+				UintegerValue(1024),
+				MakeUintegerAccessor(&RdmaHw::m_qpcCacheSize),
+				MakeUintegerChecker<uint32_t>(1))
+		.AddAttribute("QpcHitLatency",
+				"Latency (ns) of a QP context lookup that hits the cache",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_qpcHitTime),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("QpcMissLatency",
+				"Latency (ns) of a QP context lookup that misses the cache",
+				UintegerValue(1000),
+				MakeUintegerAccessor(&RdmaHw::m_qpcMissTime),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("QpcSize",
+				"Bytes of a QP context, read over PCIe at a miss",
+				UintegerValue(256),
+				MakeUintegerAccessor(&RdmaHw::m_qpcSize),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("WqeSize",
+				"Bytes of a WQE, read over PCIe when a qp starts",
+				UintegerValue(64),
+				MakeUintegerAccessor(&RdmaHw::m_wqeSize),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("PcieBandwidth",
+				"PCIe bandwidth of a NIC in each direction",
+				DataRateValue(DataRate("256Gb/s")),
+				MakeDataRateAccessor(&RdmaHw::m_pcieRate),
+				MakeDataRateChecker())
+		.AddAttribute("PcieLatency",
+				"Latency (ns) of a PCIe read",
+				UintegerValue(600),
+				MakeUintegerAccessor(&RdmaHw::m_pcieDelay),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("NicRxBuffer",
+				"Bytes of packets a NIC can hold before the rx pipeline. 0: unlimited",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_nicRxBuffer),
+				MakeUintegerChecker<uint32_t>())
 		.AddAttribute("EwmaGain",
 				"Control gain parameter which determines the level of rate decrease",
 				DoubleValue(1.0 / 16),
@@ -139,6 +227,11 @@ TypeId RdmaHw::GetTypeId (void)
 				BooleanValue(false),
 				MakeBooleanAccessor(&RdmaHw::m_sampleFeedback),
 				MakeBooleanChecker())
+		.AddAttribute("AdaptiveRouting",
+				"Whether the switches may move a flow to another port, see UpdateRateHp",
+				BooleanValue(false),
+				MakeBooleanAccessor(&RdmaHw::m_adaptiveRouting),
+				MakeBooleanChecker())
 		.AddAttribute("TimelyAlpha",
 				"Alpha of TIMELY",
 				DoubleValue(0.875),
@@ -174,11 +267,33 @@ TypeId RdmaHw::GetTypeId (void)
 				UintegerValue(65536),
 				MakeUintegerAccessor(&RdmaHw::pint_smpl_thresh),
 				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("FluidThreshold",
+				"Min flow size (bytes) to be sent in chunks when its rate is stable. 0 disables the hybrid fluid mode",
+				UintegerValue(0),
+				MakeUintegerAccessor(&RdmaHw::m_fluidThreshold),
+				MakeUintegerChecker<uint64_t>())
+		.AddAttribute("FluidChunk",
+				"Number of MTUs in a chunk of the hybrid fluid mode",
+				UintegerValue(16),
+				MakeUintegerAccessor(&RdmaHw::m_fluidChunk),
+				MakeUintegerChecker<uint32_t>(1))
+		.AddAttribute("FluidStableCount",
+				"Number of packets with a stable rate before a flow is sent in chunks",
+				UintegerValue(64),
+				MakeUintegerAccessor(&RdmaHw::m_fluidStable),
+				MakeUintegerChecker<uint32_t>())
+		.AddAttribute("FluidTolerance",
+				"Relative rate change that ends a stable phase",
+				DoubleValue(0.05),
+				MakeDoubleAccessor(&RdmaHw::m_fluidTolerance),
+				MakeDoubleChecker<double>(0))
 		;
 	return tid;
 }
 
 RdmaHw::RdmaHw(){
+	m_retxPkts = m_retxBytes = 0;
+	m_reorderPkts = m_reorderNacks = 0;
 }
 
 void RdmaHw::SetNode(Ptr<Node> node){
@@ -194,25 +309,62 @@ void RdmaHw::Setup(QpCompleteCallback cb){  //初始化 RDMA 硬件与网络设
 		dev->m_rdmaEQ->m_qpGrp = m_nic[i].qpGrp;
 		// setup callback
 		//                                   本质就是让两个函数相等，    this只的是rdmaHW对象
-		dev->m_rdmaReceiveCb = MakeCallback(&RdmaHw::Receive, this);
+		if (m_nicModel){
+			NicModel &m = m_nic[i].model;
+			m.cacheSize = m_qpcCacheSize;
+			m.hitTime = NanoSeconds(m_qpcHitTime);
+			m.missTime = NanoSeconds(m_qpcMissTime);
+			m.ctxSize = m_qpcSize;
+			m.wqeSize = m_wqeSize;
+			m.pcieRate = m_pcieRate;
+			m.pcieDelay = NanoSeconds(m_pcieDelay);
+			m.rxBuffer = m_nicRxBuffer;
+			dev->m_rdmaReceiveCb = MakeCallback(&RdmaHw::ReceiveNic, this).Bind(i);
+		}else
+			dev->m_rdmaReceiveCb = MakeCallback(&RdmaHw::Receive, this);
 		dev->m_rdmaLinkDownCb = MakeCallback(&RdmaHw::SetLinkDown, this);
 		dev->m_rdmaPktSent = MakeCallback(&RdmaHw::PktSent, this);  //
 		// config NIC
 		dev->m_rdmaEQ->m_rdmaGetNxtPkt = MakeCallback(&RdmaHw::GetNxtPacket, this); //下一次发送的数据包
+		if (m_fluidThreshold > 0)
+			dev->TraceConnectWithoutContext("QbbPfc", MakeCallback(&RdmaHw::PfcNotify, this));
 	}
+	// a coalesced ACK must not wait for packets that never come, e.g., after the last packet of a flow
+	NS_ASSERT_MSG(m_ackCoalesceCount <= 1 || m_ackCoalesceTime > 0, "AckCoalesceCount needs AckCoalesceTime > 0");
+	// the IPv4 payload length is 16 bits
+	NS_ASSERT_MSG(m_fluidThreshold == 0 || (uint64_t)m_fluidChunk * m_mtu < 60000, "FluidChunk * Mtu must be < 60000");
+	// the reorder buffer keeps one MTU per slot, while a fluid chunk is FluidChunk MTUs
+	NS_ASSERT_MSG(m_fluidThreshold == 0 || m_reorderBufSize == 0, "FluidThreshold and ReorderBufferSize cannot both be enabled");
 	// setup qp complete callback  
 	// typedef Callback<void, Ptr<RdmaQueuePair> > QpCompleteCallback;
 	m_qpCompleteCallback = cb;   
+}
 
 uint32_t RdmaHw::GetNicIdxOfQp(Ptr<RdmaQueuePair> qp){
 	//std::unordered_map<uint32_t, std::vector<int> > m_rtTable; 
 	auto &v = m_rtTable[qp->dip.Get()];
 	if (v.size() > 0){
+		if (qp->m_rail > 0 && std::find(v.begin(), v.end(), (int)qp->m_rail) != v.end())
+			return qp->m_rail;
 		return v[qp->GetHash() % v.size()];
 	}else{
 		NS_ASSERT_MSG(false, "We assume at least one NIC is alive");
 	}
 }
+uint32_t RdmaHw::GetNicIdxOfRail(uint32_t rail){
+	for (uint32_t i = 0; i < m_nic.size(); i++)
+		if (m_nic[i].dev != NULL && --rail == 0)
+			return i;
+	NS_ASSERT_MSG(false, "RdmaHw::GetNicIdxOfRail: no such rail");
+	return 0;
+}
+uint32_t RdmaHw::GetNRails(){
+	uint32_t n = 0;
+	for (uint32_t i = 0; i < m_nic.size(); i++)
+		if (m_nic[i].dev != NULL)
+			n++;
+	return n;
+}
 uint64_t RdmaHw::GetQpKey(uint32_t dip, uint16_t sport, uint16_t pg){
 	return ((uint64_t)dip << 32) | ((uint64_t)sport << 16) | (uint64_t)pg;
 }
@@ -224,7 +376,7 @@ Ptr<RdmaQueuePair> RdmaHw::GetQp(uint32_t dip, uint16_t sport, uint16_t pg){
 		return it->second;
 	return NULL;
 }
-void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint32_t win, uint64_t baseRtt, Callback<void> notifyAppFinish){
+void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Address dip, uint16_t sport, uint16_t dport, uint32_t win, uint64_t baseRtt, uint32_t rail, uint16_t tenant, Callback<void> notifyAppFinish){
 	// create qp
 	Ptr<RdmaQueuePair> qp = CreateObject<RdmaQueuePair>(pg, sip, dip, sport, dport);
 	qp->SetSize(size);
@@ -232,10 +384,22 @@ void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Addre
 	qp->SetBaseRtt(baseRtt);
 	qp->SetVarWin(m_var_win);
 	qp->SetAppNotifyCallback(notifyAppFinish);
+	qp->m_tenant = tenant;
 
 	// add qp
+	if (rail > 0)
+		qp->m_rail = GetNicIdxOfRail(rail);
+	else if (m_railPolicy == 1){
+		// the least loaded NIC, ties broken from the hash so that idle hosts spread like the hash policy
+		auto &v = m_rtTable[dip.Get()];
+		NS_ASSERT_MSG(v.size() > 0, "We assume at least one NIC is alive");
+		for (uint32_t i = 0, j = qp->GetHash() % v.size(); i < v.size(); i++, j = (j + 1) % v.size())
+			if (qp->m_rail == 0 || m_nic[v[j]].load < m_nic[qp->m_rail].load)
+				qp->m_rail = v[j];
+	}
 	uint32_t nic_idx = GetNicIdxOfQp(qp); ///找端口转发的网卡
 	m_nic[nic_idx].qpGrp->AddQp(qp);
+	m_nic[nic_idx].load += size;
 	uint64_t key = GetQpKey(dip.Get(), sport, pg); // 找新qp的存放数组索引 
 	//std::unordered_map<uint64_t, Ptr<RdmaQueuePair> > m_qpMap; 
 	m_qpMap[key] = qp;
@@ -262,7 +426,7 @@ void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Addre
 		if (m_multipleRate){
 			//maxHop = 5;
 			for (uint32_t i = 0; i < IntHeader::maxHop; i++)
-				qp->hp.hopState[i].Rc = m_bps;
+				qp->hp.hopRc[i] = m_bps.GetBitRate();
 		}
 	}else if (m_cc_mode == 7){ //timely
 		qp->tmly.m_curRate = m_bps;
@@ -270,6 +434,9 @@ void RdmaHw::AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address sip, Ipv4Addre
 		qp->hpccPint.m_curRate = m_bps;
 	}
 
+	if (m_nicModel)
+		qp->m_nextAvail = m_nic[nic_idx].model.Doorbell(std::min(size, (uint64_t)m_mtu));
+
 	// Notify Nic
 	m_nic[nic_idx].dev->NewQp(qp);
 }
@@ -307,7 +474,7 @@ Ptr<RdmaRxQueuePair> RdmaHw::GetRxQp(uint32_t sip, uint32_t dip, uint16_t sport,
 
 		// ECNAccount() { memset(this, 0, sizeof(ECNAccount));}
 		// };
-		ECNAccount m_ecn_source;
+		// ECNAccount m_ecn_source;
 		q->m_ecn_source.qIndex = pg;  //   pg 应该就是队列索引的意思
 		// store in map
 		m_rxQpMap[key] = q;
@@ -326,7 +493,12 @@ uint32_t RdmaHw::GetNicIdxOfRxQp(Ptr<RdmaRxQueuePair> q){
 }
 void RdmaHw::DeleteRxQp(uint32_t dip, uint16_t pg, uint16_t dport){  
 	uint64_t key = ((uint64_t)dip << 32) | ((uint64_t)pg << 16) | (uint64_t)dport;
-	m_rxQpMap.erase(key);
+	auto it = m_rxQpMap.find(key);
+	if (it == m_rxQpMap.end())
+		return;
+	Simulator::Cancel(it->second->m_ackAgg.timer);
+	Simulator::Cancel(it->second->m_rob.timer);
+	m_rxQpMap.erase(it);
 }
 
 int RdmaHw::ReceiveUdp(Ptr<Packet> p, CustomHeader &ch){
@@ -349,41 +521,101 @@ int RdmaHw::ReceiveUdp(Ptr<Packet> p, CustomHeader &ch){
 	}
 	rxQp->m_ecn_source.total++;
 	rxQp->m_milestone_rx = m_ack_interval;
+	TenantTag tt;
+	if (p->PeekPacketTag(tt))
+		rxQp->m_tenant = tt.GetTenant();
 
 	int x = ReceiverCheckSeq(ch.udp.seq, rxQp, payload_size);
-	if (x == 1 || x == 2){ //generate ACK or NACK
-		qbbHeader seqh;
-		seqh.SetSeq(rxQp->ReceiverNextExpectedSeq);
-		seqh.SetPG(ch.udp.pg);
-		seqh.SetSport(ch.udp.dport);
-		seqh.SetDport(ch.udp.sport);
-		seqh.SetIntHeader(ch.udp.ih);
-		if (ecnbits)
-			seqh.SetCnp();
-		//    ??继续深究  60字节指的是什么
-		//  7字节前导同步吗＋1字节帧开始定界符＋6字节的目的MAC＋6字节的源MAC＋2字节的帧类型＋1500＋4字节的FCS
-		//   原因是当数据帧到达网卡时，在物理层上网卡要先去掉前导同步码和帧开始定界符，然后对帧进行CRC检验，如果帧校验和错，就丢弃此帧
-		//以太网规定，以太网帧数据域部分最小为46字节，也就是以太网帧最小是6＋6＋2＋46＋4＝64。除去4个字节的FCS，因此，抓包时就是60字节。
-		Ptr<Packet> newp = Create<Packet>(std::max(60-14-20-(int)seqh.GetSerializedSize(), 0));
-		newp->AddHeader(seqh);
-
-		Ipv4Header head;	// Prepare IPv4 header
-		head.SetDestination(Ipv4Address(ch.sip));
-		head.SetSource(Ipv4Address(ch.dip));
-		head.SetProtocol(x == 1 ? 0xFC : 0xFD); //ack=0xFC nack=0xFD
-		head.SetTtl(64);
-		head.SetPayloadSize(newp->GetSize());
-		head.SetIdentification(rxQp->m_ipid++);
-
-		newp->AddHeader(head);
-		AddHeader(newp, 0x800);	// Attach PPP header
-		// send
-		uint32_t nic_idx = GetNicIdxOfRxQp(rxQp);
-		m_nic[nic_idx].dev->RdmaEnqueueHighPrioQ(newp);
-		m_nic[nic_idx].dev->TriggerTransmit();
+	if (x == 7){ // in the reorder buffer, the NACK at the timeout echoes this packet
+		rxQp->m_rob.pg = ch.udp.pg;
+		rxQp->m_rob.path = ch.ipid;
+		rxQp->m_rob.ih = ch.udp.ih;
+	}
+	if (x == 1 && (m_ackCoalesceCount > 1 || m_ackCoalesceTime > 0)){
+		CoalesceAck(rxQp, ch.udp.pg, ch.udp.ih, ch.ipid, ecnbits);
+	}else if (x == 1 || x == 2 || x == 6){ //generate ACK or NACK
+		// the ACK or NACK also covers the coalesced packets
+		auto &agg = rxQp->m_ackAgg;
+		if (agg.n > 0){
+			ecnbits |= agg.ecnbits;
+			agg.n = 0;
+			agg.ecnbits = 0;
+			Simulator::Cancel(agg.timer);
+		}
+		SendAck(rxQp, x == 2, ch.udp.pg, ch.udp.ih, ch.ipid, ecnbits, (x == 2 && m_selectiveRepeat) || x == 6, ch.udp.seq, ch.udp.seq + payload_size);
 	}
 	return 0;
 }
+void RdmaHw::SendAck(Ptr<RdmaRxQueuePair> q, bool nack, uint16_t pg, const IntHeader &ih, uint16_t path, uint8_t ecnbits, bool sack, uint32_t sackBegin, uint32_t sackEnd){
+	qbbHeader seqh;
+	seqh.SetSeq(q->ReceiverNextExpectedSeq);
+	seqh.SetPG(pg);
+	seqh.SetSport(q->sport);
+	seqh.SetDport(q->dport);
+	seqh.SetIntHeader(ih);
+	if (ecnbits)
+		seqh.SetCnp();
+	if (sack)
+		seqh.SetSack(sackBegin, sackEnd);
+	//    ??继续深究  60字节指的是什么
+	//  7字节前导同步吗＋1字节帧开始定界符＋6字节的目的MAC＋6字节的源MAC＋2字节的帧类型＋1500＋4字节的FCS
+	//   原因是当数据帧到达网卡时，在物理层上网卡要先去掉前导同步码和帧开始定界符，然后对帧进行CRC检验，如果帧校验和错，就丢弃此帧
+	//以太网规定，以太网帧数据域部分最小为46字节，也就是以太网帧最小是6＋6＋2＋46＋4＝64。除去4个字节的FCS，因此，抓包时就是60字节。
+	Ptr<Packet> newp = Create<Packet>(std::max(60-14-20-(int)seqh.GetSerializedSize(), 0));
+	newp->AddHeader(seqh);
+
+	Ipv4Header head;	// Prepare IPv4 header
+	head.SetDestination(Ipv4Address(q->dip));
+	head.SetSource(Ipv4Address(q->sip));
+	head.SetProtocol(nack ? 0xFD : 0xFC); //ack=0xFC nack=0xFD
+	head.SetTtl(64);
+	head.SetPayloadSize(newp->GetSize());
+	// with spraying, echo the path of the data packet, whose INT this ACK carries
+	head.SetIdentification(m_sprayPaths > 1 ? path : q->m_ipid++);
+
+	newp->AddHeader(head);
+	AddHeader(newp, 0x800);	// Attach PPP header
+	if (q->m_tenant > 0)
+		newp->AddPacketTag(TenantTag(q->m_tenant));
+	newp->AddPacketTag(FlowHashTag(q->GetHash()));
+	// send
+	uint32_t nic_idx = GetNicIdxOfRxQp(q);
+	m_nic[nic_idx].dev->RdmaEnqueueHighPrioQ(newp);
+	m_nic[nic_idx].dev->TriggerTransmit();
+}
+
+void RdmaHw::CoalesceAck(Ptr<RdmaRxQueuePair> q, uint16_t pg, const IntHeader &ih, uint16_t path, uint8_t ecnbits){
+	auto &agg = q->m_ackAgg;
+	if (agg.n == 0 || !m_ackCoalesceMaxQlen || IntHeader::mode != IntHeader::NORMAL || agg.ih.nhop != ih.nhop || agg.path != path){
+		agg.ih = ih;
+	}else {
+		// the latest time and bytes of each hop, with the max qlen
+		for (uint32_t i = 0; i < ih.nhop; i++){
+			uint32_t qlen = std::max(agg.ih.hop[i].GetQlen(), ih.hop[i].GetQlen());
+			agg.ih.hop[i] = ih.hop[i];
+			agg.ih.hop[i].SetQlen(qlen);
+		}
+	}
+	agg.pg = pg;
+	agg.path = path;
+	agg.ecnbits |= ecnbits;
+	agg.n++;
+	if (m_ackCoalesceCount > 0 && agg.n >= m_ackCoalesceCount)
+		FlushAck(q);
+	else if (agg.n == 1)
+		agg.timer = Simulator::Schedule(NanoSeconds(m_ackCoalesceTime), &RdmaHw::FlushAck, this, q);
+}
+
+void RdmaHw::FlushAck(Ptr<RdmaRxQueuePair> q){
+	auto &agg = q->m_ackAgg;
+	if (agg.n == 0)
+		return;
+	Simulator::Cancel(agg.timer);
+	SendAck(q, false, agg.pg, agg.ih, agg.path, agg.ecnbits, false, 0, 0);
+	agg.n = 0;
+	agg.ecnbits = 0;
+}
+
 //  源节点 接收到cnp
 int RdmaHw::ReceiveCnp(Ptr<Packet> p, CustomHeader &ch){
 	// QCN on NIC
@@ -432,7 +664,7 @@ int RdmaHw::ReceiveCnp(Ptr<Packet> p, CustomHeader &ch){
 			qp->hp.m_curRate = dev->GetDataRate();
 			if (m_multipleRate){
 				for (uint32_t i = 0; i < IntHeader::maxHop; i++)
-					qp->hp.hopState[i].Rc = dev->GetDataRate();
+					qp->hp.hopRc[i] = dev->GetDataRate().GetBitRate();
 			}
 		}else if (m_cc_mode == 7){
 			qp->tmly.m_curRate = dev->GetDataRate();
@@ -464,7 +696,11 @@ int RdmaHw::ReceiveAck(Ptr<Packet> p, CustomHeader &ch){
 	if (m_ack_interval == 0)   ///  和receiveudp 没关系， 只是这个值本身的特性，
 		std::cout << "ERROR: shouldn't receive ack\n";
 	else {
-		if (!m_backto0){
+		if (m_selectiveRepeat){
+			qp->Acknowledge(seq);
+			if ((ch.ack.flags >> qbbHeader::FLAG_SACK) & 1)
+				qp->Sack(ch.ack.sackBegin, ch.ack.sackEnd, ch.l3Prot == 0xFD);
+		}else if (!m_backto0){
 			qp->Acknowledge(seq);
 		}else {
 			uint32_t goback_seq = seq / m_chunk * m_chunk;  /// 和goback 0 有关
@@ -474,8 +710,11 @@ int RdmaHw::ReceiveAck(Ptr<Packet> p, CustomHeader &ch){
 			QpComplete(qp);
 		}
 	}
-	if (ch.l3Prot == 0xFD) // NACK
-		RecoverQueue(qp);
+	if (ch.l3Prot == 0xFD){ // NACK
+		ResetFluid(qp);
+		if (!m_selectiveRepeat)
+			RecoverQueue(qp);
+	}
 
 	// handle cnp
 	if (cnp){
@@ -519,22 +758,52 @@ int RdmaHw::Receive(Ptr<Packet> p, CustomHeader &ch){
 	}
 	return 0;
 }
+
+int RdmaHw::ReceiveNic(uint32_t nic_idx, Ptr<Packet> p, CustomHeader &ch){
+	uint64_t key;
+	uint32_t bytes = 0;
+	if (ch.l3Prot == 0x11){ // the rx qp, the payload is written to the host
+		key = (1lu << 63) | ((uint64_t)ch.sip << 32) | ((uint64_t)ch.udp.pg << 16) | (uint64_t)ch.udp.sport;
+		bytes = p->GetSize() - ch.GetSerializedSize();
+	}else if (ch.l3Prot == 0xFC || ch.l3Prot == 0xFD) // the qp
+		key = GetQpKey(ch.sip, ch.ack.dport, ch.ack.pg);
+	else
+		return Receive(p, ch);
+	Time t;
+	if (!m_nic[nic_idx].model.Rx(key, p->GetSize(), bytes, t))
+		return 0;
+	if (t > Simulator::Now())
+		Simulator::Schedule(t - Simulator::Now(), &RdmaHw::ReceiveLater, this, p, ch);
+	else
+		Receive(p, ch);
+	return 0;
+}
+
+void RdmaHw::ReceiveLater(Ptr<Packet> p, CustomHeader ch){
+	Receive(p, ch);
+}
 //  ReceiverCheckSeq(ch.udp.seq, rxQp, payload_size);
 int RdmaHw::ReceiverCheckSeq(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size){
 	 //int x = ReceiverCheckSeq(ch.udp.seq, rxQp, payload_size);
+	if (m_selectiveRepeat)
+		return ReceiverCheckSeqSr(seq, q, size);
 
 	uint32_t expected = q->ReceiverNextExpectedSeq;
 	if (seq == expected){  /// 刚开始希望接收序列号为0的数据包
 		q->ReceiverNextExpectedSeq = expected + size;  /// 模拟和实际的不同之处，seq
+		// the packet may fill the hole of the reorder buffer, then ACK at once
+		bool filled = q->m_rob.n > 0 && ReorderBufPop(q);
 		if (q->ReceiverNextExpectedSeq >= q->m_milestone_rx){   // m_milestone_rx  可能初始值较大吧？？
 			q->m_milestone_rx += m_ack_interval;
 			return 1; //Generate ACK
-		}else if (q->ReceiverNextExpectedSeq % m_chunk == 0){
+		}else if (filled || q->ReceiverNextExpectedSeq % m_chunk == 0){
 			return 1;
 		}else {
 			return 5;   //??  此时后续如何处理呢
 		}
 	} else if (seq > expected) {
+		if (m_reorderBufSize > 0 && (seq - expected) % m_mtu == 0 && (seq - expected) / m_mtu < m_reorderBufSize)
+			return ReorderBufPush(q, seq, size);
 		// Generate NACK              除了goback 0 , 不会修改q->ReceiverNextExpectedSeq;
 		if (Simulator::Now() >= q->m_nackTimer || q->m_lastNACK != expected){
 			q->m_nackTimer = Simulator::Now() + MicroSeconds(m_nack_interval);
@@ -543,6 +812,7 @@ int RdmaHw::ReceiverCheckSeq(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size
 				// 和goback 0 有关
 				//进行取整处理，使其成为 m_chunk 的整数倍
 				q->ReceiverNextExpectedSeq = q->ReceiverNextExpectedSeq / m_chunk*m_chunk;
+				ReorderBufClear(q);
 			}
 			return 2;
 		}else
@@ -552,6 +822,131 @@ int RdmaHw::ReceiverCheckSeq(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size
 		return 3;
 	}
 }
+// returns 1: ACK, 2: NACK, 3: duplicate, 5: no ACK yet, 6: ACK with the SACK block of this packet
+int RdmaHw::ReceiverCheckSeqSr(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size){
+	uint32_t expected = q->ReceiverNextExpectedSeq;
+	auto &ooo = q->m_ooo;
+	if (seq == expected){
+		expected += size;
+		// the packet may fill a hole, then ACK at once
+		bool filled = false;
+		while (!ooo.empty() && ooo.begin()->first <= expected){
+			expected = std::max(expected, ooo.begin()->second);
+			ooo.erase(ooo.begin());
+			filled = true;
+		}
+		q->ReceiverNextExpectedSeq = expected;
+		if (expected >= q->m_milestone_rx){
+			q->m_milestone_rx += m_ack_interval;
+			return 1;
+		}else if (filled || expected % m_chunk == 0){
+			return 1;
+		}else {
+			return 5;
+		}
+	} else if (seq > expected) {
+		// keep the packet, unless it is a duplicate
+		uint32_t begin = seq, end = seq + size;
+		auto it = ooo.upper_bound(begin);
+		if (it != ooo.begin() && std::prev(it)->second >= begin){
+			--it;
+			if (it->second >= end)
+				return 3;
+		}
+		while (it != ooo.end() && it->first <= end){
+			begin = std::min(begin, it->first);
+			end = std::max(end, it->second);
+			it = ooo.erase(it);
+		}
+		ooo[begin] = end;
+		// NACK like go-back-N, so a lost retransmission is sent again after the NACK timer
+		if (Simulator::Now() >= q->m_nackTimer || q->m_lastNACK != expected){
+			q->m_nackTimer = Simulator::Now() + MicroSeconds(m_nack_interval);
+			q->m_lastNACK = expected;
+			return 2;
+		}
+		return 6;
+	}else {
+		// Duplicate.
+		return 3;
+	}
+}
+
+// returns 3: duplicate, 7: kept in the reorder buffer
+int RdmaHw::ReorderBufPush(Ptr<RdmaRxQueuePair> q, uint32_t seq, uint32_t size){
+	auto &rob = q->m_rob;
+	if (rob.bits.empty())
+		rob.bits.resize((m_reorderBufSize + 63) / 64, 0);
+	uint32_t slot = seq / m_mtu % (rob.bits.size() * 64);
+	uint64_t mask = 1ull << (slot % 64);
+	if (rob.bits[slot / 64] & mask)
+		return 3;
+	rob.bits[slot / 64] |= mask;
+	if (rob.n == 0 || seq + size > rob.end)
+		rob.end = seq + size;
+	rob.n++;
+	m_reorderPkts++;
+	if (!rob.timer.IsRunning())
+		rob.timer = Simulator::Schedule(NanoSeconds(m_reorderTimeout), &RdmaHw::ReorderTimeout, this, q);
+	return 7;
+}
+
+// move ReceiverNextExpectedSeq over the packets in the reorder buffer, returns whether it moved
+bool RdmaHw::ReorderBufPop(Ptr<RdmaRxQueuePair> q){
+	auto &rob = q->m_rob;
+	uint32_t cap = rob.bits.size() * 64;
+	uint32_t expected = q->ReceiverNextExpectedSeq;
+	bool moved = false;
+	while (rob.n > 0){
+		uint32_t slot = expected / m_mtu % cap;
+		uint64_t mask = 1ull << (slot % 64);
+		if (!(rob.bits[slot / 64] & mask))
+			break;
+		rob.bits[slot / 64] &= ~mask;
+		rob.n--;
+		expected += m_mtu;
+		moved = true;
+	}
+	if (!moved)
+		return false;
+	// only the last packet of a flow is shorter than the mtu
+	q->ReceiverNextExpectedSeq = std::min(expected, rob.end);
+	// the next hole gets a full timeout
+	Simulator::Cancel(rob.timer);
+	if (rob.n > 0)
+		rob.timer = Simulator::Schedule(NanoSeconds(m_reorderTimeout), &RdmaHw::ReorderTimeout, this, q);
+	return true;
+}
+
+void RdmaHw::ReorderBufClear(Ptr<RdmaRxQueuePair> q){
+	auto &rob = q->m_rob;
+	std::fill(rob.bits.begin(), rob.bits.end(), 0);
+	rob.n = 0;
+	Simulator::Cancel(rob.timer);
+}
+
+void RdmaHw::ReorderTimeout(Ptr<RdmaRxQueuePair> q){
+	auto &rob = q->m_rob;
+	if (rob.n == 0)
+		return;
+	// the hole is still open, so the packet is lost
+	q->m_nackTimer = Simulator::Now() + MicroSeconds(m_nack_interval);
+	q->m_lastNACK = q->ReceiverNextExpectedSeq;
+	m_reorderNacks++;
+	// the NACK also covers the coalesced packets
+	auto &agg = q->m_ackAgg;
+	uint8_t ecnbits = agg.ecnbits;
+	agg.n = 0;
+	agg.ecnbits = 0;
+	Simulator::Cancel(agg.timer);
+	if (m_backto0){
+		q->ReceiverNextExpectedSeq = q->ReceiverNextExpectedSeq / m_chunk*m_chunk;
+		ReorderBufClear(q);
+	}else // NACK again if the retransmission is lost too
+		rob.timer = Simulator::Schedule(NanoSeconds(std::max(m_reorderTimeout, (uint64_t)(m_nack_interval * 1000))), &RdmaHw::ReorderTimeout, this, q);
+	SendAck(q, true, rob.pg, rob.ih, rob.path, ecnbits, false, 0, 0);
+}
+
 void RdmaHw::AddHeader (Ptr<Packet> p, uint16_t protocolNumber){
 	PppHeader ppp;
 	ppp.SetProtocol (EtherToPpp (protocolNumber));
@@ -584,6 +979,7 @@ void RdmaHw::QpComplete(Ptr<RdmaQueuePair> qp){
 	m_qpCompleteCallback(qp);
 	// 
 	qp->m_notifyAppFinish();
+	m_nic[GetNicIdxOfQp(qp)].load -= qp->m_size;
 
 	// delete the qp
 	DeleteQueuePair(qp);
@@ -608,6 +1004,7 @@ void RdmaHw::RedistributeQp(){
 		if (m_nic[i].dev == NULL)
 			continue;
 		m_nic[i].qpGrp->Clear();
+		m_nic[i].load = 0;
 	}
 
 	// redistribute qp
@@ -615,6 +1012,7 @@ void RdmaHw::RedistributeQp(){
 		Ptr<RdmaQueuePair> qp = it.second;
 		uint32_t nic_idx = GetNicIdxOfQp(qp);
 		m_nic[nic_idx].qpGrp->AddQp(qp);
+		m_nic[nic_idx].load += qp->m_size;
 		// Notify Nic
 		m_nic[nic_idx].dev->ReassignedQp(qp);
 	}
@@ -622,14 +1020,21 @@ void RdmaHw::RedistributeQp(){
 //// 看 qbb-netdevice.cc
 Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
 	//** 核心发送逻辑
-	uint32_t payload_size = qp->GetBytesLeft();
-	if (m_mtu < payload_size)
-		payload_size = m_mtu;
+	uint32_t payload_size;
+	uint64_t seq;
+	bool retx = qp->sr.retxBytes > 0;
+	if (retx){ // selective repeat sends the holes first
+		payload_size = qp->NextRetx(m_mtu, seq);
+	}else {
+		payload_size = GetPayloadSize(qp);
+		seq = qp->snd_nxt;
+	}
 	Ptr<Packet> p = Create<Packet> (payload_size);
 	// add SeqTsHeader
 	SeqTsHeader seqTs;
-	seqTs.SetSeq (qp->snd_nxt);
+	seqTs.SetSeq (seq);
 	seqTs.SetPG (qp->m_pg);
+	seqTs.ih.nslot = qp->hp.intSlots;
 	p->AddHeader (seqTs);
 	// add udp header
 	UdpHeader udpHeader;
@@ -644,15 +1049,25 @@ Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
 	ipHeader.SetPayloadSize (p->GetSize());
 	ipHeader.SetTtl (64);
 	ipHeader.SetTos (0);
-	ipHeader.SetIdentification (qp->m_ipid);
+	// with spraying, the identification is the path, which the switches hash and the ACK echoes
+	ipHeader.SetIdentification (m_sprayPaths > 1 ? qp->m_ipid % m_sprayPaths : qp->m_ipid);
 	p->AddHeader(ipHeader);
 	// add ppp header
 	PppHeader ppp;
 	ppp.SetProtocol (0x0021); // EtherToPpp(0x800), see point-to-point-net-device.cc
 	p->AddHeader (ppp);
+	if (qp->m_tenant > 0)
+		p->AddPacketTag(TenantTag(qp->m_tenant));
+	p->AddPacketTag(FlowHashTag(qp->GetHash()));
 
 	// update state
-	qp->snd_nxt += payload_size;
+	if (!retx)
+		qp->snd_nxt += payload_size;
+	if (seq < qp->snd_max){
+		m_retxPkts++;
+		m_retxBytes += payload_size;
+	}else
+		qp->snd_max = seq + payload_size;
 	qp->m_ipid++;
 
 	// return
@@ -662,6 +1077,12 @@ Ptr<Packet> RdmaHw::GetNxtPacket(Ptr<RdmaQueuePair> qp){
 void RdmaHw::PktSent(Ptr<RdmaQueuePair> qp, Ptr<Packet> pkt, Time interframeGap){
 	qp->lastPktSize = pkt->GetSize();
 	UpdateNextAvail(qp, interframeGap, pkt->GetSize());
+	if (m_nicModel){
+		// the packet size stands for the payload and the DMA overheads
+		Time t = m_nic[GetNicIdxOfQp(qp)].model.Tx(GetQpKey(qp->dip.Get(), qp->sport, qp->m_pg), pkt->GetSize());
+		if (t > qp->m_nextAvail)
+			qp->m_nextAvail = t;
+	}
 }
 
 void RdmaHw::UpdateNextAvail(Ptr<RdmaQueuePair> qp, Time interframeGap, uint32_t pkt_size){
@@ -673,6 +1094,44 @@ void RdmaHw::UpdateNextAvail(Ptr<RdmaQueuePair> qp, Time interframeGap, uint32_t
 	qp->m_nextAvail = Simulator::Now() + sendingTime;
 }
 
+uint32_t RdmaHw::GetPayloadSize(Ptr<RdmaQueuePair> qp){
+	uint64_t left = qp->GetBytesLeft();
+	uint32_t size = std::min(left, (uint64_t)m_mtu);
+	if (m_fluidThreshold == 0 || qp->m_size < m_fluidThreshold)
+		return size;
+	// the rates are changed in many places, so the stable phase is checked here, once per packet
+	double r = qp->m_rate.GetBitRate(), r0 = qp->fluid.m_rate.GetBitRate();
+	if (r > r0 * (1 + m_fluidTolerance) || r < r0 * (1 - m_fluidTolerance)){
+		ResetFluid(qp);
+		return size;
+	}
+	if (qp->fluid.m_stable < m_fluidStable){
+		qp->fluid.m_stable++;
+		return size;
+	}
+	// one chunk, but never beyond the window, and keep the tail of the flow at packet level
+	uint64_t chunk = (uint64_t)m_fluidChunk * m_mtu;
+	uint64_t win = qp->GetWin();
+	if (win > 0)
+		chunk = std::min(chunk, win > qp->GetOnTheFly() ? win - qp->GetOnTheFly() : 0);
+	if (chunk <= m_mtu || left < chunk + m_mtu)
+		return size;
+	return chunk / m_mtu * m_mtu;
+}
+
+void RdmaHw::ResetFluid(Ptr<RdmaQueuePair> qp){
+	qp->fluid.m_rate = qp->m_rate;
+	qp->fluid.m_stable = 0;
+}
+
+void RdmaHw::PfcNotify(uint32_t type){
+	// a PAUSE on any NIC of this host sends all its long flows back to packet level
+	if (type != 1)
+		return;
+	for (auto &it : m_qpMap)
+		ResetFluid(it.second);
+}
+
 void RdmaHw::ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate){
 	#if 1
 	Time sendingTime = Seconds(qp->m_rate.CalculateTxTime(qp->lastPktSize));
@@ -819,12 +1278,36 @@ void RdmaHw::HyperIncreaseMlx(Ptr<RdmaQueuePair> q){
  ***********************/
 void RdmaHw::HandleAckHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch){
 	uint32_t ack_seq = ch.ack.seq;
+	// the data packets reserve slots for the hops of the path; the INT is not usable if they did not fit
+	qp->hp.intSlots = std::min((uint32_t)ch.ack.ih.nhop, IntHeader::maxHop);
+	if (ch.ack.ih.nhop > ch.ack.ih.nslot)
+		return;
+	IntHop *pathHop = NULL;
+	if (m_sprayPaths > 1){
+		// the INT of each path is compared with the last snapshot of the same path, while the rate is per QP
+		if (qp->hp.pathHop.empty()){
+			qp->hp.pathHop.resize(m_sprayPaths * IntHeader::maxHop);
+			qp->hp.pathValid.resize(m_sprayPaths, false);
+		}
+		uint32_t path = ch.ipid % m_sprayPaths;
+		pathHop = &qp->hp.pathHop[path * IntHeader::maxHop];
+		if (!qp->hp.pathValid[path] && qp->hp.m_lastUpdateSeq != 0){
+			// the first ACK of this path only takes the snapshot
+			qp->hp.pathValid[path] = true;
+			std::copy(ch.ack.ih.hop, ch.ack.ih.hop + IntHeader::maxHop, pathHop);
+			return;
+		}
+		qp->hp.pathValid[path] = true;
+		std::copy(pathHop, pathHop + IntHeader::maxHop, qp->hp.hop);
+	}
 	// update rate
 	if (ack_seq > qp->hp.m_lastUpdateSeq){ // if full RTT feedback is ready, do full update
 		UpdateRateHp(qp, p, ch, false);
 	}else{ // do fast react
 		FastReactHp(qp, p, ch);
 	}
+	if (pathHop != NULL)
+		std::copy(qp->hp.hop, qp->hp.hop + IntHeader::maxHop, pathHop);
 }
 
 void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react){
@@ -834,7 +1317,6 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 		qp->hp.m_lastUpdateSeq = next_seq;
 		// store INT
 		IntHeader &ih = ch.ack.ih;
-		NS_ASSERT(ih.nhop <= IntHeader::maxHop);
 		for (uint32_t i = 0; i < ih.nhop; i++)
 			qp->hp.hop[i] = ih.hop[i];
 		#if PRINT_LOG
@@ -848,135 +1330,113 @@ void RdmaHw::UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch
 	}else {
 		// check packet INT
 		IntHeader &ih = ch.ack.ih;
-		if (ih.nhop <= IntHeader::maxHop){
-			double max_c = 0;
-			bool inStable = false;
+		if (ih.nhop <= ih.nslot){
+			// The hops are computed in arrays, with selects instead of branches in the per-hop loops, and the rates
+			// on raw bps. The double operations are the same and in the same order as the plain per-hop version,
+			// so the results are identical
+			const uint32_t n = ih.nhop;
+			const uint64_t baseRtt = qp->m_baseRtt;
+			const uint64_t maxRate = qp->m_max_rate.GetBitRate(), minRate = m_minRate.GetBitRate(), rai = m_rai.GetBitRate();
+			const double maxRateD = maxRate, win = qp->m_win;
+			uint64_t tau[IntHeader::hopCapacity];
+			double u[IntHeader::hopCapacity];
+			bool take[IntHeader::hopCapacity]; // the snapshot of the hop is replaced
+			bool valid[IntHeader::hopCapacity]; // the hop is used to update the rate
 			#if PRINT_LOG
 			if (print)
 				printf("%lu %s %08x %08x %u %u [%u,%u,%u]", Simulator::Now().GetTimeStep(), fast_react? "fast" : "update", qp->sip.Get(), qp->dip.Get(), qp->sport, qp->dport, qp->hp.m_lastUpdateSeq, ch.ack.seq, next_seq);
 			#endif
-			// check each hop
-			double U = 0;
-			uint64_t dt = 0;
-			bool updated[IntHeader::maxHop] = {false}, updated_any = false;
-			NS_ASSERT(ih.nhop <= IntHeader::maxHop);
-			for (uint32_t i = 0; i < ih.nhop; i++){
-				if (m_sampleFeedback){
-					if (ih.hop[i].GetQlen() == 0 && fast_react)
-						continue;
-				}
-				updated[i] = updated_any = true;
+			for (uint32_t i = 0; i < n; i++){
+				IntHop &h = ih.hop[i], &o = qp->hp.hop[i];
+				uint64_t rate = h.GetLineRate();
+				uint32_t qlen = h.GetQlen();
+				tau[i] = h.GetTimeDelta(o);
+				double txRate = h.GetBytesDelta(o) * 8 / (tau[i] * 1e-9);
+				// with sampled feedback, fast react skips the hops without queue.
+				// adaptive routing may move the flow to another port, whose counters have nothing to do with the
+				// last snapshot. A rate far above the line rate only comes from that, so just take the new snapshot
+				take[i] = !(m_sampleFeedback && fast_react && qlen == 0);
+				valid[i] = take[i] && !(m_adaptiveRouting && txRate > 2.0 * rate);
+				u[i] = txRate / rate + (double)std::min(qlen, o.GetQlen()) * maxRateD / rate / win;
 				#if PRINT_LOG
 				if (print)
-					printf(" %u(%u) %lu(%lu) %lu(%lu)", ih.hop[i].GetQlen(), qp->hp.hop[i].GetQlen(), ih.hop[i].GetBytes(), qp->hp.hop[i].GetBytes(), ih.hop[i].GetTime(), qp->hp.hop[i].GetTime());
+					printf(" %u(%u) %lu(%lu) %lu(%lu) %.3lf %.3lf", qlen, o.GetQlen(), h.GetBytes(), o.GetBytes(), h.GetTime(), o.GetTime(), txRate, u[i]);
 				#endif
-				uint64_t tau = ih.hop[i].GetTimeDelta(qp->hp.hop[i]);;
-				double duration = tau * 1e-9;
-				double txRate = (ih.hop[i].GetBytesDelta(qp->hp.hop[i])) * 8 / duration;
-				double u = txRate / ih.hop[i].GetLineRate() + (double)std::min(ih.hop[i].GetQlen(), qp->hp.hop[i].GetQlen()) * qp->m_max_rate.GetBitRate() / ih.hop[i].GetLineRate() /qp->m_win;
-				#if PRINT_LOG
-				if (print)
-					printf(" %.3lf %.3lf", txRate, u);
-				#endif
-				if (!m_multipleRate){
-					// for aggregate (single R)
-					if (u > U){
-						U = u;
-						dt = tau;
-					}
-				}else {
-					// for per hop (per hop R)
-					if (tau > qp->m_baseRtt)
-						tau = qp->m_baseRtt;
-					qp->hp.hopState[i].u = (qp->hp.hopState[i].u * (qp->m_baseRtt - tau) + u * tau) / double(qp->m_baseRtt);
-				}
-				qp->hp.hop[i] = ih.hop[i];
+			}
+			bool updated_any = false;
+			for (uint32_t i = 0; i < n; i++){
+				updated_any |= valid[i];
+				qp->hp.hop[i] = take[i] ? ih.hop[i] : qp->hp.hop[i];
 			}
 
-			DataRate new_rate;
-			int32_t new_incStage;
-			DataRate new_rate_per_hop[IntHeader::maxHop];
-			int32_t new_incStage_per_hop[IntHeader::maxHop];
+			uint64_t new_rate = 0;
+			uint32_t new_incStage = qp->hp.m_incStage;
+			uint64_t new_rate_per_hop[IntHeader::hopCapacity];
+			uint32_t new_incStage_per_hop[IntHeader::hopCapacity];
 			if (!m_multipleRate){
-				// for aggregate (single R)
+				// for aggregate (single R): the hop of the max u
+				double U = 0;
+				uint64_t dt = 0;
+				for (uint32_t i = 0; i < n; i++){
+					bool larger = valid[i] && u[i] > U;
+					U = larger ? u[i] : U;
+					dt = larger ? tau[i] : dt;
+				}
 				if (updated_any){
-					if (dt > qp->m_baseRtt)
-						dt = qp->m_baseRtt;
-					qp->hp.u = (qp->hp.u * (qp->m_baseRtt - dt) + U * dt) / double(qp->m_baseRtt);
-					max_c = qp->hp.u / m_targetUtil;
+					if (dt > baseRtt)
+						dt = baseRtt;
+					qp->hp.u = (qp->hp.u * (baseRtt - dt) + U * dt) / double(baseRtt);
+					double max_c = qp->hp.u / m_targetUtil;
 
+					uint64_t curRate = qp->hp.m_curRate.GetBitRate();
 					if (max_c >= 1 || qp->hp.m_incStage >= m_miThresh){
-						new_rate = qp->hp.m_curRate / max_c + m_rai;
+						new_rate = max_c > 0 ? (uint64_t)(curRate / max_c) + rai : maxRate;
 						new_incStage = 0;
 					}else{
-						new_rate = qp->hp.m_curRate + m_rai;
+						new_rate = curRate + rai;
 						new_incStage = qp->hp.m_incStage+1;
 					}
-					if (new_rate < m_minRate)
-						new_rate = m_minRate;
-					if (new_rate > qp->m_max_rate)
-						new_rate = qp->m_max_rate;
+					new_rate = std::min(std::max(new_rate, minRate), maxRate);
 					#if PRINT_LOG
 					if (print)
-						printf(" u=%.6lf U=%.3lf dt=%u max_c=%.3lf", qp->hp.u, U, dt, max_c);
-					#endif
-					#if PRINT_LOG
-					if (print)
-						printf(" rate:%.3lf->%.3lf\n", qp->hp.m_curRate.GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
+						printf(" u=%.6lf U=%.3lf dt=%lu max_c=%.3lf rate:%.3lf->%.3lf\n", qp->hp.u, U, dt, max_c, curRate*1e-9, new_rate*1e-9);
 					#endif
 				}
 			}else{
 				// for per hop (per hop R)
-				new_rate = qp->m_max_rate;
-				for (uint32_t i = 0; i < ih.nhop; i++){
-					if (updated[i]){
-						double c = qp->hp.hopState[i].u / m_targetUtil;
-						if (c >= 1 || qp->hp.hopState[i].incStage >= m_miThresh){
-							new_rate_per_hop[i] = qp->hp.hopState[i].Rc / c + m_rai;
-							new_incStage_per_hop[i] = 0;
-						}else{
-							new_rate_per_hop[i] = qp->hp.hopState[i].Rc + m_rai;
-							new_incStage_per_hop[i] = qp->hp.hopState[i].incStage+1;
-						}
-						// bound rate
-						if (new_rate_per_hop[i] < m_minRate)
-							new_rate_per_hop[i] = m_minRate;
-						if (new_rate_per_hop[i] > qp->m_max_rate)
-							new_rate_per_hop[i] = qp->m_max_rate;
-						// find min new_rate
-						if (new_rate_per_hop[i] < new_rate)
-							new_rate = new_rate_per_hop[i];
-						#if PRINT_LOG
-						if (print)
-							printf(" [%u]u=%.6lf c=%.3lf", i, qp->hp.hopState[i].u, c);
-						#endif
-						#if PRINT_LOG
-						if (print)
-							printf(" %.3lf->%.3lf", qp->hp.hopState[i].Rc.GetBitRate()*1e-9, new_rate.GetBitRate()*1e-9);
-						#endif
-					}else{
-						if (qp->hp.hopState[i].Rc < new_rate)
-							new_rate = qp->hp.hopState[i].Rc;
-					}
+				for (uint32_t i = 0; i < n; i++){
+					uint64_t t = std::min(tau[i], baseRtt);
+					double hu = (qp->hp.hopU[i] * (baseRtt - t) + u[i] * t) / double(baseRtt);
+					qp->hp.hopU[i] = valid[i] ? hu : qp->hp.hopU[i];
+				}
+				new_rate = maxRate;
+				for (uint32_t i = 0; i < n; i++){
+					double c = qp->hp.hopU[i] / m_targetUtil;
+					bool md = c >= 1 || qp->hp.hopIncStage[i] >= m_miThresh;
+					// c is 0 on a hop without traffic and queue, which allows any rate (and would divide by 0)
+					uint64_t r = md && c <= 0 ? maxRate : (uint64_t)(qp->hp.hopRc[i] / (md ? c : 1.0)) + rai;
+					new_rate_per_hop[i] = std::min(std::max(r, minRate), maxRate);
+					new_incStage_per_hop[i] = md ? 0 : qp->hp.hopIncStage[i] + 1;
+					// the min of the new rates of the updated hops and the rates of the others
+					new_rate = std::min(new_rate, valid[i] ? new_rate_per_hop[i] : qp->hp.hopRc[i]);
 				}
 				#if PRINT_LOG
-				printf("\n");
+				if (print)
+					printf(" rate:%.3lf\n", new_rate*1e-9);
 				#endif
 			}
 			if (updated_any)
-				ChangeRate(qp, new_rate);
+				ChangeRate(qp, DataRate(new_rate));
 			if (!fast_react){
 				if (updated_any){
-					qp->hp.m_curRate = new_rate;
+					qp->hp.m_curRate = DataRate(new_rate);
 					qp->hp.m_incStage = new_incStage;
 				}
 				if (m_multipleRate){
 					// for per hop (per hop R)
-					for (uint32_t i = 0; i < ih.nhop; i++){
-						if (updated[i]){
-							qp->hp.hopState[i].Rc = new_rate_per_hop[i];
-							qp->hp.hopState[i].incStage = new_incStage_per_hop[i];
-						}
+					for (uint32_t i = 0; i < n; i++){
+						qp->hp.hopRc[i] = valid[i] ? new_rate_per_hop[i] : qp->hp.hopRc[i];
+						qp->hp.hopIncStage[i] = valid[i] ? new_incStage_per_hop[i] : qp->hp.hopIncStage[i];
 					}
 				}
 			}
@@ -8,16 +8,20 @@
 #include "qbb-net-device.h"
 #include <unordered_map>
 #include "pint.h"
+#include "nic-model.h"
 
 namespace ns3 {
 
 struct RdmaInterfaceMgr{  /// 网卡
 	Ptr<QbbNetDevice> dev;
 	Ptr<RdmaQueuePairGroup> qpGrp;
+	uint64_t load; // bytes of the unfinished qps on this NIC
+	NicModel model; // used with RdmaHw::m_nicModel
 
-	RdmaInterfaceMgr() : dev(NULL), qpGrp(NULL) {}
+	RdmaInterfaceMgr() : dev(NULL), qpGrp(NULL), load(0) {}
 	RdmaInterfaceMgr(Ptr<QbbNetDevice> _dev){
 		dev = _dev;
+		load = 0;
 	}
 };
 
@@ -35,6 +39,36 @@ public:
 	uint32_t m_chunk;   //数据块的大小  L2ChunkSize
 	uint32_t m_ack_interval;  // m_ack_interval定义了接收方在接收到数据包后，发送ACK的??间隔。  L2AckInterval
 	bool m_backto0;  //   Layer 2 go back to zero transmission.
+	// Selective repeat instead of go-back-N: the receiver keeps the out-of-order packets and reports each
+	// one in a SACK block of the ACK/NACK, and the sender retransmits only the holes
+	bool m_selectiveRepeat;
+	uint64_t m_retxPkts, m_retxBytes; // retransmitted packets and bytes, in either mode
+	// ACK coalescing: one ACK for every m_ackCoalesceCount in-order data packets, or m_ackCoalesceTime ns after
+	// the first packet not ACKed. The ACK echoes the INT of the latest packet; with m_ackCoalesceMaxQlen, the
+	// qlen of each hop is the max over the coalesced packets, so a short queue spike is not missed.
+	// NACKs are never delayed
+	uint32_t m_ackCoalesceCount;
+	uint64_t m_ackCoalesceTime;
+	bool m_ackCoalesceMaxQlen;
+	// Packet spraying: the NIC sends the packets of a QP round robin over m_sprayPaths paths, with the path in
+	// the IP identification. Switches in the spray routing mode hash it with the flow. The ACK echoes the path,
+	// so HPCC compares the INT of each path with the last snapshot of the same path. 1: no spraying
+	uint32_t m_sprayPaths;
+	// Reorder buffer of the go-back-N receiver: up to m_reorderBufSize packets above the expected seq are kept
+	// in a bitmap, and the NACK is only sent if the hole is still open m_reorderTimeout ns later. 0: off
+	uint32_t m_reorderBufSize;
+	uint64_t m_reorderTimeout;
+	uint64_t m_reorderPkts, m_reorderNacks; // packets kept in the reorder buffer, NACKs at the reorder timeout
+	// Multi-rail hosts: a qp stays on the NIC (rail) picked when it starts, among the NICs on a shortest path to
+	// the destination. The app may name the rail; otherwise 0: hash of the flow, 1: the NIC with the fewest bytes
+	// of unfinished qps. If the rail loses its path, the qp falls back to the hash
+	uint32_t m_railPolicy;
+	// NIC resource model (see NicModel): QP context cache and PCIe costs of each NIC. Data packets and ACKs wait
+	// for the rx pipeline before they are processed, and a qp's packets wait for their context and payload
+	bool m_nicModel;
+	uint32_t m_qpcCacheSize, m_qpcSize, m_wqeSize, m_nicRxBuffer;
+	uint64_t m_qpcHitTime, m_qpcMissTime, m_pcieDelay; // ns
+	DataRate m_pcieRate;
 
 	// Use variable window size or not   |  Fast React to congestion feedback
 	bool m_var_win,           m_fast_react;
@@ -63,9 +97,11 @@ public:
 
 	//用于获取QP所在的数据链路层接口的索引。
 	uint32_t GetNicIdxOfQp(Ptr<RdmaQueuePair> qp); // get the NIC index of the qp
+	uint32_t GetNicIdxOfRail(uint32_t rail); // the NIC index of the rail-th NIC (1: the first)
+	uint32_t GetNRails(); // number of NICs
 	
 	// 创建新的 RDMA 传输会话，设置队列对及其相关的网络参数
-	void AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport, uint16_t _dport, uint32_t win, uint64_t baseRtt, Callback<void> notifyAppFinish); // add a new qp (new send)
+	void AddQueuePair(uint64_t size, uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, uint16_t _sport, uint16_t _dport, uint32_t win, uint64_t baseRtt, uint32_t rail, uint16_t tenant, Callback<void> notifyAppFinish); // add a new qp (new send), rail 0: by m_railPolicy
 	
 	//删除一个队列对（QP）
 	void DeleteQueuePair(Ptr<RdmaQueuePair> qp);
@@ -77,13 +113,23 @@ public:
 
 	/// 设置处理方式
 	int ReceiveUdp(Ptr<Packet> p, CustomHeader &ch);
+	void SendAck(Ptr<RdmaRxQueuePair> q, bool nack, uint16_t pg, const IntHeader &ih, uint16_t path, uint8_t ecnbits, bool sack, uint32_t sackBegin, uint32_t sackEnd);
+	void CoalesceAck(Ptr<RdmaRxQueuePair> q, uint16_t pg, const IntHeader &ih, uint16_t path, uint8_t ecnbits);
+	void FlushAck(Ptr<RdmaRxQueuePair> q);
+	void ReorderTimeout(Ptr<RdmaRxQueuePair> q);
 	int ReceiveCnp(Ptr<Packet> p, CustomHeader &ch);
 	int ReceiveAck(Ptr<Packet> p, CustomHeader &ch); // handle both ACK and NACK
 	int Receive(Ptr<Packet> p, CustomHeader &ch); // callback function that the QbbNetDevice should use when receive packets. Only NIC can call this function. And do not call this upon PFC
+	int ReceiveNic(uint32_t nic_idx, Ptr<Packet> p, CustomHeader &ch); // Receive through the NicModel of the NIC
+	void ReceiveLater(Ptr<Packet> p, CustomHeader ch);
 	//处理一般的网络数据包，并做出适当的响应。注意，该函数不能处理 PFC（优先级流控）事件
 
 	void CheckandSendQCN(Ptr<RdmaRxQueuePair> q);  //检查队列对（QP）的状态，并决定是否发送 QCN ???
 	int ReceiverCheckSeq(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size); //检查接收的序列号 seq 是否与期望的序列号匹配
+	int ReceiverCheckSeqSr(uint32_t seq, Ptr<RdmaRxQueuePair> q, uint32_t size); // selective repeat version
+	int ReorderBufPush(Ptr<RdmaRxQueuePair> q, uint32_t seq, uint32_t size);
+	bool ReorderBufPop(Ptr<RdmaRxQueuePair> q);
+	void ReorderBufClear(Ptr<RdmaRxQueuePair> q);
 	void AddHeader (Ptr<Packet> p, uint16_t protocolNumber);   // 指定需要添加的协议类型
 	static uint16_t EtherToPpp (uint16_t protocol);   ///     以太网映射到 PPP 
 
@@ -100,6 +146,21 @@ public:
 	void PktSent(Ptr<RdmaQueuePair> qp, Ptr<Packet> pkt, Time interframeGap);
 	void UpdateNextAvail(Ptr<RdmaQueuePair> qp, Time interframeGap, uint32_t pkt_size);
 	void ChangeRate(Ptr<RdmaQueuePair> qp, DataRate new_rate);
+
+	/******************************
+	 * Hybrid fluid mode
+	 *****************************/
+	// A long flow (m_size >= m_fluidThreshold) whose rate stays within m_fluidTolerance for
+	// m_fluidStable packets is sent in chunks of m_fluidChunk MTUs. A chunk is one packet on the wire,
+	// so it still takes its serialization time on every link and its bytes in the switch buffers,
+	// but costs the events of one packet. Any rate change, NACK or PFC pause goes back to MTU packets.
+	uint64_t m_fluidThreshold; // 0: disabled
+	uint32_t m_fluidChunk;
+	uint32_t m_fluidStable;
+	double m_fluidTolerance;
+	uint32_t GetPayloadSize(Ptr<RdmaQueuePair> qp);
+	void ResetFluid(Ptr<RdmaQueuePair> qp);
+	void PfcNotify(uint32_t type);
 	/******************************
 	 * Mellanox's version of DCQCN
 	 *****************************/
@@ -146,6 +207,7 @@ public:
 	bool m_multipleRate;   //Maintain multiple rates in HPCC",BooleanValue(true),
 				
 	bool m_sampleFeedback; //  Whether sample feedback or not   boolean
+	bool m_adaptiveRouting; // the switches route data packets other than by ECMP, so a hop may change between ACKs
 	void HandleAckHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch);
 	void UpdateRateHp(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react);
 	void UpdateRateHpTest(Ptr<RdmaQueuePair> qp, Ptr<Packet> p, CustomHeader &ch, bool fast_react);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <ns3/hash.h>
 #include <ns3/uinteger.h>
 #include <ns3/seq-ts-header.h>
@@ -9,6 +10,21 @@
 
 namespace ns3 {
 
+static uint32_t HashTuple(uint32_t sip, uint32_t dip, uint16_t sport, uint16_t dport){
+	union{
+		struct {
+			uint32_t sip, dip;
+			uint16_t sport, dport;
+		};
+		char c[12];
+	} buf;
+	buf.sip = sip;
+	buf.dip = dip;
+	buf.sport = sport;
+	buf.dport = dport;
+	return Hash32(buf.c, 12);
+}
+
 /**************************
  * RdmaQueuePair
  *************************/
@@ -26,8 +42,11 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
 	dip = _dip;
 	sport = _sport;
 	dport = _dport;
+	m_hash = HashTuple(sip.Get(), dip.Get(), sport, dport);
+	m_rail = 0;
+	m_tenant = 0;
 	m_size = 0;
-	snd_nxt = snd_una = 0;
+	snd_nxt = snd_una = snd_max = 0;
 	m_pg = pg;
 	m_ipid = 0;
 	m_win = 0;
@@ -46,18 +65,21 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
 	hp.m_lastUpdateSeq = 0;
 	for (uint32_t i = 0; i < sizeof(hp.keep) / sizeof(hp.keep[0]); i++)
 		hp.keep[i] = 0;
+	hp.intSlots = IntHeader::maxHop;
 	hp.m_incStage = 0;
 	hp.m_lastGap = 0;
 	hp.u = 1;
 	for (uint32_t i = 0; i < IntHeader::maxHop; i++){
-		hp.hopState[i].u = 1;
-		hp.hopState[i].incStage = 0;
+		hp.hopU[i] = 1;
+		hp.hopIncStage[i] = 0;
 	}
 	// tmly
 	tmly.m_lastUpdateSeq = 0;
 	tmly.m_incStage = 0;
 	tmly.lastRtt = 0;
 	tmly.rttDiff = 0;
+	sr.retxBytes = 0;
+	sr.high = 0;
 
 	dctcp.m_lastUpdateSeq = 0;
 	dctcp.m_caState = 0;
@@ -68,6 +90,9 @@ RdmaQueuePair::RdmaQueuePair(uint16_t pg, Ipv4Address _sip, Ipv4Address _dip, ui
 
 	hpccPint.m_lastUpdateSeq = 0;
 	hpccPint.m_incStage = 0;
+	// fluid
+	fluid.m_rate = 0;
+	fluid.m_stable = 0;
 }
 
 void RdmaQueuePair::SetSize(uint64_t size){
@@ -91,28 +116,85 @@ void RdmaQueuePair::SetAppNotifyCallback(Callback<void> notifyAppFinish){
 }
 
 uint64_t RdmaQueuePair::GetBytesLeft(){
-	return m_size >= snd_nxt ? m_size - snd_nxt : 0;
+	return (m_size >= snd_nxt ? m_size - snd_nxt : 0) + sr.retxBytes;
 }
 
 uint32_t RdmaQueuePair::GetHash(void){
-	union{
-		struct {
-			uint32_t sip, dip;
-			uint16_t sport, dport;
-		};
-		char c[12];
-	} buf;
-	buf.sip = sip.Get();
-	buf.dip = dip.Get();
-	buf.sport = sport;
-	buf.dport = dport;
-	return Hash32(buf.c, 12);
+	return m_hash;
 }
 
 void RdmaQueuePair::Acknowledge(uint64_t ack){
 	if (ack > snd_una){
 		snd_una = ack;
+		// a receiver with a reorder buffer may ACK beyond what go-back-N resent
+		if (snd_nxt < snd_una)
+			snd_nxt = snd_una;
+		// drop the selective repeat state below snd_una
+		while (!sr.sacked.empty() && sr.sacked.begin()->first < snd_una){
+			auto it = sr.sacked.begin();
+			uint64_t end = it->second;
+			sr.sacked.erase(it);
+			if (end > snd_una)
+				sr.sacked[snd_una] = end;
+		}
+		while (!sr.retx.empty() && sr.retx.begin()->first < snd_una){
+			auto it = sr.retx.begin();
+			uint64_t end = it->second;
+			sr.retxBytes -= end - it->first;
+			sr.retx.erase(it);
+			if (end > snd_una){
+				sr.retx[snd_una] = end;
+				sr.retxBytes += end - snd_una;
+			}
+		}
+	}
+}
+
+void RdmaQueuePair::Sack(uint64_t begin, uint64_t end, bool nack){
+	begin = std::max(begin, snd_una);
+	if (begin < end){
+		// merge with the overlapping or adjacent ranges
+		auto m = sr.sacked.upper_bound(begin);
+		if (m != sr.sacked.begin() && std::prev(m)->second >= begin)
+			--m;
+		while (m != sr.sacked.end() && m->first <= end){
+			begin = std::min(begin, m->first);
+			end = std::max(end, m->second);
+			m = sr.sacked.erase(m);
+		}
+		sr.sacked[begin] = end;
+	}
+	if (nack){
+		sr.retx.clear();
+		sr.retxBytes = 0;
+		sr.high = snd_una;
+	}
+	// the holes between the sacked ranges are lost
+	uint64_t cur = std::max(sr.high, snd_una);
+	auto it = sr.sacked.upper_bound(cur);
+	if (it != sr.sacked.begin() && std::prev(it)->second > cur)
+		--it;
+	for (; it != sr.sacked.end(); ++it){
+		if (it->first > cur){
+			sr.retx[cur] = it->first;
+			sr.retxBytes += it->first - cur;
+		}
+		cur = std::max(cur, it->second);
 	}
+	if (!sr.sacked.empty() && sr.sacked.rbegin()->second > sr.high)
+		sr.high = sr.sacked.rbegin()->second;
+}
+
+uint32_t RdmaQueuePair::NextRetx(uint32_t mtu, uint64_t &seq){
+	auto it = sr.retx.begin();
+	seq = it->first;
+	uint64_t end = it->second;
+	uint32_t size = std::min(end - seq, (uint64_t)mtu);
+	sr.retx.erase(it);
+	if (seq + size < end)
+		sr.retx[seq + size] = end;
+	sr.retxBytes -= size;
+	return size;
 }
 
 uint64_t RdmaQueuePair::GetOnTheFly(){
@@ -121,7 +203,8 @@ uint64_t RdmaQueuePair::GetOnTheFly(){
 
 bool RdmaQueuePair::IsWinBound(){
 	uint64_t w = GetWin();
-	return w != 0 && GetOnTheFly() >= w;
+	// retransmissions fill holes below snd_nxt, so the window does not hold them back
+	return w != 0 && GetOnTheFly() >= w && sr.retxBytes == 0;
 }
 
 uint64_t RdmaQueuePair::GetWin(){
@@ -170,25 +253,28 @@ TypeId RdmaRxQueuePair::GetTypeId (void)
 RdmaRxQueuePair::RdmaRxQueuePair(){
 	sip = dip = sport = dport = 0;
 	m_ipid = 0;
+	m_tenant = 0;
 	ReceiverNextExpectedSeq = 0;
 	m_nackTimer = Time(0);
 	m_milestone_rx = 0;
 	m_lastNACK = 0;
+	m_hash = 0;
+	m_hashValid = false;
+	m_ackAgg.n = 0;
+	m_ackAgg.ecnbits = 0;
+	m_ackAgg.pg = 0;
+	m_ackAgg.path = 0;
+	m_rob.n = 0;
+	m_rob.end = 0;
+	m_rob.pg = m_rob.path = 0;
 }
 
 uint32_t RdmaRxQueuePair::GetHash(void){
-	union{
-		struct {
-			uint32_t sip, dip;
-			uint16_t sport, dport;
-		};
-		char c[12];
-	} buf;
-	buf.sip = sip;
-	buf.dip = dip;
-	buf.sport = sport;
-	buf.dport = dport;
-	return Hash32(buf.c, 12);
+	if (!m_hashValid){
+		m_hash = HashTuple(sip, dip, sport, dport);
+		m_hashValid = true;
+	}
+	return m_hash;
 }
 
 /*********************
@@ -219,6 +305,16 @@ Ptr<RdmaQueuePair> RdmaQueuePairGroup::operator[](uint32_t idx){
 
 void RdmaQueuePairGroup::AddQp(Ptr<RdmaQueuePair> qp){
 	m_qps.push_back(qp);
+	if (qp->m_pg >= m_pgQps.size())
+		m_pgQps.resize(qp->m_pg + 1);
+	m_pgQps[qp->m_pg].push_back(m_qps.size() - 1);
+}
+
+void RdmaQueuePairGroup::UpdatePgQps(void){
+	for (uint32_t i = 0; i < m_pgQps.size(); i++)
+		m_pgQps[i].clear();
+	for (uint32_t i = 0; i < m_qps.size(); i++)
+		m_pgQps[m_qps[i]->m_pg].push_back(i);
 }
 
 #if 0
@@ -229,6 +325,7 @@ void RdmaQueuePairGroup::AddRxQp(Ptr<RdmaRxQueuePair> rxQp){
 
 void RdmaQueuePairGroup::Clear(void){
 	m_qps.clear();
+	m_pgQps.clear();
 }
 
 }
@@ -9,6 +9,7 @@
 #include <ns3/custom-header.h>
 #include <ns3/int-header.h>
 #include <vector>
+#include <map>
 
 namespace ns3 {
 
@@ -33,13 +34,17 @@ public:
 	Time startTime;
 	Ipv4Address sip, dip;
 	uint16_t sport, dport;
+	uint32_t m_hash; // flow hash of (sip, dip, sport, dport), picks the NIC on multi-NIC hosts and the paths (FlowHashTag)
+	uint32_t m_rail; // the NIC (index in RdmaHw::m_nic) chosen when the qp starts, 0: by m_hash
+	uint16_t m_tenant; // tenant (job) of the flow, see TenantTag
 	// 队列对传输的数据大小    好像是传输数据的总大小
 	uint64_t m_size;
 	// 下一次要发送的序列号   未被确认的最高???序列号
 	uint64_t snd_nxt, snd_una; // next seq to send, the highest unacked seq
+	uint64_t snd_max; // the highest seq ever sent, to count retransmissions
 	//m_pg：    不同优先级队列
 	uint16_t m_pg; 
-	// uint16_t m_ipid;  IP数据包ID
+	uint16_t m_ipid; // IP数据包ID
 	uint32_t m_win; // bound of on-the-fly packets     当前窗口的大小，表示可以飞行的数据包数量。
 	uint64_t m_baseRtt; // base RTT of this qp
 	DataRate m_max_rate; // max rate
@@ -70,16 +75,18 @@ public:
 	struct {
 		uint32_t m_lastUpdateSeq;
 		DataRate m_curRate;
-		IntHop hop[IntHeader::maxHop]; //// 每跳
-		uint32_t keep[IntHeader::maxHop]; 
+		IntHop hop[IntHeader::hopCapacity]; //// 每跳
+		uint32_t keep[IntHeader::hopCapacity]; 
+		uint32_t intSlots; // INT slots reserved in data packets, with IntHeader::compact
+		std::vector<IntHop> pathHop; // with packet spraying, hop[] of each path, see RdmaHw::m_sprayPaths
+		std::vector<bool> pathValid;
 		uint32_t m_incStage;
 		double m_lastGap;
 		double u;       // // 初始化时为1   在rdma-queue-pair 
-		struct {
-			double u;     // 初始化时为1
-			DataRate Rc;
-			uint32_t incStage;
-		}hopState[IntHeader::maxHop];
+		// per hop state for per-hop R (RdmaHw::m_multipleRate), in arrays for the hop loops of RdmaHw::UpdateRateHp
+		double hopU[IntHeader::hopCapacity];     // 初始化时为1
+		uint64_t hopRc[IntHeader::hopCapacity]; // bps
+		uint32_t hopIncStage[IntHeader::hopCapacity];
 	} hp; //用于描述HPCC拥塞控制算法的状态
 	struct{
 		uint32_t m_lastUpdateSeq; //// 上次更新的序列号
@@ -101,6 +108,16 @@ public:
 		DataRate m_curRate;
 		uint32_t m_incStage;
 	}hpccPint;
+	struct{
+		DataRate m_rate; // the rate when the current stable phase started
+		uint32_t m_stable; // number of packets sent since then
+	}fluid; // hybrid fluid mode, see RdmaHw::GetPayloadSize
+	struct{
+		std::map<uint64_t, uint64_t> sacked; // [begin, end) above snd_una that the receiver has
+		std::map<uint64_t, uint64_t> retx; // [begin, end) to retransmit
+		uint64_t retxBytes;
+		uint64_t high; // the holes below it are already in retx in this round
+	}sr; // selective repeat, see RdmaHw::m_selectiveRepeat
 
 	/***********
 	 * methods
@@ -121,6 +138,10 @@ public:
 	uint64_t GetWin(); // window size calculated from m_rate
 	bool IsFinished();
 	uint64_t HpGetCurWin(); // window size calculated from hp.m_curRate, used by HPCC
+	// selective repeat: the receiver has [begin, end); queue the holes below it for retransmission.
+	// A NACK starts a new round, which also resends the lost retransmissions
+	void Sack(uint64_t begin, uint64_t end, bool nack);
+	uint32_t NextRetx(uint32_t mtu, uint64_t &seq); // take at most mtu bytes from the retransmit list
 };
 
 class RdmaRxQueuePair : public Object { // Rx side queue pair
@@ -138,18 +159,39 @@ public:
 	uint32_t sip, dip;  //源和目的 IP
 	uint16_t sport, dport;//端口号
 	uint16_t m_ipid; //用于标识ip数据包的 id   改：记录该qp对的发送数据包数量   rdma-hw.cc文件内中的getnxtpacket 代码
+	uint16_t m_tenant; // of the data packets, echoed by the ACKs
 	uint32_t ReceiverNextExpectedSeq; //即期待接收到的数据包序列号
 	Time m_nackTimer;  //负确认计时器（NACK Timer）用于跟踪丢包或未按期望接收到数据包
 	
 	//   rxQp->m_milestone_rx = m_ack_interval; ??名字和作用不清楚
 	int32_t m_milestone_rx; // 接收端的里程碑标记，可能用于标识接收到的某个数据包的状态。
 	uint32_t m_lastNACK; //最近一次发送的 NACK（负确认）的序列号
+	std::map<uint32_t, uint32_t> m_ooo; // selective repeat: [begin, end) received above ReceiverNextExpectedSeq
+	struct{
+		uint32_t n; // data packets not ACKed yet
+		uint8_t ecnbits;
+		uint16_t pg;
+		IntHeader ih;
+		uint16_t path;
+		EventId timer;
+	}m_ackAgg; // ACK coalescing, see RdmaHw::m_ackCoalesceCount
+	struct{
+		std::vector<uint64_t> bits; // packet seq / mtu -> received, as a ring of bits
+		uint32_t n; // packets in the buffer
+		uint32_t end; // end seq of the highest packet in the buffer
+		uint16_t pg, path;
+		IntHeader ih; // of the latest packet, for the NACK at the reorder timeout
+		EventId timer;
+	}m_rob; // reorder buffer, see RdmaHw::m_reorderBufSize
 	// 可能与 QCN（Quantized Congestion Notification）相关的机制有关
 	EventId QcnTimerEvent; // if destroy this rxQp, remember to cancel this timer 用于定时器事件
 
 	static TypeId GetTypeId (void);
 	RdmaRxQueuePair();
-	uint32_t GetHash(void);
+	uint32_t GetHash(void); // computed at the first call, after sip, dip, sport and dport are set
+private:
+	uint32_t m_hash;
+	bool m_hashValid;
 };
 
 
@@ -162,6 +204,7 @@ class RdmaQueuePairGroup : public Object {
 public:
 	// 用于存储指向 RdmaQueuePair 对象的智能指针 Ptr<RdmaQueuePair>。
 	std::vector<Ptr<RdmaQueuePair> > m_qps; 
+	std::vector<std::vector<uint32_t> > m_pgQps; // the indices in m_qps of the qps of each pg
 	
 	//std::vector<Ptr<RdmaRxQueuePair> > m_rxQps;
 
@@ -171,6 +214,7 @@ public:
 	Ptr<RdmaQueuePair> Get(uint32_t idx);
 	Ptr<RdmaQueuePair> operator[](uint32_t idx);  //重载 [] 运算符，与 Get 方法类似，通过索引 idx 返回队列对的智能指针
 	void AddQp(Ptr<RdmaQueuePair> qp);
+	void UpdatePgQps(void); // rebuild m_pgQps after m_qps is compacted
 	//void AddRxQp(Ptr<RdmaRxQueuePair> rxQp);
 	void Clear(void);
 };
@@ -35,13 +35,35 @@ namespace ns3 {
 		memset(ingress_bytes, 0, sizeof(ingress_bytes));
 		memset(paused, 0, sizeof(paused));
 		memset(egress_bytes, 0, sizeof(egress_bytes));
+
+		// service pools: by default one pool of the whole shared buffer, and all PGs lossless
+		for (uint32_t i = 0; i < qCnt; i++){
+			pg_pool[i] = 0;
+			lossless[i] = true;
+			egress_alpha[i] = 0;
+		}
+		for (uint32_t i = 0; i < poolCnt; i++){
+			pool_ratio[i] = i == 0 ? 1 : 0;
+			pool_size[i] = 0;
+			pool_used[i] = pool_hdrm[i] = 0;
+			pool_peak[i] = pool_hdrm_peak[i] = 0;
+			pool_drops[i] = 0;
+		}
+		memset(tenant_bytes, 0, sizeof(tenant_bytes));
+		memset(tenant_peak, 0, sizeof(tenant_peak));
+		memset(tenant_drops, 0, sizeof(tenant_drops));
+		memset(tenant_pauses, 0, sizeof(tenant_pauses));
+		total_hdrm = total_rsrv = 0;
 	}
 	bool SwitchMmu::CheckIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize){
 		// 判断新来的数据包 psize大小   加入到port的qindex队列 是否可以
+		if (!lossless[qIndex]) // lossy PGs are only limited at egress
+			return true;
 
 		//当前队列中 headroom 已用字节加上新的数据包是否超出了该端口的 headroom 限制
 		//   ??????
-		if (psize + hdrm_bytes[port][qIndex] > headroom[port] && psize + GetSharedUsed(port, qIndex) > GetPfcThreshold(port)){
+		if (psize + hdrm_bytes[port][qIndex] > headroom[port] && psize + GetSharedUsed(port, qIndex) > GetPfcThreshold(port, qIndex)){
+			pool_drops[pg_pool[qIndex]]++;
 			printf("%lu %u Drop: queue:%u,%u: Headroom full\n", Simulator::Now().GetTimeStep(), node_id, port, qIndex);
 			for (uint32_t i = 1; i < 64; i++)
 				printf("(%u,%u)", hdrm_bytes[i][3], ingress_bytes[i][3]);
@@ -51,9 +73,25 @@ namespace ns3 {
 		return true;
 	}
 	bool SwitchMmu::CheckEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize){
+		if (lossless[qIndex]) // paused by PFC at ingress instead
+			return true;
+		uint32_t pool = pg_pool[qIndex];
+		if (pool_used[pool] + psize > pool_size[pool]){
+			pool_drops[pool]++;
+			return false;
+		}
+		if (egress_alpha[qIndex] > 0 && egress_bytes[port][qIndex] + psize > egress_alpha[qIndex] * GetPoolFree(pool)){
+			pool_drops[pool]++;
+			return false;
+		}
 		return true;
 	}
 	void SwitchMmu::UpdateIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize){
+		if (!lossless[qIndex]){ // counted in the pool at egress
+			ingress_bytes[port][qIndex] += psize;
+			return;
+		}
+		uint32_t pool = pg_pool[qIndex];
 		uint32_t new_bytes = ingress_bytes[port][qIndex] + psize;
 		
 		//小于reserve    直接放保留区
@@ -62,22 +100,36 @@ namespace ns3 {
 			ingress_bytes[port][qIndex] += psize;
 		}else { //检查是否超出了 PFC 阈值 thres
 
-			uint32_t thresh = GetPfcThreshold(port);
+			uint32_t thresh = GetPfcThreshold(port, qIndex);
 
 			// 填满保留区后，剩余的数据包大小    大于阈值，则放入headroom
 			if (new_bytes - reserve > thresh){
 				hdrm_bytes[port][qIndex] += psize;
+				pool_hdrm[pool] += psize;
+				pool_hdrm_peak[pool] = std::max(pool_hdrm_peak[pool], pool_hdrm[pool]);
 			}else {
 				// 否则，填满保留区后,放入共享缓冲区
 				ingress_bytes[port][qIndex] += psize;
-				shared_used_bytes += std::min(psize, new_bytes - reserve);
+				uint32_t shared = std::min(psize, new_bytes - reserve);
+				shared_used_bytes += shared;
+				pool_used[pool] += shared;
+				pool_peak[pool] = std::max(pool_peak[pool], pool_used[pool]);
 			}
 		}
 	}
 	void SwitchMmu::UpdateEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize){
 		egress_bytes[port][qIndex] += psize;
+		if (!lossless[qIndex]){
+			uint32_t pool = pg_pool[qIndex];
+			pool_used[pool] += psize;
+			pool_peak[pool] = std::max(pool_peak[pool], pool_used[pool]);
+		}
 	}
 	void SwitchMmu::RemoveFromIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize){
+		if (!lossless[qIndex]){
+			ingress_bytes[port][qIndex] -= psize;
+			return;
+		}
 		// 优先从headroom 缓冲区中 删除
 		uint32_t from_hdrm = std::min(hdrm_bytes[port][qIndex], psize);
 		// 接着 要从共享缓冲区中扣除的字节数。   
@@ -86,14 +138,25 @@ namespace ns3 {
 		hdrm_bytes[port][qIndex] -= from_hdrm;
 		ingress_bytes[port][qIndex] -= psize - from_hdrm;
 		shared_used_bytes -= from_shared;
+		pool_hdrm[pg_pool[qIndex]] -= from_hdrm;
+		pool_used[pg_pool[qIndex]] -= from_shared;
 	}
 	void SwitchMmu::RemoveFromEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize){
 		egress_bytes[port][qIndex] -= psize;
+		if (!lossless[qIndex])
+			pool_used[pg_pool[qIndex]] -= psize;
+	}
+	void SwitchMmu::UpdateTenant(uint32_t tenant, uint32_t psize){
+		tenant_bytes[tenant] += psize;
+		tenant_peak[tenant] = std::max(tenant_peak[tenant], tenant_bytes[tenant]);
+	}
+	void SwitchMmu::RemoveFromTenant(uint32_t tenant, uint32_t psize){
+		tenant_bytes[tenant] -= psize;
 	}
 	bool SwitchMmu::CheckShouldPause(uint32_t port, uint32_t qIndex){
 		//   ??????
 		// ????headromm不为空     或者  shared_used_bytes >= PFC阈值   GetPfcThreshold(port)  
-		return !paused[port][qIndex] && (hdrm_bytes[port][qIndex] > 0 || GetSharedUsed(port, qIndex) >= GetPfcThreshold(port));
+		return lossless[qIndex] && !paused[port][qIndex] && (hdrm_bytes[port][qIndex] > 0 || GetSharedUsed(port, qIndex) >= GetPfcThreshold(port, qIndex));
 		// uint32_t used = ingress_bytes[port][qIndex];
 		// used - reserve >= GetPfcThreshold(port)
 		//return (buffer_size - total_hdrm - total_rsrv - shared_used_bytes) >> pfc_a_shift[port];
@@ -107,7 +170,7 @@ namespace ns3 {
 		uint32_t shared_used = GetSharedUsed(port, qIndex);
 		//hdrm_bytes[port][qIndex] 表示每个端口和队列使用的“headroom”字节数,为处理突发流量而保留的额外缓冲空间
 		//  
-		return hdrm_bytes[port][qIndex] == 0 && (shared_used == 0 || shared_used + resume_offset <= GetPfcThreshold(port));  
+		return hdrm_bytes[port][qIndex] == 0 && (shared_used == 0 || shared_used + resume_offset <= GetPfcThreshold(port, qIndex));  
 	}
 	void SwitchMmu::SetPause(uint32_t port, uint32_t qIndex){
 		paused[port][qIndex] = true;
@@ -116,9 +179,13 @@ namespace ns3 {
 		paused[port][qIndex] = false;
 	}
 
-	uint32_t SwitchMmu::GetPfcThreshold(uint32_t port){
+	uint32_t SwitchMmu::GetPfcThreshold(uint32_t port, uint32_t qIndex){
 		//??????
-		return (buffer_size - total_hdrm - total_rsrv - shared_used_bytes) >> pfc_a_shift[port];
+		uint32_t pool = pg_pool[qIndex];
+		return GetPoolFree(pool) >> pfc_a_shift[port];
+	}
+	uint32_t SwitchMmu::GetPoolFree(uint32_t pool){
+		return pool_used[pool] < pool_size[pool] ? pool_size[pool] - pool_used[pool] : 0;
 	}
 	uint32_t SwitchMmu::GetSharedUsed(uint32_t port, uint32_t qIndex){
 		uint32_t used = ingress_bytes[port][qIndex];
@@ -156,8 +223,27 @@ namespace ns3 {
 			total_hdrm += headroom[i];  ///   ?????   难道只有一个队列吗？？
 			total_rsrv += reserve;
 		}
+		UpdatePoolSize();
 	}
 	void SwitchMmu::ConfigBufferSize(uint32_t size){
 		buffer_size = size;
+		UpdatePoolSize();
+	}
+	void SwitchMmu::ConfigPool(uint32_t pool, double ratio){
+		NS_ASSERT_MSG(pool < poolCnt, "SwitchMmu::ConfigPool: pool out of range");
+		pool_ratio[pool] = ratio;
+		UpdatePoolSize();
+	}
+	void SwitchMmu::ConfigPg(uint32_t pg, uint32_t pool, bool _lossless, double alpha){
+		NS_ASSERT_MSG(pg < qCnt && pool < poolCnt, "SwitchMmu::ConfigPg: PG or pool out of range");
+		NS_ASSERT_MSG(!_lossless || alpha == 0, "SwitchMmu::ConfigPg: a lossless PG has no egress threshold");
+		pg_pool[pg] = pool;
+		lossless[pg] = _lossless;
+		egress_alpha[pg] = alpha;
+	}
+	void SwitchMmu::UpdatePoolSize(){
+		uint32_t shared = buffer_size - total_hdrm - total_rsrv;
+		for (uint32_t i = 0; i < poolCnt; i++)
+			pool_size[i] = pool_ratio[i] == 1 ? shared : (uint32_t)(shared * pool_ratio[i]);
 	}
 }
@@ -16,6 +16,8 @@ class SwitchMmu: public Object{
 public:
 	static const uint32_t pCnt = 257;	// Number of ports used 交换机支持的端口数量（257个）
 	static const uint32_t qCnt = 8;	// Number of queues/priorities used 每个端口使用的队列/优先级数量
+	static const uint32_t poolCnt = 4; // Number of service pools
+	static const uint32_t tCnt = 16; // Number of tenants with their own accounting, see TenantTag
 
 	static TypeId GetTypeId (void);
 
@@ -34,6 +36,9 @@ public:
 	void RemoveFromIngressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize);
 	// 出口（Egress）流量控制中移除数据包（psize）
 	void RemoveFromEgressAdmission(uint32_t port, uint32_t qIndex, uint32_t psize);
+	// bytes of the tenant admitted to, or removed from, the buffer
+	void UpdateTenant(uint32_t tenant, uint32_t psize);
+	void RemoveFromTenant(uint32_t tenant, uint32_t psize);
 
 	// 检查指定端口和队列是否应该发送 PFC 暂停帧。
 	bool CheckShouldPause(uint32_t port, uint32_t qIndex);
@@ -48,7 +53,8 @@ public:
 	//void GetPauseClasses(uint32_t port, uint32_t qIndex);
 	//bool GetResumeClasses(uint32_t port, uint32_t qIndex);
 
-	uint32_t GetPfcThreshold(uint32_t port);  //获取指定端口的 PFC 阈值。
+	uint32_t GetPfcThreshold(uint32_t port, uint32_t qIndex);  //获取指定端口的 PFC 阈值。
+	uint32_t GetPoolFree(uint32_t pool); // free shared bytes of the service pool
 	uint32_t GetSharedUsed(uint32_t port, uint32_t qIndex); //获取共享缓冲区指定端口和队列的已使用字节数。
 
 	bool ShouldSendCN(uint32_t ifindex, uint32_t qIndex);  //：检查是否应该发送拥塞通知	（CN）。
@@ -62,6 +68,11 @@ public:
 	void ConfigNPort(uint32_t n_port);
 	// 配置交换机的缓冲区总大小。
 	void ConfigBufferSize(uint32_t size);
+	// the service pool gets ratio of the shared buffer (the buffer without headroom and reserve)
+	void ConfigPool(uint32_t pool, double ratio);
+	// the PG uses the service pool; a lossless PG has PFC and headroom, a lossy PG is dropped when its pool is full.
+	// alpha > 0 limits each egress queue of a lossy PG to alpha * the free bytes of its pool (dynamic threshold)
+	void ConfigPg(uint32_t pg, uint32_t pool, bool _lossless, double alpha);
 
 	// config
 	uint32_t node_id; //交换机节点的唯一标识符。
@@ -77,6 +88,11 @@ public:
 	double pmax[pCnt];
 	uint32_t total_hdrm; //总缓冲区 headroom
 	uint32_t total_rsrv; //总保留缓冲区。
+	uint32_t pg_pool[qCnt]; // service pool of each PG
+	bool lossless[qCnt];
+	double egress_alpha[qCnt]; // 0: no egress threshold
+	double pool_ratio[poolCnt];
+	uint32_t pool_size[poolCnt]; // shared bytes of each pool
 
 	// runtime
 	uint32_t shared_used_bytes;  //交换机当前使用的共享缓冲区大小
@@ -84,6 +100,18 @@ public:
 	uint32_t ingress_bytes[pCnt][qCnt]; //每个端口和队列在入口方向使用的字节数。
 	uint32_t paused[pCnt][qCnt];  //标记端口和队列的暂停状态
 	uint32_t egress_bytes[pCnt][qCnt]; //每个端口和队列在出口方向使用的字节数。
+	// per pool: the shared bytes of lossless PGs (at ingress) and all bytes of lossy PGs (at egress),
+	// the headroom bytes of lossless PGs, their peaks, and the packets dropped at ingress or egress
+	uint32_t pool_used[poolCnt], pool_hdrm[poolCnt];
+	uint32_t pool_peak[poolCnt], pool_hdrm_peak[poolCnt];
+	uint64_t pool_drops[poolCnt];
+	// per tenant, when the switch counts tenants: the bytes in the buffer (PGs other than 0) and their peak,
+	// the packets dropped, and the PFC pauses sent when a packet of the tenant was admitted
+	uint32_t tenant_bytes[tCnt], tenant_peak[tCnt];
+	uint64_t tenant_drops[tCnt], tenant_pauses[tCnt];
+
+private:
+	void UpdatePoolSize();
 };
 
 } /* namespace ns3 */
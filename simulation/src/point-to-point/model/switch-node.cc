@@ -1,4 +1,5 @@
 #include "ns3/ipv4.h"
+#include "ns3/simulator.h"
 #include "ns3/packet.h"
 #include "ns3/ipv4-header.h"
 #include "ns3/pause-header.h"
@@ -10,6 +11,8 @@
 #include "qbb-net-device.h"
 #include "ppp-header.h"
 #include "ns3/int-header.h"
+#include "tenant-tag.h"
+#include "flow-hash-tag.h"
 #include <cmath>
 
 namespace ns3 {
@@ -39,6 +42,26 @@ TypeId SwitchNode::GetTypeId (void)
 			UintegerValue(9000),
 			MakeUintegerAccessor(&SwitchNode::m_maxRtt),
 			MakeUintegerChecker<uint32_t>())
+	.AddAttribute("RoutingMode",
+			"Routing of data packets among ECMP next hops. 0: ECMP, 1: flowlet, 2: DRILL, 3: CONGA (local), 4: spray",
+			UintegerValue(ROUTE_ECMP),
+			MakeUintegerAccessor(&SwitchNode::m_routingMode),
+			MakeUintegerChecker<uint32_t>(0, 4))
+	.AddAttribute("FlowletTimeout",
+			"Gap (ns) that starts a new flowlet",
+			UintegerValue(5000),
+			MakeUintegerAccessor(&SwitchNode::m_flowletTimeout),
+			MakeUintegerChecker<uint64_t>())
+	.AddAttribute("DreTau",
+			"Time constant (ns) of the DRE of the CONGA mode",
+			UintegerValue(40000),
+			MakeUintegerAccessor(&SwitchNode::m_dreTau),
+			MakeUintegerChecker<uint64_t>(1))
+	.AddAttribute("TenantStats",
+			"Count the tx bytes, buffer bytes, drops and PFC pauses of each tenant",
+			BooleanValue(false),
+			MakeBooleanAccessor(&SwitchNode::m_tenantStats),
+			MakeBooleanChecker())
   ;
   return tid;
 }
@@ -56,59 +79,139 @@ SwitchNode::SwitchNode(){
 				m_bytes[i][j][k] = 0;
 	for (uint32_t i = 0; i < pCnt; i++)
 		m_txBytes[i] = 0;  //每个端口的传输字节计数。
+	for (uint32_t i = 0; i < SwitchMmu::tCnt; i++)
+		m_tenantTxBytes[i] = 0;
 	for (uint32_t i = 0; i < pCnt; i++)
 		//记录每个端口最近包的大小。     记录每个端口最近包的时间戳
 		m_lastPktSize[i] = m_lastPktTs[i] = 0;
 	for (uint32_t i = 0; i < pCnt; i++)
 		//????
 		m_u[i] = 0;  //每个端口的拥塞控制参数。
+	for (uint32_t i = 0; i < pCnt; i++){
+		m_dre[i] = 0;
+		m_dreTs[i] = 0;
+	}
+	m_drillRr = 0;
+	m_nFlowlet = m_nReroute = 0;
 }
 
 int SwitchNode::GetOutDev(Ptr<const Packet> p, CustomHeader &ch){
 	// look up entries   路由表查目的ip
-	auto entry = m_bytes.find(ch.dip);  
+	uint32_t id = HostId(ch.dip);
 
 	// no matching entry
-	if (entry == m_rtTable.end())
+	if (!IsHostIp(ch.dip) || id >= m_fib.size() || m_fib[id].empty())
 		return -1;
 
 	// entry found
-	//std::unordered_map<uint32_t, std::vector<int> > m_rtTable; 
-	//这些端口代表该目的 IP 可以通过的多个路径。等成本 ??
-	auto &nexthops = entry->second;
-
-	// pick one next hop based on hash
-	union {
-		uint8_t u8[4+4+2+2]; //12个字节
-		uint32_t u32[3];     //3个 4zijie
-	} buf;
-	buf.u32[0] = ch.sip;
-	buf.u32[1] = ch.dip;
-	if (ch.l3Prot == 0x6)  // TCP
-		// TCP 的源端口和目的端口
-		buf.u32[2] = ch.tcp.sport | ((uint32_t)ch.tcp.dport << 16);
-	else if (ch.l3Prot == 0x11) // UDP
-		buf.u32[2] = ch.udp.sport | ((uint32_t)ch.udp.dport << 16);
-	else if (ch.l3Prot == 0xFC || ch.l3Prot == 0xFD) // 特殊协议 // ACK or NACK
-		buf.u32[2] = ch.ack.sport | ((uint32_t)ch.ack.dport << 16);
+	//这些端口代表该目的 IP 可以通过的多个路径。
+	const std::vector<uint16_t> &nexthops = m_fib[id];
+	if (nexthops.size() == 1)
+		return nexthops[0];
 
-	// union {
-	// 	uint8_t u8[4+4+2+2]; //12个字节
-	// 	uint32_t u32[3];     //3个 4zijie
-	// } buf;
-	uint32_t idx = EcmpHash(buf.u8, 12, m_ecmpSeed) % nexthops.size();
+	// pick one next hop based on hash; the hash of the flow is carried by the packet if the sender is a QP
+	uint32_t hash;
+	FlowHashTag fht;
+	if (p->PeekPacketTag(fht))
+		hash = MixHash(fht.GetHash(), m_ecmpSeed);
+	else {
+		union {
+			uint8_t u8[4+4+2+2]; //12个字节
+			uint32_t u32[3];     //3个 4zijie
+		} buf;
+		buf.u32[0] = ch.sip;
+		buf.u32[1] = ch.dip;
+		if (ch.l3Prot == 0x6)  // TCP
+			// TCP 的源端口和目的端口
+			buf.u32[2] = ch.tcp.sport | ((uint32_t)ch.tcp.dport << 16);
+		else if (ch.l3Prot == 0x11) // UDP
+			buf.u32[2] = ch.udp.sport | ((uint32_t)ch.udp.dport << 16);
+		else if (ch.l3Prot == 0xFC || ch.l3Prot == 0xFD) // 特殊协议 // ACK or NACK
+			buf.u32[2] = ch.ack.sport | ((uint32_t)ch.ack.dport << 16);
+		else
+			buf.u32[2] = 0;
+		hash = EcmpHash(buf.u8, 12, m_ecmpSeed);
+	}
+	// only data packets are routed adaptively
+	if (m_routingMode != ROUTE_ECMP && ch.l3Prot == 0x11)
+		return GetAdaptiveOutDev(nexthops, hash, ch);
+	uint32_t idx = hash % nexthops.size();
 	
 	return nexthops[idx];
 }
 
-void SwitchNode::CheckAndSendPfc(uint32_t inDev, uint32_t qIndex){
+int SwitchNode::GetAdaptiveOutDev(const std::vector<uint16_t> &nexthops, uint32_t hash, CustomHeader &ch){
+	uint32_t n = nexthops.size();
+	if (m_routingMode == ROUTE_SPRAY)
+		return nexthops[EcmpHash((const uint8_t*)&ch.ipid, 2, hash) % n];
+	if (m_routingMode == ROUTE_DRILL){
+		uint32_t start = hash + m_drillRr++;
+		uint32_t best = nexthops[start % n];
+		for (uint32_t i = 1; i < n; i++){
+			uint32_t port = nexthops[(start + i) % n];
+			if (m_mmu->egress_bytes[port][ch.udp.pg] < m_mmu->egress_bytes[best][ch.udp.pg])
+				best = port;
+		}
+		return best;
+	}
+
+	// flowlet and CONGA
+	if (m_flowlet.empty())
+		m_flowlet.resize(flowletTableSize, Flowlet{0, 0, 0, 0});
+	uint64_t now = Simulator::Now().GetTimeStep();
+	Flowlet &f = m_flowlet[hash & (flowletTableSize - 1)];
+	if (f.hash == hash && now - f.last < m_flowletTimeout){
+		f.last = now;
+		return f.port;
+	}
+	// a new flowlet
+	uint32_t port;
+	if (m_routingMode == ROUTE_FLOWLET){
+		port = nexthops[EcmpHash((const uint8_t*)&f.n, 4, hash) % n];
+	}else {
+		port = nexthops[hash % n];
+		double best = GetDre(port) / DynamicCast<QbbNetDevice>(m_devices[port])->GetDataRate().GetBitRate();
+		for (uint32_t i = 1; i < n; i++){
+			uint32_t p = nexthops[(hash + i) % n];
+			double u = GetDre(p) / DynamicCast<QbbNetDevice>(m_devices[p])->GetDataRate().GetBitRate();
+			if (u < best){
+				best = u;
+				port = p;
+			}
+		}
+	}
+	m_nFlowlet++;
+	if (f.hash == hash && port != f.port)
+		m_nReroute++;
+	f.hash = hash;
+	f.port = port;
+	f.n++;
+	f.last = now;
+	return port;
+}
+
+double SwitchNode::GetDre(uint32_t port){
+	uint64_t now = Simulator::Now().GetTimeStep();
+	m_dre[port] *= exp(-(double)(now - m_dreTs[port]) / m_dreTau);
+	m_dreTs[port] = now;
+	return m_dre[port];
+}
+
+uint32_t SwitchNode::GetTenant(Ptr<const Packet> p){
+	TenantTag t;
+	return p->PeekPacketTag(t) ? t.GetTenant() : 0;
+}
+
+bool SwitchNode::CheckAndSendPfc(uint32_t inDev, uint32_t qIndex){
 	//输入设备（端口）的索引   
 	//////// ?????????   my_devices 是哪个文件的 ??
 	Ptr<QbbNetDevice> device = DynamicCast<QbbNetDevice>(m_devices[inDev]); 
 	if (m_mmu->CheckShouldPause(inDev, qIndex)){  // 是否暂停流量
 		device->SendPfc(qIndex, 0); 
 		m_mmu->SetPause(inDev, qIndex);
+		return true;
 	}
+	return false;
 }
 
 void SwitchNode::CheckAndSendResume(uint32_t inDev, uint32_t qIndex){
@@ -147,6 +250,7 @@ void SwitchNode::SendToDev(Ptr<Packet>p, CustomHeader &ch){
 		p->PeekPacketTag(t);
 		////   ??????
 		uint32_t inDev = t.GetFlowId();  //????怎么确定是端口
+		uint32_t tenant = m_tenantStats ? GetTenant(p) : 0;
 		
 		if (qIndex != 0){ //not highest priority
 			// 判断能否入队列
@@ -154,9 +258,14 @@ void SwitchNode::SendToDev(Ptr<Packet>p, CustomHeader &ch){
 				m_mmu->UpdateIngressAdmission(inDev, qIndex, p->GetSize());
 				m_mmu->UpdateEgressAdmission(idx, qIndex, p->GetSize());
 			}else{
+				if (m_tenantStats)
+					m_mmu->tenant_drops[tenant]++;
 				return; // Drop
 			}
-			CheckAndSendPfc(inDev, qIndex); // 是否需要发送pfc
+			if (m_tenantStats)
+				m_mmu->UpdateTenant(tenant, p->GetSize());
+			if (CheckAndSendPfc(inDev, qIndex) && m_tenantStats) // 是否需要发送pfc
+				m_mmu->tenant_pauses[tenant]++;
 		}
 		m_bytes[inDev][idx][qIndex] += p->GetSize();
 
@@ -217,11 +326,18 @@ void SwitchNode::SetEcmpSeed(uint32_t seed){
 
 void SwitchNode::AddTableEntry(Ipv4Address &dstAddr, uint32_t intf_idx){
 	uint32_t dip = dstAddr.Get();
-	m_rtTable[dip].push_back(intf_idx);  /// vector 中 添加
+	NS_ASSERT_MSG(IsHostIp(dip), "SwitchNode::AddTableEntry: the destination is not a host ip");
+	uint32_t id = HostId(dip);
+	if (id >= m_fib.size())
+		m_fib.resize(id + 1);
+	m_fib[id].push_back(intf_idx);  /// vector 中 添加
 }
 
 void SwitchNode::ClearTable(){
-	m_rtTable.clear();
+	for (uint32_t i = 0; i < m_fib.size(); i++)
+		m_fib[i].clear();
+	// the next hops of a flowlet may be gone
+	m_flowlet.clear();
 }
 
 // This function can only be called in switch mode
@@ -234,12 +350,15 @@ bool SwitchNode::SwitchReceiveFromDevice(Ptr<NetDevice> device, Ptr<Packet> pack
 void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Packet> p){
 	FlowIdTag t;
 	p->PeekPacketTag(t);
+	uint32_t tenant = m_tenantStats ? GetTenant(p) : 0;
 	if (qIndex != 0){
 		// ????? t.GetFlowId()为什么是入口流
 		uint32_t inDev = t.GetFlowId();
 		/// 队列减少
 		m_mmu->RemoveFromIngressAdmission(inDev, qIndex, p->GetSize());
 		m_mmu->RemoveFromEgressAdmission(ifIndex, qIndex, p->GetSize());
+		if (m_tenantStats)
+			m_mmu->RemoveFromTenant(tenant, p->GetSize());
 		m_bytes[inDev][ifIndex][qIndex] -= p->GetSize();
 		if (m_ecnEnabled){
 			//    此时判断出口队列  是否在kmin-kmax, 是否需要发送ecn， 
@@ -267,7 +386,7 @@ void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Pack
 			IntHeader *ih = (IntHeader*)&buf[PppHeader::GetStaticSize() + 20 + 8 + 6]; // ppp, ip, udp, SeqTs, INT
 			Ptr<QbbNetDevice> dev = DynamicCast<QbbNetDevice>(m_devices[ifIndex]);
 			if (m_ccMode == 3){ // HPCC
-				ih->PushHop(Simulator::Now().GetTimeStep(), m_txBytes[ifIndex], dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
+				IntHeader::PushHop((uint8_t*)ih, Simulator::Now().GetTimeStep(), m_txBytes[ifIndex], dev->GetQueue()->GetNBytesTotal(), dev->GetDataRate().GetBitRate());
 			}else if (m_ccMode == 10){ // HPCC-PINT    PINT逻辑代码    
 				uint64_t t = Simulator::Now().GetTimeStep();
 				uint64_t dt = t - m_lastPktTs[ifIndex];
@@ -346,6 +465,10 @@ void SwitchNode::SwitchNotifyDequeue(uint32_t ifIndex, uint32_t qIndex, Ptr<Pack
 		}
 	}
 	m_txBytes[ifIndex] += p->GetSize();
+	if (m_tenantStats)
+		m_tenantTxBytes[tenant] += p->GetSize();
+	if (m_routingMode == ROUTE_CONGA)
+		m_dre[ifIndex] = GetDre(ifIndex) + p->GetSize();
 	m_lastPktSize[ifIndex] = p->GetSize();
 	m_lastPktTs[ifIndex] = Simulator::Now().GetTimeStep();
 }
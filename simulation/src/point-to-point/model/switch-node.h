@@ -1,7 +1,7 @@
 #ifndef SWITCH_NODE_H
 #define SWITCH_NODE_H
 
-#include <unordered_map>
+#include <vector>
 #include <ns3/node.h>
 #include "qbb-net-device.h"
 #include "switch-mmu.h"
@@ -15,7 +15,8 @@ class SwitchNode : public Node{
 	static const uint32_t pCnt = 257;	// Number of ports used 交换机的端口数量。
 	static const uint32_t qCnt = 8;		// Number of queues/priorities used 每个端口的队列数量或优先级数量。
 	uint32_t m_ecmpSeed; 				//   ECMP（等成本多路径）路由的随机种子。
-	std::unordered_map<uint32_t, std::vector<int> > m_rtTable; // map from ip address (u32) to possible ECMP port (index of dev)  				路由表，存储 IP 地址到可能的端口索引的映射。
+	// dense FIB: m_fib[id] is the possible ECMP ports (index of dev) to the host of node id, whose ip is HostIp(id)
+	std::vector<std::vector<uint16_t> > m_fib;
 
 	// monitor of PFC
 	uint32_t m_bytes[pCnt][pCnt][qCnt]; // m_bytes[inDev][outDev][qidx] is the bytes from inDev enqueued for outDev at qidx                   ：用于监控从输入设备到输出设备在特定队列中的字节数。
@@ -26,6 +27,19 @@ class SwitchNode : public Node{
 	uint64_t m_lastPktTs[pCnt]; 	// ns 记录每个端口最近包的时间戳（以纳秒为单位）。
 	double m_u[pCnt];   			//用于监控或流量管理的其他参数
 
+	// adaptive routing of data packets, see RoutingMode
+	struct Flowlet{
+		uint32_t hash; // flow hash, 0: empty
+		uint32_t port;
+		uint32_t n; // number of flowlets seen in this entry
+		uint64_t last; // ns, last packet
+	};
+	static const uint32_t flowletTableSize = 4096;
+	std::vector<Flowlet> m_flowlet; // direct-mapped by flow hash
+	double m_dre[pCnt]; // CONGA's discounting rate estimator: bytes sent, decayed with m_dreTau
+	uint64_t m_dreTs[pCnt];
+	uint32_t m_drillRr; // rotates the tie breaking of DRILL
+
 protected:
 	bool m_ecnEnabled;    //指示是否启用 ECN（显式拥塞通知）。
 	uint32_t m_ccMode;    //拥塞控制模式。
@@ -33,14 +47,46 @@ protected:
 
 	uint32_t m_ackHighPrio; // set high priority for ACK/NACK  设置 ACK/NACK 的高优先级
 
+	uint32_t m_routingMode;
+	uint64_t m_flowletTimeout; // ns
+	uint64_t m_dreTau; // ns
+	bool m_tenantStats; // count the bytes, drops and pauses of each tenant, see TenantTag
+
 private:
 	int GetOutDev(Ptr<const Packet>, CustomHeader &ch); 		//确定输出设备。
 	void SendToDev(Ptr<Packet>p, CustomHeader &ch); 			//将包发送到设备。
 	static uint32_t EcmpHash(const uint8_t* key, size_t len, uint32_t seed); //计算 ECMP 哈希值
-	void CheckAndSendPfc(uint32_t inDev, uint32_t qIndex);  //检查并发送 PFC（优先级流量控制）信号。
+	// mixes the flow hash carried by the packet (FlowHashTag) with the seed, so each switch picks differently
+	static uint32_t MixHash(uint32_t hash, uint32_t seed){
+		hash = (hash ^ seed) * 0x9e3779b1;
+		hash ^= hash >> 16;
+		hash *= 0x85ebca6b;
+		hash ^= hash >> 13;
+		return hash;
+	}
+	// hosts are 11.x.y.1, where x.y is the node id
+	static bool IsHostIp(uint32_t ip){
+		return (ip & 0xff0000ff) == 0x0b000001;
+	}
+	static uint32_t HostId(uint32_t ip){
+		return (ip >> 8) & 0xffff;
+	}
+	int GetAdaptiveOutDev(const std::vector<uint16_t> &nexthops, uint32_t hash, CustomHeader &ch);
+	double GetDre(uint32_t port);
+	static uint32_t GetTenant(Ptr<const Packet> p);
+	bool CheckAndSendPfc(uint32_t inDev, uint32_t qIndex);  //检查并发送 PFC（优先级流量控制）信号。 returns if a pause is sent
 	void CheckAndSendResume(uint32_t inDev, uint32_t qIndex);   //检查并发送恢复信号。
 public:
+	enum RoutingMode{
+		ROUTE_ECMP = 0, // per-flow hash
+		ROUTE_FLOWLET = 1, // LetFlow: a flowlet after a gap of FlowletTimeout takes a random next hop
+		ROUTE_DRILL = 2, // per packet, the next hop with the least egress bytes at the packet's priority
+		ROUTE_CONGA = 3, // a flowlet takes the next hop with the least local DRE utilization
+		ROUTE_SPRAY = 4 // per-packet hash of the flow and the IP identification, i.e., the path set by a spraying NIC
+	};
 	Ptr<SwitchMmu> m_mmu;
+	uint64_t m_nFlowlet, m_nReroute; // new flowlets, and those that changed the next hop
+	uint64_t m_tenantTxBytes[SwitchMmu::tCnt]; // tx bytes of each tenant, with TenantStats
 
 	static TypeId GetTypeId (void);
 	SwitchNode();
@@ -0,0 +1,54 @@
+#include "tenant-tag.h"
+
+namespace ns3 {
+
+NS_OBJECT_ENSURE_REGISTERED (TenantTag);
+
+TypeId TenantTag::GetTypeId (void)
+{
+	static TypeId tid = TypeId ("ns3::TenantTag")
+		.SetParent<Tag> ()
+		.AddConstructor<TenantTag> ()
+		;
+	return tid;
+}
+
+TypeId TenantTag::GetInstanceTypeId (void) const
+{
+	return GetTypeId ();
+}
+
+uint32_t TenantTag::GetSerializedSize (void) const
+{
+	return 2;
+}
+
+void TenantTag::Serialize (TagBuffer buf) const
+{
+	buf.WriteU16 (m_tenant);
+}
+
+void TenantTag::Deserialize (TagBuffer buf)
+{
+	m_tenant = buf.ReadU16 ();
+}
+
+void TenantTag::Print (std::ostream &os) const
+{
+	os << "Tenant=" << m_tenant;
+}
+
+TenantTag::TenantTag () : m_tenant (0)
+{
+}
+
+TenantTag::TenantTag (uint16_t tenant) : m_tenant (tenant)
+{
+}
+
+uint16_t TenantTag::GetTenant (void) const
+{
+	return m_tenant;
+}
+
+} /* namespace ns3 */
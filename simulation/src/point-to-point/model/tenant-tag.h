@@ -0,0 +1,31 @@
+#ifndef TENANT_TAG_H
+#define TENANT_TAG_H
+
+#include "ns3/tag.h"
+
+namespace ns3 {
+
+/*
+ * The tenant (job) of a packet, for the per-tenant accounting of the switches.
+ * Only the packets of a tenant > 0 carry it; an untagged packet is of tenant 0.
+ * The ACKs of a flow carry the tenant of its data packets.
+ */
+class TenantTag : public Tag{
+public:
+	static TypeId GetTypeId (void);
+	virtual TypeId GetInstanceTypeId (void) const;
+	virtual uint32_t GetSerializedSize (void) const;
+	virtual void Serialize (TagBuffer buf) const;
+	virtual void Deserialize (TagBuffer buf);
+	virtual void Print (std::ostream &os) const;
+	TenantTag ();
+	TenantTag (uint16_t tenant);
+	uint16_t GetTenant (void) const;
+
+private:
+	uint16_t m_tenant;
+};
+
+} /* namespace ns3 */
+
+#endif /* TENANT_TAG_H */
@@ -0,0 +1,177 @@
+#include "ns3/test.h"
+#include "ns3/packet.h"
+#include "ns3/custom-header.h"
+#include "ns3/int-header.h"
+#include "ns3/seq-ts-header.h"
+#include "ns3/udp-header.h"
+#include "ns3/ipv4-header.h"
+#include "ns3/ppp-header.h"
+#include "ns3/qbb-header.h"
+#include <vector>
+#include <algorithm>
+
+namespace ns3 {
+
+// Parses a packet built as RdmaHw does with CustomHeader, then serializes the CustomHeader
+// into a new packet, which must have the same bytes.
+class CustomHeaderTest : public TestCase
+{
+public:
+  CustomHeaderTest ();
+
+  virtual void DoRun (void);
+
+private:
+  static IntHeader MakeInt (uint16_t nhop);
+  static void AddL3L2 (Ptr<Packet> p, uint8_t protocol);
+  void CheckRoundTrip (Ptr<Packet> p, uint32_t payload, CustomHeader &ch);
+  void TestUdp (void);
+  void TestAck (bool sack);
+};
+
+CustomHeaderTest::CustomHeaderTest ()
+  : TestCase ("CustomHeader serializes UDP and ACK packets as parsed")
+{
+}
+
+IntHeader
+CustomHeaderTest::MakeInt (uint16_t nhop)
+{
+  IntHeader ih;
+  for (uint16_t j = 0; j < nhop; j++)
+    ih.hop[j].v = 0x0123456789abcdefull + j;
+  ih.nhop = nhop;
+  return ih;
+}
+
+void
+CustomHeaderTest::AddL3L2 (Ptr<Packet> p, uint8_t protocol)
+{
+  Ipv4Header ipHeader;
+  ipHeader.SetSource (Ipv4Address (0x0b000101));
+  ipHeader.SetDestination (Ipv4Address (0x0b000201));
+  ipHeader.SetProtocol (protocol);
+  ipHeader.SetPayloadSize (p->GetSize ());
+  ipHeader.SetTtl (64);
+  ipHeader.SetIdentification (7);
+  p->AddHeader (ipHeader);
+  PppHeader ppp;
+  ppp.SetProtocol (0x0021);
+  p->AddHeader (ppp);
+}
+
+void
+CustomHeaderTest::CheckRoundTrip (Ptr<Packet> p, uint32_t payload, CustomHeader &ch)
+{
+  ch.brief = 0; // all the fields, which Serialize writes
+  ch.getInt = 1;
+  p->PeekHeader (ch);
+  Ptr<Packet> q = Create<Packet> (payload);
+  q->AddHeader (ch);
+  NS_TEST_ASSERT_MSG_EQ (q->GetSize (), p->GetSize (), "size after the round trip");
+  std::vector<uint8_t> a (p->GetSize ()), b (q->GetSize ());
+  p->CopyData (&a[0], a.size ());
+  q->CopyData (&b[0], b.size ());
+  NS_TEST_ASSERT_MSG_EQ ((a == b), true, "bytes after the round trip");
+
+  CustomHeader ch2 (CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
+  ch2.brief = 0;
+  q->PeekHeader (ch2);
+  NS_TEST_ASSERT_MSG_EQ (ch2.sip, ch.sip, "sip");
+  NS_TEST_ASSERT_MSG_EQ (ch2.dip, ch.dip, "dip");
+  NS_TEST_ASSERT_MSG_EQ (ch2.l3Prot, ch.l3Prot, "protocol");
+}
+
+void
+CustomHeaderTest::TestUdp (void)
+{
+  uint32_t payload = 1000;
+  Ptr<Packet> p = Create<Packet> (payload);
+  SeqTsHeader seqTs;
+  seqTs.SetSeq (123000);
+  seqTs.SetPG (3);
+  seqTs.ih = MakeInt (2);
+  p->AddHeader (seqTs);
+  UdpHeader udpHeader;
+  udpHeader.SetDestinationPort (100);
+  udpHeader.SetSourcePort (10000);
+  p->AddHeader (udpHeader);
+  AddL3L2 (p, 0x11);
+
+  CustomHeader ch (CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
+  CheckRoundTrip (p, payload, ch);
+  NS_TEST_ASSERT_MSG_EQ (ch.udp.sport, 10000, "udp sport");
+  NS_TEST_ASSERT_MSG_EQ (ch.udp.dport, 100, "udp dport");
+  NS_TEST_ASSERT_MSG_EQ (ch.udp.seq, 123000, "udp seq");
+  NS_TEST_ASSERT_MSG_EQ (ch.udp.pg, 3, "udp pg");
+  NS_TEST_ASSERT_MSG_EQ (ch.udp.ih.nhop, 2, "udp INT hops");
+  NS_TEST_ASSERT_MSG_EQ (ch.udp.ih.hop[1].v, 0x0123456789abcdf0ull, "udp INT hop");
+}
+
+void
+CustomHeaderTest::TestAck (bool sack)
+{
+  qbbHeader seqh;
+  seqh.SetSeq (456000);
+  seqh.SetPG (3);
+  seqh.SetSport (100);
+  seqh.SetDport (10000);
+  IntHeader ih = MakeInt (3);
+  ih.Trim ();
+  seqh.SetIntHeader (ih);
+  seqh.SetCnp ();
+  if (sack)
+    seqh.SetSack (460000, 462000);
+  uint32_t payload = std::max (60 - 14 - 20 - (int)seqh.GetSerializedSize (), 0);
+  Ptr<Packet> p = Create<Packet> (payload);
+  p->AddHeader (seqh);
+  AddL3L2 (p, 0xFC);
+
+  CustomHeader ch (CustomHeader::L2_Header | CustomHeader::L3_Header | CustomHeader::L4_Header);
+  CheckRoundTrip (p, payload, ch);
+  NS_TEST_ASSERT_MSG_EQ (ch.ack.sport, 100, "ack sport");
+  NS_TEST_ASSERT_MSG_EQ (ch.ack.dport, 10000, "ack dport");
+  NS_TEST_ASSERT_MSG_EQ (ch.ack.seq, 456000, "ack seq");
+  NS_TEST_ASSERT_MSG_EQ (((ch.ack.flags >> qbbHeader::FLAG_CNP) & 1), 1, "ack cnp");
+  NS_TEST_ASSERT_MSG_EQ (((ch.ack.flags >> qbbHeader::FLAG_SACK) & 1), (uint32_t)sack, "ack sack");
+  if (sack)
+    {
+      NS_TEST_ASSERT_MSG_EQ (ch.ack.sackBegin, 460000, "ack sack begin");
+      NS_TEST_ASSERT_MSG_EQ (ch.ack.sackEnd, 462000, "ack sack end");
+    }
+  NS_TEST_ASSERT_MSG_EQ (ch.ack.ih.nhop, 3, "ack INT hops");
+  NS_TEST_ASSERT_MSG_EQ (ch.ack.ih.hop[2].v, 0x0123456789abcdf1ull, "ack INT hop");
+}
+
+void
+CustomHeaderTest::DoRun (void)
+{
+  IntHeader::Mode mode = IntHeader::mode;
+  bool compact = IntHeader::compact;
+  IntHeader::mode = IntHeader::NORMAL;
+  for (int c = 0; c < 2; c++)
+    {
+      IntHeader::compact = c;
+      TestUdp ();
+      TestAck (false);
+      TestAck (true);
+    }
+  IntHeader::mode = mode;
+  IntHeader::compact = compact;
+}
+//-----------------------------------------------------------------------------
+class CustomHeaderTestSuite : public TestSuite
+{
+public:
+  CustomHeaderTestSuite ();
+};
+
+CustomHeaderTestSuite::CustomHeaderTestSuite ()
+  : TestSuite ("point-to-point-custom-header", UNIT)
+{
+  AddTestCase (new CustomHeaderTest);
+}
+
+static CustomHeaderTestSuite g_customHeaderTestSuite;
+
+} // namespace ns3
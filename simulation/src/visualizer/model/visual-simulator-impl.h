@@ -67,6 +67,8 @@ public:
   virtual void SetScheduler (ObjectFactory schedulerFactory);
   virtual uint32_t GetSystemId (void) const; 
   virtual uint32_t GetContext (void) const;
+  virtual uint64_t GetEventCount (void) const;
+  virtual uint32_t GetEventQueueSize (void) const;
 
   /// calls Run() in the wrapped simulator
   void RunRealSimulator (void);
@@ -1,3 +1,4 @@
+# -*- coding: utf-8 -*-
 import random
 class CustomRand:
 	def __init__(self):
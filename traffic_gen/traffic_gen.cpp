@@ -0,0 +1,113 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include "../simulation/src/point-to-point/helper/flow-generator.h"
+
+using namespace std;
+
+double translate_bandwidth(const char* b){
+	char *end;
+	double v = strtod(b, &end);
+	if (end == b)
+		return -1;
+	if (*end == 'G')
+		return v * 1e9;
+	if (*end == 'M')
+		return v * 1e6;
+	if (*end == 'K')
+		return v * 1e3;
+	if (*end == 0)
+		return v;
+	return -1;
+}
+
+int main(int argc, char* argv[]){
+	FlowGenerator gen;
+	string cdf_file = "uniform_distribution.txt", output = "tmp_traffic.txt";
+	gen.bw = 10e9;
+	double time = 10;
+	for (int opt; (opt = getopt(argc, argv, "c:n:l:b:t:o:s:p:f:S:")) != -1;){
+		switch (opt){
+			case 'c':
+				cdf_file = optarg;
+				break;
+			case 'n':
+				gen.nhost = atoi(optarg);
+				break;
+			case 'l':
+				gen.load = atof(optarg);
+				break;
+			case 'b':
+				gen.bw = translate_bandwidth(optarg);
+				break;
+			case 't':
+				time = atof(optarg);
+				break;
+			case 'o':
+				output = optarg;
+				break;
+			case 's':
+				gen.seed = atoll(optarg);
+				break;
+			case 'p':
+				if (!FlowGenerator::ParsePattern(optarg, gen.pattern)){
+					fprintf(stderr, "unknown pattern: %s\n", optarg);
+					exit(EXIT_FAILURE);
+				}
+				break;
+			case 'f':
+				gen.fanin = atoi(optarg);
+				break;
+			case 'S':
+				gen.flow_size = atoll(optarg);
+				break;
+			default: /* '?' */
+				fprintf(stderr,
+						"usage: %s -n NHOST [-c CDF_FILE] [-l LOAD] [-b BANDWIDTH] [-t TIME] [-o OUTPUT] [-s SEED] [-p PATTERN] [-f FANIN] [-S SIZE]\n"
+						"\n"
+						"  -c CDF_FILE    the file of the traffic size cdf, by default uniform_distribution.txt\n"
+						"  -n NHOST       number of hosts\n"
+						"  -l LOAD        the percentage of the traffic load to the network capacity, by default 0.3\n"
+						"  -b BANDWIDTH   the bandwidth of host link (G/M/K), by default 10G\n"
+						"  -t TIME        the total run time (s), by default 10\n"
+						"  -o OUTPUT      the output file, by default tmp_traffic.txt\n"
+						"  -s SEED        the random seed, by default 1\n"
+						"  -p PATTERN     poisson (default), incast or a2a\n"
+						"  -f FANIN       number of senders per incast, by default 2\n"
+						"  -S SIZE        fixed flow size (bytes) instead of sampling the cdf\n",
+						argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+	if (gen.nhost == 0){
+		fprintf(stderr, "please use -n to enter number of hosts\n");
+		exit(EXIT_FAILURE);
+	}
+	if (gen.bw <= 0){
+		fprintf(stderr, "bandwidth format incorrect\n");
+		exit(EXIT_FAILURE);
+	}
+	if (gen.flow_size == 0 && !gen.cdf.Load(cdf_file.c_str())){
+		fprintf(stderr, "Error: Not valid cdf\n");
+		exit(EXIT_FAILURE);
+	}
+	// all flows start after 2s, same as traffic_gen.py
+	gen.start = 2000000000;
+	gen.end = gen.start + time * 1e9;
+	if (!gen.Init()){
+		fprintf(stderr, "invalid parameters\n");
+		exit(EXIT_FAILURE);
+	}
+
+	FILE* ofile = fopen(output.c_str(), "w");
+	// reserve the first line for the number of flows
+	fprintf(ofile, "%20s\n", "");
+	uint64_t n_flow = 0;
+	for (GenFlow f; gen.Next(f); n_flow++)
+		fprintf(ofile, "%u %u 3 100 %lu %.9f\n", f.src, f.dst, f.size, f.start * 1e-9);
+	fseek(ofile, 0, SEEK_SET);
+	fprintf(ofile, "%lu", n_flow);
+	fclose(ofile);
+	return 0;
+}